@@ -0,0 +1,247 @@
+// Benchmarks of MoveList, the conflict graph behind the haas and order
+// commands, on the largest strategy in data/, and of the transitive
+// closure that find_closure computes.  The conflicts are found once,
+// outside the timing, by playing each canonical hand the way the best
+// matching strategy line says and comparing it with the other lines
+// that match.  They are grouped into runs of hands, as find_strategy
+// merges them, and replayed into a new MoveList for each iteration.
+
+#include <benchmark/benchmark.h>
+
+#include <stdio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../strategy/find_order.h"
+#include "enum_match.h"
+#include "game.h"
+#include "hand_table.h"
+#include "hold_kernel.h"
+#include "kept.h"
+#include "parse_line.h"
+#include "vpoker.h"
+
+namespace {
+
+const char strategy_file[] = "../data/oej_wip.txt";
+const int runs = 256;
+
+struct line_move : public move_desc {
+  StrategyLine *s;
+  char *name() { return s->image; }
+};
+
+struct conflict {
+  std::size_t right, wrong;
+  std::vector<double> weights;
+  double max_weight = 0.0;
+  card hand[5] = {};
+  unsigned char mask = 0;
+};
+
+struct conflict_data {
+  int hand_size = 0;
+  std::vector<StrategyLine> lines;
+  std::vector<conflict> conflicts;  // In the order find_strategy merges them
+};
+
+// Reads the section of the strategy file with the most lines.
+std::vector<StrategyLine> read_section(int &wild_cards) {
+  std::ifstream infile(strategy_file);
+  std::vector<std::vector<StrategyLine>> sections(5);
+  int current_wild = 0;
+  int line_number = 0;
+
+  std::string line;
+  while (std::getline(infile, line)) {
+    if (++line_number <= 2) {
+      continue;  // The game name and the command
+    }
+    const std::size_t comment = line.find_first_of("#%");
+    if (comment != std::string::npos) {
+      line.resize(comment);
+    }
+    while (!line.empty() && line.back() == ' ') {
+      line.pop_back();
+    }
+    if (line.empty()) {
+      continue;
+    }
+    if ('0' <= line[0] && line[0] <= '4' &&
+        (line.substr(1) == " Deuces" || line == "1 Deuce")) {
+      current_wild = line[0] - '0';
+    } else {
+      sections[current_wild].push_back(
+          parse_line(line.data(), current_wild));
+    }
+  }
+
+  wild_cards = 0;
+  for (int w = 1; w < 5; w++) {
+    if (sections[w].size() > sections[wild_cards].size()) {
+      wild_cards = w;
+    }
+  }
+  return std::move(sections[wild_cards]);
+}
+
+const conflict_data &get_conflicts() {
+  static std::unique_ptr<conflict_data> data;
+  if (data) {
+    return *data;
+  }
+  data = std::make_unique<conflict_data>();
+
+  int wild_cards;
+  data->lines = read_section(wild_cards);
+  data->lines.push_back(StrategyLine());
+  data->hand_size = 5 - wild_cards;
+
+  const vp_game *game = vp_game::find("One Eyed Jacks");
+  game_parameters parms(*game);
+  C_left left(parms);
+  const hand_table table(parms.kind);
+  const auto hands = table.hands(wild_cards);
+
+  EnumerateMatches matcher;
+  matcher.hand_size = data->hand_size;
+  matcher.wild_cards = wild_cards;
+  matcher.parms = &parms;
+
+  for (int r = 0; r < runs; r++) {
+    std::map<std::pair<std::size_t, std::size_t>, conflict> shard;
+
+    for (std::size_t h = hands.size() * r / runs;
+         h < hands.size() * (r + 1) / runs; h++) {
+      std::copy(hands[h].cards, hands[h].cards + 5, matcher.hand);
+      left.remove(matcher.hand, matcher.hand_size, wild_cards);
+
+      // The value of the first play of each matching line.
+      std::vector<std::pair<std::size_t, double>> values;
+      std::vector<unsigned char> masks;
+      for (std::size_t j = 0; data->lines[j].pattern; j++) {
+        matcher.find(data->lines[j].pattern);
+        if (matcher.match_count != 0) {
+          pay_dist pays;
+          kept_description(matcher.hand, matcher.hand_size,
+                           matcher.matches[0], parms)
+              .all_draws(wild_cards, left, pays);
+          values.emplace_back(j, play_value(pays, parms.pay_table));
+          masks.push_back(matcher.matches[0]);
+        }
+      }
+      left.replace(matcher.hand, matcher.hand_size, wild_cards);
+
+      std::size_t best = 0;
+      for (std::size_t k = 1; k < values.size(); k++) {
+        if (values[k].second > values[best].second) {
+          best = k;
+        }
+      }
+      for (std::size_t k = 0; k < values.size(); k++) {
+        const double weight = values[best].second - values[k].second;
+        if (weight > 0.0) {
+          conflict &c = shard[{values[best].first, values[k].first}];
+          c.right = values[best].first;
+          c.wrong = values[k].first;
+          c.weights.push_back(weight);
+          if (weight > c.max_weight) {
+            c.max_weight = weight;
+            std::copy(matcher.hand, matcher.hand + 5, c.hand);
+            c.mask = masks[best];
+          }
+        }
+      }
+    }
+
+    for (auto &[lines, c] : shard) {
+      data->conflicts.push_back(std::move(c));
+    }
+  }
+
+  return *data;
+}
+
+// Builds the MoveList for the conflicts.  The moves are owned by the
+// caller.
+void build(MoveList &list, const conflict_data &data,
+           std::vector<line_move> &moves) {
+  moves.resize(data.lines.size() - 1);
+  for (std::size_t j = 0; j < moves.size(); j++) {
+    moves[j].s = const_cast<StrategyLine *>(&data.lines[j]);
+    moves[j].line = j;
+    list.add_move(&moves[j]);
+  }
+
+  for (const conflict &c : data.conflicts) {
+    list.add_conflicts(&moves[c.right], &moves[c.wrong], c.weights,
+                       c.max_weight, c.hand, c.mask);
+  }
+}
+
+void add_conflicts(benchmark::State &state) {
+  const conflict_data &data = get_conflicts();
+
+  for (auto _ : state) {
+    MoveList list(data.hand_size);
+    std::vector<line_move> moves;
+    build(list, data, moves);
+    benchmark::DoNotOptimize(list);
+  }
+  state.counters["conflicts"] = static_cast<double>(data.conflicts.size());
+}
+
+// Everything the haas command does after evaluating the hands.
+void display_haas(benchmark::State &state) {
+  const conflict_data &data = get_conflicts();
+  FILE *output = tmpfile();
+
+  for (auto _ : state) {
+    MoveList list(data.hand_size);
+    std::vector<line_move> moves;
+    build(list, data, moves);
+    rewind(output);
+    list.display(output, true, true, false);
+  }
+  fclose(output);
+}
+
+// The closure of a graph of n moves and its square, as find_closure
+// computes them.  Each move prefers a few later ones.
+void closure(benchmark::State &state) {
+  const int n = static_cast<int>(state.range(0));
+  bool_matrix adj(n);
+  std::uint32_t random = 12345;
+  for (int i = 0; i < n; i++) {
+    for (int e = 0; e < 3; e++) {
+      random = random * 1103515245 + 12345;
+      const int j = i + 1 + static_cast<int>((random >> 16) % 16);
+      if (j < n) {
+        adj.set(i, j);
+      }
+    }
+  }
+
+  for (auto _ : state) {
+    bool_matrix close(adj);
+    Warshall(close);
+    bool_matrix squared(n);
+    multiply(squared, close, close);
+    benchmark::DoNotOptimize(squared.row(0));
+  }
+}
+
+}  // namespace
+
+BENCHMARK(closure)->RangeMultiplier(2)->Range(64, 512)->Unit(
+    benchmark::kMicrosecond);
+BENCHMARK(add_conflicts)->Unit(benchmark::kMillisecond);
+BENCHMARK(display_haas)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,151 @@
+// Benchmarks of enumerating the starting hands, of finding the class
+// of a dealt hand, of asking the play_oracle about dealt hands, and of
+// computing the optimal return of every game in
+// namespace games from scratch.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "eval_game.h"
+#include "game.h"
+#include "hand_class.h"
+#include "hand_iter.h"
+#include "hand_table.h"
+#include "play_oracle.h"
+#include "vpoker.h"
+
+namespace {
+
+void hand_iteration(benchmark::State &state, game_kind kind) {
+  game_parameters parms(kind, jack);
+
+  for (auto _ : state) {
+    unsigned dealt = 0;
+    for (int wild_cards = 0; wild_cards <= parms.number_wild_cards;
+         wild_cards++) {
+      for (hand_iter iter(5 - wild_cards, kind, wild_cards); !iter.done();
+           iter.next()) {
+        card hand[5];
+        iter.current(hand[0]);
+        benchmark::DoNotOptimize(hand);
+        dealt += iter.multiplier();
+      }
+    }
+    benchmark::DoNotOptimize(dealt);
+  }
+}
+
+// Deals count random five-card hands, one after another.
+std::vector<card> random_deals(const game_parameters &parms, int count) {
+  std::vector<card> deals;
+  std::uint32_t random = 12345;
+  card deck[deck_size + 1];
+  for (int j = 0; j < parms.deck_size; j++) {
+    deck[j] = j;
+  }
+  for (int d = 0; d < count; d++) {
+    for (int j = 0; j < 5; j++) {
+      random = random * 1103515245 + 12345;
+      const int k =
+          j + static_cast<int>((random >> 16) % (parms.deck_size - j));
+      std::swap(deck[j], deck[k]);
+      deals.push_back(deck[j]);
+    }
+  }
+  return deals;
+}
+
+// Sorts and classifies a fixed set of random deals, reporting hands per
+// second.
+void classify(benchmark::State &state, game_kind kind) {
+  game_parameters parms(kind, jack);
+  const hand_table table(kind);
+  const hand_classifier classifier(parms, table);
+
+  const std::vector<card> deals = random_deals(parms, 4096);
+
+  for (auto _ : state) {
+    for (std::size_t j = 0; j < deals.size(); j += 5) {
+      const hand_classifier::sorted_hand h = classifier.sort(&deals[j]);
+      benchmark::DoNotOptimize(classifier.classify(h));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * (deals.size() / 5));
+}
+
+// Answers a batch of random deals with an oracle that has already seen
+// them all, so this is the cost of a lookup, not of an evaluation.
+void oracle_batch(benchmark::State &state, const vp_game &game) {
+  const play_oracle oracle(game);
+  const std::vector<card> deals = random_deals(game, 4096);
+  const std::size_t count = deals.size() / 5;
+  std::vector<play_oracle::answer> answers(count);
+  oracle.query(deals.data(), count, answers.data());
+
+  for (auto _ : state) {
+    oracle.query(deals.data(), count, answers.data(), 1);
+    benchmark::DoNotOptimize(answers.data());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+void payback(benchmark::State &state, const vp_game &game) {
+  for (auto _ : state) {
+    pay_prob prob_pays;
+    benchmark::DoNotOptimize(get_payback(game, prob_pays));
+  }
+}
+
+}  // namespace
+
+BENCHMARK_CAPTURE(hand_iteration, no_wild, GK_no_wild)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(hand_iteration, deuces_wild, GK_deuces_wild)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(hand_iteration, joker_wild, GK_joker_wild)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(hand_iteration, one_eyed_jacks_wild, GK_one_eyed_jacks_wild)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(classify, no_wild, GK_no_wild);
+BENCHMARK_CAPTURE(classify, deuces_wild, GK_deuces_wild);
+BENCHMARK_CAPTURE(classify, joker_wild, GK_joker_wild);
+BENCHMARK_CAPTURE(classify, one_eyed_jacks_wild, GK_one_eyed_jacks_wild);
+
+BENCHMARK_CAPTURE(oracle_batch, jacks_or_better, games::jacks_or_better);
+BENCHMARK_CAPTURE(oracle_batch, deuces_wild, games::deuces_wild);
+
+// Each of these takes seconds, so one iteration is enough.
+BENCHMARK_CAPTURE(payback, jacks_or_better, games::jacks_or_better)
+    ->Unit(benchmark::kSecond)
+    ->Iterations(1);
+BENCHMARK_CAPTURE(payback, kb_joker, games::kb_joker)
+    ->Unit(benchmark::kSecond)
+    ->Iterations(1);
+BENCHMARK_CAPTURE(payback, all_american, games::all_american)
+    ->Unit(benchmark::kSecond)
+    ->Iterations(1);
+BENCHMARK_CAPTURE(payback, eight_five_bonus, games::eight_five_bonus)
+    ->Unit(benchmark::kSecond)
+    ->Iterations(1);
+BENCHMARK_CAPTURE(payback, double_bonus, games::double_bonus)
+    ->Unit(benchmark::kSecond)
+    ->Iterations(1);
+BENCHMARK_CAPTURE(payback, double_double_bonus, games::double_double_bonus)
+    ->Unit(benchmark::kSecond)
+    ->Iterations(1);
+BENCHMARK_CAPTURE(payback, deuces_wild, games::deuces_wild)
+    ->Unit(benchmark::kSecond)
+    ->Iterations(1);
+BENCHMARK_CAPTURE(payback, nsu_deuces_wild, games::nsu_deuces_wild)
+    ->Unit(benchmark::kSecond)
+    ->Iterations(1);
+BENCHMARK_CAPTURE(payback, loose_deuces_wild, games::loose_deuces_wild)
+    ->Unit(benchmark::kSecond)
+    ->Iterations(1);
+BENCHMARK_CAPTURE(payback, loose_deuces_wild2, games::loose_deuces_wild2)
+    ->Unit(benchmark::kSecond)
+    ->Iterations(1);
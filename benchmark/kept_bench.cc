@@ -0,0 +1,280 @@
+// Benchmarks of kept_description: building the description of every
+// subset of a hand (from scratch, and incrementally in Gray code order),
+// counting the draws for typical holds, and the denom_list counts that
+// all_draws is built on.
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+
+#include "denom_list.h"
+#include "game.h"
+#include "hand_table.h"
+#include "kept.h"
+#include "vpoker.h"
+
+namespace {
+
+// Only every stride'th canonical hand is used, to keep each
+// iteration short.
+const std::size_t stride = 16;
+
+void scratch_descriptions(benchmark::State &state, const vp_game &game) {
+  const hand_table table(game.kind);
+  game_parameters parms(game);
+
+  for (auto _ : state) {
+    int discards = 0;
+    for (int wild_cards = 0; wild_cards <= table.max_wild_cards();
+         wild_cards++) {
+      const int hand_size = 5 - wild_cards;
+      const auto hands = table.hands(wild_cards);
+      for (std::size_t h = 0; h < hands.size(); h += stride) {
+        for (unsigned mask = 0; mask < (1u << hand_size); mask++) {
+          kept_description kept(hands[h].cards, hand_size, mask, parms);
+          discards += kept.number_of_discards();
+        }
+      }
+    }
+    benchmark::DoNotOptimize(discards);
+  }
+}
+
+void gray_descriptions(benchmark::State &state, const vp_game &game) {
+  const hand_table table(game.kind);
+  game_parameters parms(game);
+
+  for (auto _ : state) {
+    int discards = 0;
+    for (int wild_cards = 0; wild_cards <= table.max_wild_cards();
+         wild_cards++) {
+      const int hand_size = 5 - wild_cards;
+      const auto hands = table.hands(wild_cards);
+      for (std::size_t h = 0; h < hands.size(); h += stride) {
+        kept_builder builder(hands[h].cards, hand_size, parms);
+        do {
+          discards += builder.current().number_of_discards();
+        } while (builder.next());
+      }
+    }
+    benchmark::DoNotOptimize(discards);
+  }
+}
+
+// The same, including the all_draws calls of the evaluate loop.
+void scratch_evaluate(benchmark::State &state, const vp_game &game) {
+  const hand_table table(game.kind);
+  game_parameters parms(game);
+  C_left left(parms);
+
+  for (auto _ : state) {
+    for (int wild_cards = 0; wild_cards <= table.max_wild_cards();
+         wild_cards++) {
+      const int hand_size = 5 - wild_cards;
+      const auto hands = table.hands(wild_cards);
+      for (std::size_t h = 0; h < hands.size(); h += stride) {
+        const card *hand = hands[h].cards;
+        left.remove(hand, hand_size, wild_cards);
+        for (unsigned mask = 0; mask < (1u << hand_size); mask++) {
+          kept_description kept(hand, hand_size, mask, parms);
+          for (int keep = 0; keep <= wild_cards; keep++) {
+            pay_dist pays;
+            kept.all_draws(keep, left, pays);
+            benchmark::DoNotOptimize(pays);
+          }
+        }
+        left.replace(hand, hand_size, wild_cards);
+      }
+    }
+  }
+}
+
+void gray_evaluate(benchmark::State &state, const vp_game &game) {
+  const hand_table table(game.kind);
+  game_parameters parms(game);
+  C_left left(parms);
+
+  for (auto _ : state) {
+    for (int wild_cards = 0; wild_cards <= table.max_wild_cards();
+         wild_cards++) {
+      const int hand_size = 5 - wild_cards;
+      const auto hands = table.hands(wild_cards);
+      for (std::size_t h = 0; h < hands.size(); h += stride) {
+        const card *hand = hands[h].cards;
+        left.remove(hand, hand_size, wild_cards);
+        kept_builder builder(hand, hand_size, parms);
+        do {
+          for (int keep = 0; keep <= wild_cards; keep++) {
+            pay_dist pays;
+            builder.current().all_draws(keep, left, pays);
+            benchmark::DoNotOptimize(pays);
+          }
+        } while (builder.next());
+        left.replace(hand, hand_size, wild_cards);
+      }
+    }
+  }
+}
+
+// A hand, the cards held and the number of deuces held.
+struct hold_shape {
+  const vp_game &game;
+  card hand[5];
+  int hand_size;
+  unsigned mask;
+  int deuces;
+};
+
+// The hands are sorted by denomination, as hand_iter makes them.
+const hold_shape pair_hold = {games::jacks_or_better,
+                              {make_card(three, 0), make_card(seven, 1),
+                               make_card(nine, 2), make_card(jack, 2),
+                               make_card(jack, 3)},
+                              5,
+                              0x18,
+                              0};
+const hold_shape four_flush_hold = {games::jacks_or_better,
+                                    {make_card(deuce, 3), make_card(five, 3),
+                                     make_card(seven, 0), make_card(nine, 3),
+                                     make_card(king, 3)},
+                                    5,
+                                    0x1b,
+                                    0};
+const hold_shape inside_straight_hold = {games::jacks_or_better,
+                                         {make_card(five, 0), make_card(six, 1),
+                                          make_card(eight, 3), make_card(nine, 2),
+                                          make_card(king, 0)},
+                                         5,
+                                         0x0f,
+                                         0};
+const hold_shape three_rf_hold = {games::jacks_or_better,
+                                  {make_card(four, 1), make_card(seven, 0),
+                                   make_card(ten, 2), make_card(jack, 2),
+                                   make_card(queen, 2)},
+                                  5,
+                                  0x1c,
+                                  0};
+const hold_shape discard_all_hold = {games::jacks_or_better,
+                                     {make_card(deuce, 1), make_card(five, 0),
+                                      make_card(seven, 3), make_card(nine, 2),
+                                      make_card(queen, 0)},
+                                     5,
+                                     0,
+                                     0};
+// Three deuces, which are not part of the hand, and nothing else.
+const hold_shape three_deuces_hold = {games::deuces_wild,
+                                      {make_card(five, 3), make_card(nine, 0)},
+                                      2,
+                                      0,
+                                      3};
+
+void all_draws(benchmark::State &state, const hold_shape &shape) {
+  game_parameters parms(shape.game);
+  C_left left(parms);
+  left.remove(shape.hand, shape.hand_size, shape.deuces);
+  kept_description kept(shape.hand, shape.hand_size, shape.mask, parms);
+
+  // The first call for a game without wild cards builds the draw table.
+  pay_dist pays;
+  kept.all_draws(shape.deuces, left, pays);
+
+  for (auto _ : state) {
+    kept.all_draws(shape.deuces, left, pays);
+    benchmark::DoNotOptimize(pays);
+  }
+}
+
+// The same by case analysis, which is what all_draws does for games
+// with wild cards.
+void count_draws(benchmark::State &state, const hold_shape &shape) {
+  game_parameters parms(shape.game);
+  C_left left(parms);
+  left.remove(shape.hand, shape.hand_size, shape.deuces);
+  kept_description kept(shape.hand, shape.hand_size, shape.mask, parms);
+
+  for (auto _ : state) {
+    pay_dist pays;
+    kept.count_draws(shape.deuces, left, pays);
+    benchmark::DoNotOptimize(pays);
+  }
+}
+
+// The denominations that can be drawn without pairing a held pair of
+// jacks, after 3 7 9 J J is dealt.
+denom_list unpaired_denoms(C_left &left) {
+  denom_list list(left.denoms);
+  for (int d = ace; d <= king; d++) {
+    if (d != jack) {
+      list.add(d);
+    }
+  }
+  return list;
+}
+
+void denom_no_pair(benchmark::State &state) {
+  game_parameters parms(games::jacks_or_better);
+  C_left left(parms);
+  left.remove(pair_hold.hand, pair_hold.hand_size, 0);
+  denom_list list = unpaired_denoms(left);
+  const int n = static_cast<int>(state.range(0));
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(list.no_pair(n));
+  }
+}
+
+void denom_two_pair(benchmark::State &state) {
+  game_parameters parms(games::jacks_or_better);
+  C_left left(parms);
+  left.remove(pair_hold.hand, pair_hold.hand_size, 0);
+  denom_list list = unpaired_denoms(left);
+  const int n = static_cast<int>(state.range(0));
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(list.two_pair(n));
+  }
+}
+
+void denom_full_house(benchmark::State &state) {
+  game_parameters parms(games::jacks_or_better);
+  C_left left(parms);
+  left.remove(pair_hold.hand, pair_hold.hand_size, 0);
+  denom_list list = unpaired_denoms(left);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(list.full_house(5));
+  }
+}
+
+}  // namespace
+
+BENCHMARK_CAPTURE(scratch_descriptions, jacks, games::jacks_or_better);
+BENCHMARK_CAPTURE(gray_descriptions, jacks, games::jacks_or_better);
+BENCHMARK_CAPTURE(scratch_descriptions, deuces, games::deuces_wild);
+BENCHMARK_CAPTURE(gray_descriptions, deuces, games::deuces_wild);
+
+BENCHMARK_CAPTURE(scratch_evaluate, jacks, games::jacks_or_better)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(gray_evaluate, jacks, games::jacks_or_better)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(scratch_evaluate, deuces, games::deuces_wild)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(gray_evaluate, deuces, games::deuces_wild)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(all_draws, pair, pair_hold);
+BENCHMARK_CAPTURE(all_draws, four_flush, four_flush_hold);
+BENCHMARK_CAPTURE(all_draws, inside_straight, inside_straight_hold);
+BENCHMARK_CAPTURE(all_draws, three_rf, three_rf_hold);
+BENCHMARK_CAPTURE(all_draws, discard_all, discard_all_hold);
+BENCHMARK_CAPTURE(all_draws, three_deuces, three_deuces_hold);
+
+BENCHMARK_CAPTURE(count_draws, pair, pair_hold);
+BENCHMARK_CAPTURE(count_draws, four_flush, four_flush_hold);
+BENCHMARK_CAPTURE(count_draws, inside_straight, inside_straight_hold);
+BENCHMARK_CAPTURE(count_draws, three_rf, three_rf_hold);
+BENCHMARK_CAPTURE(count_draws, discard_all, discard_all_hold);
+
+BENCHMARK(denom_no_pair)->DenseRange(1, 5);
+BENCHMARK(denom_two_pair)->DenseRange(4, 5);
+BENCHMARK(denom_full_house);
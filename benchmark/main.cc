@@ -0,0 +1,36 @@
+// Runs the benchmarks.  Unless told otherwise with --benchmark_out,
+// the results are also written as JSON to benchmarks.json, so that
+// runs can be compared to find regressions, for example with
+// tools/compare.py from the Google Benchmark sources.
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <vector>
+
+int main(int argc, char **argv) {
+  std::vector<char *> args(argv, argv + argc);
+
+  bool has_out = false;
+  for (int j = 1; j < argc; j++) {
+    if (std::strncmp(argv[j], "--benchmark_out=", 16) == 0) {
+      has_out = true;
+    }
+  }
+
+  char out[] = "--benchmark_out=benchmarks.json";
+  char format[] = "--benchmark_out_format=json";
+  if (!has_out) {
+    args.push_back(out);
+    args.push_back(format);
+  }
+
+  int count = static_cast<int>(args.size());
+  benchmark::Initialize(&count, args.data());
+  if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
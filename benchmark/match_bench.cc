@@ -0,0 +1,123 @@
+// Benchmarks of EnumerateMatches::find and CompiledMatcher::find, one
+// strategy line for each kind of parser code, over all the canonical
+// hands of 9/6 Jacks, and then a whole strategy tried line by line.
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "compiled_match.h"
+#include "enum_match.h"
+#include "game.h"
+#include "hand_table.h"
+#include "parse_line.h"
+#include "vpoker.h"
+
+namespace {
+
+void find(EnumerateMatches &matcher, const StrategyLine &line) {
+  matcher.find(line.pattern);
+}
+
+void find(CompiledMatcher &matcher, const StrategyLine &line) {
+  matcher.find(line);
+}
+
+template <typename Matcher>
+void find_matches(benchmark::State &state, const char *line) {
+  static const hand_table table(GK_no_wild);
+  game_parameters parms(games::jacks_or_better);
+  StrategyLine parsed = parse_line(line, 0);
+
+  Matcher matcher;
+  matcher.hand_size = 5;
+  matcher.wild_cards = 0;
+  matcher.parms = &parms;
+
+  for (auto _ : state) {
+    int matches = 0;
+    for (const hand_record &r : table.hands(0)) {
+      for (int j = 0; j < 5; j++) {
+        matcher.hand[j] = r.cards[j];
+      }
+      find(matcher, parsed);
+      matches += matcher.match_count;
+    }
+    benchmark::DoNotOptimize(matches);
+  }
+}
+
+void interpreted(benchmark::State &state, const char *line) {
+  find_matches<EnumerateMatches>(state, line);
+}
+
+void compiled(benchmark::State &state, const char *line) {
+  find_matches<CompiledMatcher>(state, line);
+}
+
+// Every line of a Jacks strategy on every hand, as building a
+// match_index does.
+template <typename Matcher>
+void find_strategy(benchmark::State &state) {
+  static const hand_table table(GK_no_wild);
+  game_parameters parms(games::jacks_or_better);
+  std::vector<StrategyLine> lines;
+  for (const char *line :
+       {"RF 4", "Full House or Quads", "Trips", "Two Pair", "Straight",
+        "Flush", "SF 4", "Pair of J-A", "RF 3", "Flush 4", "Straight 4",
+        "Pair of 2-T", "SF 3 h1", "AKQJ", "RF 2 (QJ) [no fp]", "Flush 3 h2",
+        "SF 3 i h0 [no sp]", "QJ [dsc A]", "Just a J [no fp]", "Nothing"}) {
+    lines.push_back(parse_line(line, 0));
+  }
+
+  Matcher matcher;
+  matcher.hand_size = 5;
+  matcher.wild_cards = 0;
+  matcher.parms = &parms;
+
+  for (auto _ : state) {
+    int matches = 0;
+    for (const hand_record &r : table.hands(0)) {
+      for (int j = 0; j < 5; j++) {
+        matcher.hand[j] = r.cards[j];
+      }
+      for (const StrategyLine &line : lines) {
+        find(matcher, line);
+        matches += matcher.match_count;
+      }
+    }
+    benchmark::DoNotOptimize(matches);
+  }
+}
+
+}  // namespace
+
+#define MATCH_BENCHMARK(name, line)                                        \
+  BENCHMARK_CAPTURE(interpreted, name, line)->Unit(benchmark::kMillisecond); \
+  BENCHMARK_CAPTURE(compiled, name, line)->Unit(benchmark::kMillisecond)
+
+MATCH_BENCHMARK(nothing, "Nothing");
+MATCH_BENCHMARK(two_pair, "Two Pair");
+MATCH_BENCHMARK(trips, "Trips");
+MATCH_BENCHMARK(full_house, "Full House");
+MATCH_BENCHMARK(quads, "Quads");
+MATCH_BENCHMARK(pair_of_x, "Pair of J, Q, K, or A");
+MATCH_BENCHMARK(just_a_x, "Just a J");
+MATCH_BENCHMARK(rf_n, "RF 3");
+MATCH_BENCHMARK(sf_n, "SF 4 i");
+MATCH_BENCHMARK(straight_n, "Straight 4");
+MATCH_BENCHMARK(flush_n, "Flush 3");
+MATCH_BENCHMARK(these_n, "AKQJ");
+MATCH_BENCHMARK(high_n, "Straight 4 i h2");
+MATCH_BENCHMARK(high_x, "Flush 3 h1 (Q high)");
+MATCH_BENCHMARK(no_x, "RF 3 (A high, no T)");
+MATCH_BENCHMARK(no_fp, "RF 2 (QJ) [no fp]");
+MATCH_BENCHMARK(no_sp, "SF 2 di (J8) [no sp]");
+MATCH_BENCHMARK(no_these_n, "RF 3 (KQJ) [no T]");
+MATCH_BENCHMARK(no_ge_x, "RF 3 (KQT or KJT) [no 9, no >= J]");
+MATCH_BENCHMARK(dsc_these_n, "QJ [dsc A]");
+MATCH_BENCHMARK(no_these_n_and_fp, "RF 2 (JT) [no A9+fp]");
+MATCH_BENCHMARK(discard_suit_count_n, "Just a J [no 7, 8, 9, or T] [dsc 2 suited]");
+
+BENCHMARK(find_strategy<EnumerateMatches>)->Unit(benchmark::kMillisecond);
+BENCHMARK(find_strategy<CompiledMatcher>)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,112 @@
+// Benchmarks of combining pay distributions, as the multi-line and
+// multi-game reports do.
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "pay_dist.h"
+
+namespace {
+
+// About the distribution of 9/6 Jacks or Better.
+PayDistribution jacks_distribution(int cutoff) {
+  PayDistribution dist(cutoff, 0.0,
+                       {{0.545447, 0}, {0.214585, 1}, {0.129279, 2},
+                        {0.074449, 3}, {0.011229, 4}, {0.011015, 6},
+                        {0.011512, 9}, {0.002363, 25}, {0.000109, 50},
+                        {0.000025, 800}});
+  dist.normalize();
+  return dist;
+}
+
+void pay_succession(benchmark::State &state,
+                    PayDistribution::convolution method) {
+  // Build up a distribution with many distinct payoffs first.
+  const PayDistribution wager = repeat(jacks_distribution(10000), 10);
+
+  double error_bound = 0.0;
+  for (auto _ : state) {
+    const PayDistribution sum = succession(wager, wager, method);
+    error_bound = sum.error_bound();
+    benchmark::DoNotOptimize(sum);
+  }
+  state.counters["error_bound"] = error_bound;
+}
+
+void pay_repeat(benchmark::State &state) {
+  const unsigned n = static_cast<unsigned>(state.range(0));
+  const PayDistribution wager = jacks_distribution(n + 2001);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(repeat(wager, n));
+  }
+}
+
+// What the multi command does for each hand, and then for the total:
+// repeat the wager for each line, then that for each game, cut off as
+// the multi command does.
+void pay_multi(benchmark::State &state) {
+  const unsigned lines = static_cast<unsigned>(state.range(0));
+  const unsigned games = static_cast<unsigned>(state.range(1));
+
+  double error_bound = 0.0;
+  for (auto _ : state) {
+    PayDistribution total = repeat(jacks_distribution(4000), lines);
+    total.set_cutoff(games + 2001);
+    total = repeat(total, games);
+    error_bound = total.error_bound();
+    benchmark::DoNotOptimize(total);
+  }
+  state.counters["error_bound"] = error_bound;
+}
+
+// Totalling the distributions of many starting hands, as the multi
+// command does, a merge at a time or with an accumulator.
+void pay_total_merge(benchmark::State &state) {
+  const PayDistribution hand = repeat(jacks_distribution(4000), 5);
+  const int hands = static_cast<int>(state.range(0));
+
+  for (auto _ : state) {
+    PayDistribution total;
+    for (int i = 0; i < hands; ++i) {
+      PayDistribution dist = hand;
+      dist.scale(1.0 / hands);
+      total = merge(total, dist);
+    }
+    benchmark::DoNotOptimize(total);
+  }
+}
+
+void pay_total_accumulate(benchmark::State &state) {
+  const PayDistribution hand = repeat(jacks_distribution(4000), 5);
+  const int hands = static_cast<int>(state.range(0));
+
+  for (auto _ : state) {
+    PayAccumulator total(4000);
+    for (int i = 0; i < hands; ++i) {
+      total.add(hand, 1.0 / hands);
+    }
+    benchmark::DoNotOptimize(total.total());
+  }
+}
+
+}  // namespace
+
+BENCHMARK_CAPTURE(pay_succession, automatic,
+                  PayDistribution::convolution::automatic)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(pay_succession, dense, PayDistribution::convolution::dense)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(pay_succession, sparse, PayDistribution::convolution::sparse)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(pay_succession, fft, PayDistribution::convolution::fft)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(pay_repeat)->RangeMultiplier(10)->Range(10, 1000)->Unit(
+    benchmark::kMillisecond);
+BENCHMARK(pay_multi)
+    ->Args({5, 100})
+    ->Args({100, 1000})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(pay_total_merge)->Arg(10000)->Unit(benchmark::kMillisecond);
+BENCHMARK(pay_total_accumulate)->Arg(10000)->Unit(benchmark::kMillisecond);
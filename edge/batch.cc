@@ -0,0 +1,217 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <regex>
+#include <utility>
+
+#include "..\shared\draw_cache.h"
+#include "..\shared\vpoker.h"
+
+std::optional<std::vector<BatchEntry>> read_batch(const std::string& path) {
+  namespace fs = std::filesystem;
+
+  std::vector<std::string> filenames;
+
+  if (fs::is_directory(path)) {
+    for (const fs::directory_entry& entry : fs::directory_iterator(path)) {
+      if (entry.is_regular_file()) {
+        filenames.push_back(entry.path().string());
+      }
+    }
+    std::sort(filenames.begin(), filenames.end());
+  } else {
+    std::ifstream manifest(path);
+    if (!manifest.is_open()) {
+      std::cerr << "Error: Could not open " << path << "\n";
+      return std::nullopt;
+    }
+
+    const fs::path directory = fs::path(path).parent_path();
+    std::string line;
+    while (std::getline(manifest, line)) {
+      while (!line.empty() && (line.back() == ' ' || line.back() == '\r')) {
+        line.pop_back();
+      }
+      if (line.empty() || line.front() == '#') {
+        continue;
+      }
+      filenames.push_back((directory / line).string());
+    }
+  }
+
+  std::vector<BatchEntry> result;
+  for (const std::string& filename : filenames) {
+    auto contents = read_file(filename);
+    if (!contents || contents->game_name.empty()) {
+      std::cerr << "Skipping " << filename << ": not a pay table\n";
+      continue;
+    }
+    result.push_back(BatchEntry{filename, std::move(*contents)});
+  }
+
+  if (result.empty()) {
+    std::cerr << "Error: No pay tables in " << path << "\n";
+    return std::nullopt;
+  }
+  return result;
+}
+
+std::optional<std::vector<BatchEntry>> make_grid(
+    const FileContents& base, const std::vector<std::string>& specs) {
+  struct Axis {
+    std::string name;
+    payoff_name hand;
+    int low;
+    int high;
+  };
+  std::vector<Axis> axes;
+
+  // Pays fit in 16 bits, so five digits are enough, and std::stoi
+  // can't overflow.
+  const std::regex spec_pattern(
+      R"( *([a-z0-9 -]*[a-z0-9]) *= *(\d{1,5})\.\.(\d{1,5}) *)");
+
+  for (const std::string& spec : specs) {
+    std::smatch match;
+    if (!std::regex_match(spec, match, spec_pattern)) {
+      std::cerr << "Bad grid parameter " << spec << "\n";
+      return std::nullopt;
+    }
+    const auto hand = find_hand_name(match[1]);
+    const int low = std::stoi(match[2]);
+    const int high = std::stoi(match[3]);
+    if (!hand || low > high || high > 0xffff) {
+      std::cerr << "Bad grid parameter " << spec << "\n";
+      return std::nullopt;
+    }
+    axes.push_back(Axis{match[1], *hand, low, high});
+  }
+
+  // Count through the grid like an odometer.
+  std::vector<int> values;
+  for (const Axis& axis : axes) {
+    values.push_back(axis.low);
+  }
+
+  std::vector<BatchEntry> result;
+  for (;;) {
+    BatchEntry entry{base.game_name, base};
+    for (std::size_t j = 0; j < axes.size(); j++) {
+      entry.label.append(std::format("{} {}={}", j == 0 ? ":" : ",",
+                                     axes[j].name, values[j]));
+      entry.contents.pay_table[axes[j].hand] =
+          static_cast<std::uint16_t>(values[j]);
+    }
+    entry.contents.game_name = entry.label;
+    result.push_back(std::move(entry));
+
+    std::size_t k = axes.size();
+    while (k > 0 && values[k - 1] == axes[k - 1].high) {
+      values[k - 1] = axes[k - 1].low;
+      --k;
+    }
+    if (k == 0) {
+      break;
+    }
+    ++values[k - 1];
+  }
+
+  return result;
+}
+
+static std::string csv_quote(const std::string& text) {
+  std::string result = "\"";
+  for (const char c : text) {
+    if (c == '"') {
+      result.push_back('"');
+    }
+    result.push_back(c);
+  }
+  result.push_back('"');
+  return result;
+}
+
+static std::string json_quote(const std::string& text) {
+  std::string result = "\"";
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      result.push_back('\\');
+    }
+    result.push_back(c);
+  }
+  result.push_back('"');
+  return result;
+}
+
+void run_batch(const std::vector<BatchEntry>& entries, std::ostream& out,
+               bool json) {
+  // One cache for each kind of game and high pair.
+  std::map<std::pair<game_kind, denom_value>, std::unique_ptr<draw_cache>>
+      caches;
+
+  if (json) {
+    out << "[";
+  } else {
+    out << "name,return,variance";
+    for (int j = first_pay; j <= last_pay; j++) {
+      out << "," << csv_quote(payoff_image[j]);
+    }
+    out << "\n";
+  }
+
+  bool first_entry = true;
+  for (const BatchEntry& entry : entries) {
+    const FileContents& contents = entry.contents;
+
+    std::unique_ptr<draw_cache>& cache =
+        caches[std::make_pair(contents.kind, contents.high)];
+    if (!cache) {
+      cache = draw_cache::open(contents.kind, contents.high);
+    }
+
+    int pay_table[static_cast<std::size_t>(last_pay) + 1];
+    std::copy(contents.pay_table.begin(), contents.pay_table.end(), pay_table);
+    const vp_game the_game(contents.game_name.c_str(), contents.kind,
+                           contents.high, &pay_table);
+
+    pay_prob prob_pays;
+    const double ev = cache->get_payback(the_game, prob_pays);
+
+    double variance = 0.0;
+    for (int j = first_pay; j <= last_pay; j++) {
+      const double diff = pay_table[j] - ev;
+      variance += prob_pays[j] * diff * diff;
+    }
+
+    if (json) {
+      out << (first_entry ? "\n" : ",\n");
+      out << std::format("  {{\"name\": {}, \"return\": {:.17g}, "
+                         "\"variance\": {:.17g}, \"probabilities\": {{",
+                         json_quote(entry.label), ev, variance);
+      for (int j = first_pay; j <= last_pay; j++) {
+        out << std::format("{}{}: {:.17g}", j == first_pay ? "" : ", ",
+                           json_quote(payoff_image[j]), prob_pays[j]);
+      }
+      out << "}}";
+    } else {
+      out << std::format("{},{:.17g},{:.17g}", csv_quote(entry.label), ev,
+                         variance);
+      for (int j = first_pay; j <= last_pay; j++) {
+        out << std::format(",{:.17g}", prob_pays[j]);
+      }
+      out << "\n";
+    }
+    first_entry = false;
+  }
+
+  if (json) {
+    out << "\n]\n";
+  }
+}
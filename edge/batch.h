@@ -0,0 +1,34 @@
+#pragma once
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "read_file.h"
+
+// Evaluating many pay tables in one process.  The tables are grouped
+// by game kind and high pair, and each group is scored from a single
+// draw_cache, so the combinatorics are only done once per group.
+
+struct BatchEntry {
+  std::string label;  // The file name, or a description of the grid point
+  FileContents contents;
+};
+
+// Reads all the pay table files in a directory, or, if path is a file,
+// all the pay table files it lists, one per line.  Names in the list
+// are relative to the list's directory.  Blank lines and lines that
+// begin with a pound sign are ignored.  Files that can't be read as a
+// pay table are reported and skipped; it fails only if none can.
+std::optional<std::vector<BatchEntry>> read_batch(const std::string& path);
+
+// Makes a variant of the base pay table for every combination of the
+// values in the specs.  Each spec has the form "full house=6..9",
+// using the hand names of pay table files.
+std::optional<std::vector<BatchEntry>> make_grid(
+    const FileContents& base, const std::vector<std::string>& specs);
+
+// Evaluates all the entries, writing the return, the variance and the
+// probability of each payoff as CSV, or as JSON.
+void run_batch(const std::vector<BatchEntry>& entries, std::ostream& out,
+               bool json);
@@ -1,18 +1,29 @@
 // Program to compute the house edge in video poker variations
+//
+// Usage:
+//   edge <pay table file>
+//   edge --batch <directory or list of files> [--json] [--output <file>]
+//   edge --grid <pay table file> "<hand>=<low>..<high>" ...
+//        [--json] [--output <file>]
+//
+// The draw counts for each kind of game are computed once and saved
+// in the directory named by VPOKER_CACHE_DIR, or in "vpoker" in the
+// system's temporary directory, where later runs find them.
+
+#include <stdio.h>
 
 #include <cstddef>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
 
-#include "../shared/eval_game.h"
+#include "../shared/draw_cache.h"
+#include "batch.h"
 #include "read_file.h"
 
-int main(int argc, const char* argv[]) {
-  if (argc != 2) {
-    std::cerr << "Missing filename argument\n";
-    return 1;
-  }
-  const std::string filename(argv[1]);
+static int evaluate_one(const std::string& filename) {
   const auto contents = read_file(filename);
   if (!contents) {
     return 1;
@@ -29,8 +40,73 @@ int main(int argc, const char* argv[]) {
 
   vp_game the_game(contents->game_name.c_str(), contents->kind, contents->high,
                    &pay_table);
+
+  // The draw counts don't depend on the pay table, so they are kept
+  // in a file that is reused for every pay table of the same kind.
+  const auto cache = draw_cache::open(contents->kind, contents->high);
   pay_prob prob_pays;
-  eval_game(the_game, prob_pays);
+  const double ev = cache->get_payback(the_game, prob_pays);
+  printf("Return %.5f%%\n", ev * 100.0);
+
+  return 0;
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc == 2) {
+    return evaluate_one(argv[1]);
+  }
+
+  if (argc < 3 || (std::strcmp(argv[1], "--batch") != 0 &&
+                   std::strcmp(argv[1], "--grid") != 0)) {
+    std::cerr << "Missing filename argument\n";
+    return 1;
+  }
+
+  bool json = false;
+  std::string output;
+  std::vector<std::string> specs;
+
+  for (int j = 3; j < argc; j++) {
+    if (std::strcmp(argv[j], "--json") == 0) {
+      json = true;
+    } else if (std::strcmp(argv[j], "--output") == 0 && j + 1 < argc) {
+      output = argv[++j];
+    } else {
+      specs.push_back(argv[j]);
+    }
+  }
+
+  std::optional<std::vector<BatchEntry>> entries;
+
+  if (std::strcmp(argv[1], "--batch") == 0) {
+    if (!specs.empty()) {
+      std::cerr << "Unexpected argument " << specs.front() << "\n";
+      return 1;
+    }
+    entries = read_batch(argv[2]);
+  } else {
+    const auto base = read_file(argv[2]);
+    if (!base) {
+      return 1;
+    }
+    entries = make_grid(*base, specs);
+  }
+
+  if (!entries) {
+    return 1;
+  }
+
+  if (output.empty()) {
+    output = json ? "edge.json" : "edge.csv";
+  }
+  std::ofstream out(output);
+  if (!out.is_open()) {
+    std::cerr << "Error: Could not create " << output << "\n";
+    return 1;
+  }
+
+  run_batch(*entries, out, json);
+  printf("Wrote %zu pay tables to %s\n", entries->size(), output.c_str());
 
   return 0;
 }
@@ -74,6 +74,14 @@ std::optional<std::pair<payoff_name, std::uint16_t>> parse(
   return std::nullopt;
 }
 
+std::optional<payoff_name> find_hand_name(const std::string& name) {
+  const auto it = hand_name.find(name);
+  if (it == hand_name.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
 std::optional<FileContents> read_file(const std::string& filename) {
   std::ifstream file(filename);
 
@@ -16,3 +16,7 @@ struct FileContents {
 };
 
 std::optional<FileContents> read_file(const std::string& filename);
+
+// Looks up a hand name as written in a pay table file,
+// such as "full house".
+std::optional<payoff_name> find_hand_name(const std::string& name);
@@ -1,17 +1,43 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <numeric>
 #include <random>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 
 #include "..\shared\eval_game.h"
 #include "..\shared\vpoker.h"
+#include "bankroll.h"
 #include "combin.h"
+#include "compiled_match.h"
+#include "deal_sim.h"
+#include "decision_table.h"
+#include "draw_cache.h"
+#include "draw_table.h"
+#include "enum_match.h"
+#include "grid_command.h"
+#include "hand_class.h"
+#include "hand_iter.h"
+#include "hand_table.h"
+#include "hold_kernel.h"
+#include "kept.h"
 #include "gtest/gtest.h"
 #include "multi_command.h"
+#include "parse_line.h"
 #include "pay_dist.h"
+#include "play_oracle.h"
+#include "session_sim.h"
+#include "workers.h"
 
 // Number of combinations for n things taken k at a time.
 int combination(int n, int k) {
@@ -165,6 +191,93 @@ TEST(Distribution, Merge) {
   }
 }
 
+// Checks that the fft convolution is within its error bound of the
+// dense one, which must be the same as the sparse one.
+void check_convolutions(const PayDistribution& first,
+                        const PayDistribution& second) {
+  using convolution = PayDistribution::convolution;
+  const PayDistribution dense = succession(first, second, convolution::dense);
+  const PayDistribution sparse =
+      succession(first, second, convolution::sparse);
+  const PayDistribution fft = succession(first, second, convolution::fft);
+  EXPECT_EQ(dense, sparse);
+  EXPECT_EQ(dense.error_bound(), first.error_bound() + second.error_bound());
+
+  const double bound = fft.error_bound();
+  EXPECT_GT(bound, dense.error_bound());
+  EXPECT_LT(bound, 1e-12);
+  EXPECT_NEAR(fft.cutoff_prob(), dense.cutoff_prob(), 1e-15);
+
+  std::map<int, double> difference;
+  for (const auto& [prob, pay] : dense.distribution()) {
+    difference[pay] += prob;
+  }
+  for (const auto& [prob, pay] : fft.distribution()) {
+    difference[pay] -= prob;
+  }
+  for (const auto& [pay, diff] : difference) {
+    EXPECT_LE(std::abs(diff), bound) << pay;
+  }
+}
+
+TEST(Distribution, Convolutions) {
+  RandomEngine engine;
+  engine.seed(54321);
+  for (const int cutoff : {std::numeric_limits<int>::max(), 12}) {
+    for (int i = 0; i < 200; ++i) {
+      const PayDistribution first(cutoff, 0.0,
+                                  increasing(engine).distribution());
+      const PayDistribution second(cutoff, 0.0,
+                                   increasing(engine).distribution());
+      if (!first.distribution().empty() && !second.distribution().empty()) {
+        check_convolutions(first, second);
+      }
+    }
+  }
+
+  // Big enough for the fft to be much faster, but the automatic choice
+  // must still be exact, as the multi-game reports rely on it.
+  PayDistribution wager(3001, 0.0,
+                        {{0.545447, 0}, {0.214585, 1}, {0.129279, 2},
+                         {0.074449, 3}, {0.011229, 4}, {0.011015, 6},
+                         {0.011512, 9}, {0.002363, 25}, {0.000109, 50},
+                         {0.000025, 800}});
+  wager = repeat(wager, 16);
+  check_convolutions(wager, wager);
+  const PayDistribution sum = succession(wager, wager);
+  EXPECT_EQ(sum.error_bound(), 0.0);
+  EXPECT_EQ(sum, succession(wager, wager,
+                            PayDistribution::convolution::dense));
+}
+
+TEST(Distribution, Accumulate) {
+  RandomEngine engine;
+  engine.seed(24680);
+  for (const int cutoff : {std::numeric_limits<int>::max(), 12}) {
+    PayDistribution merged(cutoff, 0.0, {});
+    PayAccumulator accumulated(cutoff);
+    for (int i = 0; i < 100; ++i) {
+      PayDistribution dist(cutoff, 0.0625, increasing(engine).distribution());
+      const double prob = 0.125 * (i % 5 + 1);
+      accumulated.add(dist, prob);
+      dist.scale(prob);
+      merged = merge(merged, dist);
+    }
+    EXPECT_EQ(accumulated.total(), merged);
+  }
+}
+
+TEST(Distribution, RepeatCache) {
+  const PayDistribution first({{0.5, 0}, {0.25, 1}, {0.25, 5}});
+  const PayDistribution second({{0.5, 0}, {0.5, 2}});
+  RepeatCache cache(7);
+  const PayDistribution& repeated = cache.repeat(first);
+  EXPECT_EQ(repeated, repeat(first, 7));
+  EXPECT_EQ(cache.repeat(second), repeat(second, 7));
+  EXPECT_EQ(&cache.repeat(PayDistribution(first)), &repeated);
+  EXPECT_EQ(cache.size(), 2);
+}
+
 void test_multi(const std::string& line, int arg1, int arg2) {
   const auto parsed = multi_command(line);
   ASSERT_TRUE(parsed);
@@ -196,6 +309,28 @@ TEST(MultiCommand, Only) {
   bad_multi("multi 5555555555555555555555555555");
 }
 
+void test_grid(const std::string& line, std::vector<int> bankrolls,
+               std::vector<int> goals) {
+  const auto parsed = bankroll_grid_command(line);
+  ASSERT_TRUE(parsed);
+  EXPECT_EQ(parsed->bankrolls.values(), bankrolls);
+  EXPECT_EQ(parsed->goals.values(), goals);
+}
+
+TEST(BankrollGridCommand, Only) {
+  test_grid("bankroll grid 10 30 10 40 45 1", {10, 20, 30},
+            {40, 41, 42, 43, 44, 45});
+  test_grid("bankroll  grid 16 16 5 20 39 10  ", {16}, {20, 30});
+  EXPECT_FALSE(bankroll_grid_command("bankroll grid"));
+  EXPECT_FALSE(bankroll_grid_command("bankroll grid 1 2 3 4 5"));
+  EXPECT_FALSE(bankroll_grid_command("bankroll grid 1 2 3 4 5 6 7"));
+  EXPECT_FALSE(bankroll_grid_command("bankroll grid 0 2 3 4 5 6"));
+  EXPECT_FALSE(bankroll_grid_command("bankroll grid 3 2 1 4 5 6"));
+  EXPECT_FALSE(bankroll_grid_command("bankroll grid 1 2 0 4 5 6"));
+  EXPECT_FALSE(bankroll_grid_command("bankroll grid 1 2 1 4 5 x"));
+  EXPECT_FALSE(bankroll_grid_command("multi 5 6"));
+}
+
 enum Deck { cards52, cards53 };
 std::string PrintCombinations(const pay_prob& prob_pays,
                               const int (&pay_table)[], Deck deck) {
@@ -488,3 +623,1122 @@ TEST(GetPayback, NsuDeuces) {
 38224692 Royal Flush
 )");
 }
+
+TEST(RunWorkers, RethrowsFirstException) {
+  // An exception in any worker stops the handing out of units and is
+  // thrown again on the calling thread once every thread has finished.
+  for (const unsigned threads : {1u, 4u}) {
+    std::atomic<int> done = 0;
+    EXPECT_THROW(run_workers(
+                     1000, threads, [] { return 0; },
+                     [&](int, std::size_t u) {
+                       if (u == 10) {
+                         throw std::runtime_error("unit 10");
+                       }
+                       done++;
+                     }),
+                 std::runtime_error);
+    EXPECT_LT(done, 1000);
+  }
+
+  EXPECT_THROW(run_workers(
+                   10, 3, []() -> int { throw 0; }, [](int, std::size_t) {}),
+               int);
+}
+
+TEST(GetPayback, ParallelMatchesSerial) {
+  const int fp_table[] = {
+      0,    // nothing,
+      0,    // high_pair,
+      0,    // two_pair,
+      1,    // trips,
+      2,    // straight,
+      2,    // flush,
+      3,    // full_house,
+      5,    // quads,
+      0,    // quad aces",
+      0,    // quad aces w/low kicker",
+      0,    // quad 2-4",
+      0,    // quad 2-4 w/low kicker",
+      9,    // straight_flush,
+      15,   // quints,
+      25,   // wild_royal,
+      200,  // four_deuces,
+      800    // royal_flush
+  };
+
+  const vp_game full_pay_deuces("Full Pay Deuces Wild", GK_deuces_wild, ace,
+                                &fp_table);
+  pay_prob serial_pays;
+  const double serial_ev = get_payback(full_pay_deuces, serial_pays);
+
+  for (const unsigned threads : {1u, 3u}) {
+    pay_prob parallel_pays;
+    const double parallel_ev =
+        get_payback_parallel(full_pay_deuces, parallel_pays, threads);
+
+    // The results must be identical, not merely close.
+    EXPECT_EQ(parallel_ev, serial_ev);
+    for (int j = first_pay; j <= last_pay; j++) {
+      EXPECT_EQ(parallel_pays[j], serial_pays[j]) << "payoff " << j;
+    }
+  }
+}
+
+TEST(HandIter, RankAndSeek) {
+  const struct {
+    game_kind kind;
+    int wild_cards;
+  } configs[] = {{GK_no_wild, 0},
+                 {GK_deuces_wild, 2},
+                 {GK_one_eyed_jacks_wild, 1}};
+
+  for (const auto &config : configs) {
+    const int hand_size = 5 - config.wild_cards;
+    hand_iter iter(hand_size, config.kind, config.wild_cards);
+    hand_iter random(iter);
+    unsigned index = 0;
+    unsigned dealt = 0;
+
+    while (!iter.done()) {
+      ASSERT_EQ(iter.rank(), index);
+      ASSERT_EQ(random.dealt_before(index), dealt);
+
+      random.seek(index);
+      card expected[5], actual[5];
+      iter.current(expected[0]);
+      random.current(actual[0]);
+      for (int j = 0; j < hand_size; j++) {
+        ASSERT_EQ(actual[j], expected[j]);
+      }
+      ASSERT_EQ(random.multiplier(), iter.multiplier());
+
+      dealt += iter.multiplier();
+      index += 1;
+      iter.next();
+    }
+
+    EXPECT_EQ(iter.count(), index);
+    EXPECT_EQ(iter.rank(), index);
+
+    // The ranges cover everything, and each represents
+    // about the same number of dealt hands.
+    const std::vector<hand_iter::range> ranges = iter.split(0, index, 5);
+    ASSERT_EQ(ranges.size(), 5);
+    EXPECT_EQ(ranges.front().first, 0);
+    EXPECT_EQ(ranges.back().last, index);
+    for (std::size_t j = 0; j < ranges.size(); j++) {
+      if (j > 0) {
+        EXPECT_EQ(ranges[j].first, ranges[j - 1].last);
+      }
+      const unsigned part = iter.dealt_before(ranges[j].last) -
+                            iter.dealt_before(ranges[j].first);
+      EXPECT_NEAR(part, dealt / 5.0, dealt / 100.0);
+    }
+  }
+}
+
+TEST(HandTable, WriteAndMap) {
+  const hand_table built(GK_deuces_wild);
+  const std::string filename = "test_" + hand_table::file_name(GK_deuces_wild);
+  built.write(filename);
+
+  {
+    const hand_table mapped(filename);
+    ASSERT_EQ(mapped.kind(), GK_deuces_wild);
+    ASSERT_EQ(mapped.max_wild_cards(), 4);
+
+    for (int wild_cards = 0; wild_cards <= 4; wild_cards++) {
+      const int hand_size = 5 - wild_cards;
+      hand_iter iter(hand_size, GK_deuces_wild, wild_cards);
+      const auto hands = mapped.hands(wild_cards);
+      ASSERT_EQ(hands.size(), iter.count());
+
+      for (const hand_record &r : hands) {
+        card expected[5];
+        iter.current(expected[0]);
+        for (int j = 0; j < hand_size; j++) {
+          ASSERT_EQ(r.cards[j], expected[j]);
+        }
+        ASSERT_EQ(r.wild_cards, wild_cards);
+        ASSERT_EQ(r.multiplier, iter.multiplier());
+        iter.next();
+      }
+    }
+  }
+
+  std::remove(filename.c_str());
+}
+
+TEST(HandTable, RejectsBadHeaders) {
+  // Each bad header keeps the file the size its last first[] claims,
+  // so only the other checks can catch it.
+  const hand_table built(GK_joker_wild);
+  const std::string filename = hand_table::file_name(GK_joker_wild);
+  built.write(filename);
+
+  std::string good;
+  {
+    std::ifstream in(filename, std::ios::binary);
+    good.assign(std::istreambuf_iterator<char>(in),
+                std::istreambuf_iterator<char>());
+  }
+  auto field = [](std::string &image, int offset) {
+    return reinterpret_cast<std::uint32_t *>(image.data() + offset);
+  };
+  const int max_wild_cards = 16;
+  const int first = 20;
+  const std::uint32_t total = *field(good, first + 2 * 4);
+
+  auto rewrite = [&](const std::string &image) {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(image.data(), image.size());
+  };
+
+  std::string bad = good;
+  *field(bad, first) = 1;
+  rewrite(bad);
+  EXPECT_THROW(hand_table{filename}, std::runtime_error);
+
+  bad = good;
+  *field(bad, first + 4) = total + 1;
+  rewrite(bad);
+  EXPECT_THROW(hand_table{filename}, std::runtime_error);
+
+  bad = good;
+  *field(bad, max_wild_cards) = 2;
+  *field(bad, first + 3 * 4) = total;
+  rewrite(bad);
+  EXPECT_THROW(hand_table{filename}, std::runtime_error);
+
+  // A bad file is rebuilt rather than mapped.
+  const auto opened = hand_table::open(GK_joker_wild);
+  ASSERT_EQ(opened->max_wild_cards(), 1);
+  for (int wild_cards = 0; wild_cards <= 1; wild_cards++) {
+    EXPECT_EQ(opened->hands(wild_cards).size(),
+              built.hands(wild_cards).size());
+  }
+
+  std::remove(filename.c_str());
+}
+
+TEST(KeptBuilder, MatchesConstructor) {
+  // Every subset built incrementally must describe the same draws
+  // as one built from scratch, for every kind of game.  Joker games
+  // are usually kings or better.
+  const std::pair<game_kind, denom_value> games[] = {
+      {GK_no_wild, jack},
+      {GK_deuces_wild, jack},
+      {GK_joker_wild, king},
+      {GK_one_eyed_jacks_wild, jack}};
+  for (const auto& [kind, high] : games) {
+    const hand_table table(kind);
+    game_parameters parms(kind, high);
+    C_left left(parms);
+
+    for (int wild_cards = 0; wild_cards <= table.max_wild_cards();
+         wild_cards++) {
+      const int hand_size = 5 - wild_cards;
+      const auto hands = table.hands(wild_cards);
+
+      for (std::size_t h = 0; h < hands.size(); h += 11) {
+        const card *hand = hands[h].cards;
+        left.remove(hand, hand_size, wild_cards);
+
+        kept_builder builder(hand, hand_size, parms);
+        int visited = 0;
+        do {
+          const unsigned mask = builder.mask();
+          kept_description expected(hand, hand_size, mask, parms);
+          kept_description &kept = builder.current();
+
+          ASSERT_STREQ(kept.display(), expected.display())
+              << kind << " " << h << " " << mask;
+          ASSERT_EQ(kept.move_name(), expected.move_name());
+          ASSERT_EQ(kept.number_of_discards(), expected.number_of_discards());
+
+          for (int keep = 0; keep <= wild_cards; keep++) {
+            pay_dist pays, expected_pays;
+            kept.all_draws(keep, left, pays);
+            expected.all_draws(keep, left, expected_pays);
+            for (int j = first_pay; j <= last_pay; j++) {
+              ASSERT_EQ(pays[j], expected_pays[j])
+                  << kind << " " << h << " " << mask;
+            }
+          }
+          visited += 1;
+        } while (builder.next());
+        ASSERT_EQ(visited, 1 << hand_size);
+
+        left.replace(hand, hand_size, wild_cards);
+      }
+    }
+  }
+}
+
+TEST(CountDraws, CountsEachDrawOnceWithWildCards) {
+  // Every draw to a hand that keeps its wild cards must be counted
+  // under exactly one payoff.
+  const std::pair<game_kind, denom_value> games[] = {
+      {GK_deuces_wild, ace},
+      {GK_joker_wild, king},
+      {GK_one_eyed_jacks_wild, jack}};
+  for (const auto& [kind, high] : games) {
+    const hand_table table(kind);
+    game_parameters parms(kind, high);
+    C_left left(parms);
+
+    for (int wild_cards = 0; wild_cards <= table.max_wild_cards();
+         wild_cards++) {
+      const int hand_size = 5 - wild_cards;
+      const auto hands = table.hands(wild_cards);
+
+      for (std::size_t h = 0; h < hands.size(); h += 7) {
+        const card *hand = hands[h].cards;
+        left.remove(hand, hand_size, wild_cards);
+
+        for (unsigned mask = 0; mask < 1u << hand_size; mask++) {
+          pay_dist pays;
+          kept_description(hand, hand_size, mask, parms)
+              .count_draws(wild_cards, left, pays);
+          const int draws = hand_size - std::popcount(mask);
+          ASSERT_EQ(std::accumulate(pays, pays + last_pay + 1, 0),
+                    combin.choose(parms.deck_size - 5, draws))
+              << kind << " " << move_image(hand, hand_size, mask);
+        }
+
+        left.replace(hand, hand_size, wild_cards);
+      }
+    }
+  }
+
+  // Three deuces with an ace and a six are quads, and not quad aces
+  // as well.
+  game_parameters parms(games::deuces_wild);
+  C_left left(parms);
+  const card hand[] = {make_card(ace, 0), make_card(six, 1)};
+  left.remove(hand, 2, 3);
+  pay_dist pays;
+  kept_description(hand, 2, 3, parms).count_draws(3, left, pays);
+  for (int j = first_pay; j <= last_pay; j++) {
+    EXPECT_EQ(pays[j], j == N_quads ? 1 : 0) << payoff_image[j];
+  }
+}
+
+TEST(CountDraws, OneEyedJackThrownAway) {
+  // A dealt one-eyed jack is deemed to be suit zero, so throwing it
+  // away leaves the suit one jack.  It makes a natural royal in its
+  // own suit and a wild royal in the others; suit two also has its
+  // own natural jack.
+  game_parameters parms(GK_one_eyed_jacks_wild, jack);
+  C_left left(parms);
+  for (const int s : {0, 1, 2}) {
+    const card hand[] = {make_card(ace, s), make_card(ten, s),
+                         make_card(queen, s), make_card(king, s)};
+    left.remove(hand, 4, 1);
+    pay_dist pays;
+    kept_description(hand, 4, 0xf, parms).count_draws(0, left, pays);
+    EXPECT_EQ(pays[N_royal_flush], s == 0 ? 0 : 1) << s;
+    EXPECT_EQ(pays[N_wild_royal], s == 1 ? 0 : 1) << s;
+    EXPECT_EQ(std::accumulate(pays, pays + last_pay + 1, 0),
+              parms.deck_size - 5)
+        << s;
+    left.replace(hand, 4, 1);
+  }
+}
+
+TEST(DrawCache, MatchesGetPayback) {
+  const int jb_table[] = {0, 1, 2, 3,  4, 6, 9, 25,  0,
+                          0, 0, 0, 50, 0, 0, 0, 800};
+  const int ddb_table[] = {0,   1,  1,   3,  5, 6, 9, 50,  160,
+                           400, 80, 160, 50, 0, 0, 0, 800};
+  const vp_game jacks_or_better("9/6 Jacks or Better", GK_no_wild, jack,
+                                &jb_table);
+  const vp_game double_double_bonus("9/6 Double Double Bonus", GK_no_wild,
+                                    jack, &ddb_table);
+
+  // Scoring different pay tables from one set of counts must give
+  // exactly what the full computation does.
+  const draw_cache cache(GK_no_wild, jack);
+
+  for (const vp_game *game : {&jacks_or_better, &double_double_bonus}) {
+    pay_prob expected_pays;
+    const double expected_ev = get_payback(*game, expected_pays);
+
+    pay_prob cached_pays;
+    const double cached_ev = cache.get_payback(*game, cached_pays);
+
+    EXPECT_EQ(cached_ev, expected_ev) << game->name;
+    for (int j = first_pay; j <= last_pay; j++) {
+      EXPECT_EQ(cached_pays[j], expected_pays[j]) << game->name << " " << j;
+    }
+  }
+}
+
+TEST(DrawCache, WriteAndRead) {
+  const draw_cache built(GK_no_wild, king);
+  const std::string filename = "test_draws.bin";
+  built.write(filename);
+
+  const hand_table hands(GK_no_wild);
+  EXPECT_EQ(built.fingerprint(), draw_cache::fingerprint(GK_no_wild, king,
+                                                         hands));
+  EXPECT_NE(built.fingerprint(), draw_cache::fingerprint(GK_no_wild, jack,
+                                                         hands));
+
+  const int kb_table[] = {0, 0, 2, 3,  4, 6, 9, 25,  0,
+                          0, 0, 0, 50, 0, 0, 0, 800};
+  const vp_game kings_or_better("Test Kings or Better", GK_no_wild, king,
+                                &kb_table);
+  {
+    const draw_cache read(filename);
+    EXPECT_EQ(read.fingerprint(), built.fingerprint());
+
+    pay_prob built_pays, read_pays;
+    EXPECT_EQ(read.get_payback(kings_or_better, read_pays),
+              built.get_payback(kings_or_better, built_pays));
+  }
+
+  // A file that was cut short is rejected.
+  std::filesystem::resize_file(filename,
+                               std::filesystem::file_size(filename) - 4);
+  EXPECT_THROW(draw_cache{filename}, std::runtime_error);
+
+  std::remove(filename.c_str());
+}
+
+TEST(DrawTable, MatchesCaseAnalysis) {
+  // Every way of playing every hand, counted both ways.
+  EXPECT_EQ(draw_table::validate(jack), 0u);
+  EXPECT_EQ(draw_table::validate(king), 0u);
+}
+
+TEST(DrawTable, FallsBackWhenMoreCardsAreGone) {
+  // With a card gone besides the five dealt, all_draws can't use the
+  // table, and must count the draws from what is left.
+  game_parameters parms(games::jacks_or_better);
+  C_left left(parms);
+  const card hand[] = {make_card(ace, 0), make_card(ten, 0),
+                       make_card(jack, 0), make_card(queen, 0),
+                       make_card(three, 2)};
+  const card gone = make_card(king, 0);
+  left.remove(hand, 5, 0);
+
+  kept_description kept(hand, 5, 0xf, parms);
+  pay_dist table_pays;
+  kept.all_draws(0, left, table_pays);
+  EXPECT_EQ(table_pays[N_royal_flush], 1);
+
+  left.remove(&gone, 1, 0);
+  pay_dist pays, expected;
+  kept.all_draws(0, left, pays);
+  kept.count_draws(0, left, expected);
+  for (int j = first_pay; j <= last_pay; j++) {
+    EXPECT_EQ(pays[j], expected[j]) << payoff_image[j];
+  }
+  // Drawing one of the 46 cards left: eight spades make a flush,
+  // three other kings a straight, and nine aces, queens and jacks a
+  // high pair.
+  int total = 0;
+  for (int j = first_pay; j <= last_pay; j++) {
+    total += pays[j];
+  }
+  EXPECT_EQ(total, 46);
+  EXPECT_EQ(pays[N_royal_flush], 0);
+  EXPECT_EQ(pays[N_flush], 8);
+  EXPECT_EQ(pays[N_straight], 3);
+  EXPECT_EQ(pays[N_high_pair], 9);
+  left.replace(&gone, 1, 0);
+  left.replace(hand, 5, 0);
+}
+
+TEST(HoldKernel, MatchesPlayValue) {
+  const pay_values pay_table = {0, 1, 2, 3,  4, 6, 9, 25,  0,
+                                0, 0, 0, 50, 0, 0, 0, 800};
+  std::mt19937 gen(17);
+  std::uniform_int_distribution<int> count(0, 16215);
+
+  for (int rows : {1, 5, 16, 24, 32}) {
+    hold_table holds;
+    for (int row = 0; row < rows; row++) {
+      pay_dist pays;
+      for (int j = first_pay; j <= last_pay; j++) {
+        pays[j] = count(gen);
+      }
+      holds.add(pays);
+    }
+
+    // Every kernel the machine supports must agree with play_value
+    // exactly, and pick the same play.
+    for (int k = 0; k <= static_cast<int>(best_hold_kernel()); k++) {
+      double values[hold_table::max_rows];
+      const int best =
+          score_holds(holds, pay_table, values, static_cast<hold_kernel>(k));
+
+      int expected_best = 0;
+      for (int row = 0; row < rows; row++) {
+        pay_dist pays;
+        holds.get(row, pays);
+        const double expected = play_value(pays, pay_table);
+        EXPECT_EQ(values[row], expected) << k << " " << row;
+        if (row > 0 && expected > values[expected_best]) {
+          expected_best = row;
+        }
+      }
+      EXPECT_EQ(best, expected_best) << k;
+    }
+  }
+}
+
+TEST(CompiledMatcher, MatchesInterpreter) {
+  struct section {
+    game_kind kind;
+    denom_value min_pair;
+    int wild_cards;
+    std::vector<const char *> lines;
+  };
+  const section sections[] = {
+      {GK_no_wild,
+       jack,
+       0,
+       {"Full House or Quads",
+        "Trips",
+        "Two Pair",
+        "RF 4",
+        "RF 3 (KQT or KJT) [no sp, no high pair]",
+        "SF 4 i",
+        "Pair of J-A",
+        "Flush 4",
+        "RF 3 (K high) [others]",
+        "Pair of 2-T",
+        "Straight 4 (5-Q high)",
+        "SF 3 di h1 [dsc AQ suited]",
+        "SF 3 di h1 [no paired gp]",
+        "SF 3 di h0 [dsc gp]",
+        "SF 2 i (8T) [dsc 57 suited]",
+        "RF 2 (QT) [no K8, A9, 569 suited, or 579 suited]",
+        "RF 2 (QT) [no fp, dsc sp, no K8]",
+        "RF 2 (JT) [dsc A8 or A9]",
+        "Flush 3 h2 (K high) [dsc >= 9]",
+        "Flush 3 (K high, with T) [dsc 9]",
+        "KQ or KJ [no 9 or T]",
+        "QJ [dsc A]",
+        "Just an A [dsc T offsuit]",
+        "Just an A [no <= 5]",
+        "Just a J [no fp] [no 5689]",
+        "Nothing"}},
+      {GK_deuces_wild,
+       three,
+       0,
+       {"Natural Royal Flush",
+        "Straight, Flush, or Straight Flush",
+        "SF 3 di (JT7) [dsc AK]",
+        "SF 3 di (JT7) [dsc Q, no 8]",
+        "QT98 << RF 2 (QT) [no fp, no A or K]",
+        "AKQT << RF 2 (QT) [no fp, no 8 or 9]",
+        "Straight 4 i (J-A high)",
+        "RF 2 (K high) [no fp, no sp]",
+        "3456",
+        "Nothing"}},
+      {GK_deuces_wild,
+       three,
+       1,
+       {"Straight Flush",
+        "SF 4 (7-Q high)",
+        "Full House, Flush, or Straight",
+        "Quints",
+        "Trips",
+        "SF 4 any",
+        "RF 3 (AK or AQ) [no fp, no sp, no 3]",
+        "SF 3 (7-T high)",
+        "Just the deuce"}},
+      {GK_deuces_wild,
+       three,
+       2,
+       {"Quads", "RF 4", "SF 4 (7-T high)", "Just the deuces"}},
+  };
+
+  // Every line on every hand must give the same plays as the
+  // interpreter, in the same order, since the first one is the play.
+  for (const section &s : sections) {
+    game_parameters parms(s.kind, s.min_pair);
+    const hand_table table(s.kind);
+
+    EnumerateMatches expected;
+    CompiledMatcher matcher;
+    expected.hand_size = matcher.hand_size = 5 - s.wild_cards;
+    expected.wild_cards = matcher.wild_cards = s.wild_cards;
+    expected.parms = matcher.parms = &parms;
+
+    std::vector<StrategyLine> lines;
+    for (const char *image : s.lines) {
+      lines.push_back(parse_line(image, s.wild_cards));
+    }
+
+    for (const hand_record &r : table.hands(s.wild_cards)) {
+      std::copy(r.cards, r.cards + 5, expected.hand);
+      std::copy(r.cards, r.cards + 5, matcher.hand);
+      for (std::size_t j = 0; j < lines.size(); j++) {
+        expected.find(lines[j].pattern);
+        matcher.find(lines[j]);
+        ASSERT_EQ(matcher.match_count, expected.match_count)
+            << s.lines[j] << " "
+            << move_image(r.cards, expected.hand_size, 0);
+        for (int k = 0; k < expected.match_count; k++) {
+          ASSERT_EQ(matcher.matches[k], expected.matches[k]) << s.lines[j];
+        }
+        for (int mask = 0; mask < 32; mask++) {
+          ASSERT_EQ(matcher.result_vector[mask], expected.result_vector[mask])
+              << s.lines[j];
+        }
+      }
+    }
+  }
+}
+
+TEST(HandClassifier, CountsMatchMultipliers) {
+  // Every dealt hand must find a canonical hand, and each canonical
+  // hand must be found as many times as the hands it stands for.
+  // The suit map must turn the dealt hand into the canonical hand.
+  for (game_kind kind :
+       {GK_no_wild, GK_deuces_wild, GK_one_eyed_jacks_wild}) {
+    game_parameters parms(kind, jack);
+    const hand_table table(kind);
+    const hand_classifier classifier(parms, table);
+    const int deck_wild_cards = kind == GK_deuces_wild ? 4
+                                : kind == GK_no_wild   ? 0
+                                                       : 2;
+
+    std::vector<unsigned> counts[5];
+    for (int w = 0; w <= table.max_wild_cards(); w++) {
+      counts[w].resize(table.hands(w).size());
+    }
+
+    card hand[5];
+    for (hand[0] = 0; hand[0] < deck_size; hand[0]++) {
+      for (hand[1] = hand[0] + 1; hand[1] < deck_size; hand[1]++) {
+        for (hand[2] = hand[1] + 1; hand[2] < deck_size; hand[2]++) {
+          for (hand[3] = hand[2] + 1; hand[3] < deck_size; hand[3]++) {
+            for (hand[4] = hand[3] + 1; hand[4] < deck_size; hand[4]++) {
+              const hand_classifier::sorted_hand h = classifier.sort(hand);
+              const hand_classifier::hand_class c = classifier.classify(h);
+              counts[h.wild_cards][c.hand] += 1;
+
+              // Relabeling the suits must give the canonical hand.
+              card relabeled[5];
+              int size = 0;
+              for (int j = 0; j < 5; j++) {
+                if (!parms.is_wild(hand[j])) {
+                  relabeled[size++] =
+                      make_card(pips(hand[j]), c.suit_map[suit(hand[j])]);
+                }
+              }
+              std::sort(relabeled, relabeled + size);
+              const card *expected = table.hands(h.wild_cards)[c.hand].cards;
+              ASSERT_TRUE(std::equal(relabeled, relabeled + size, expected))
+                  << kind << " " << move_image(hand, 5, 0);
+            }
+          }
+        }
+      }
+    }
+
+    for (int w = 0; w <= table.max_wild_cards(); w++) {
+      const auto hands = table.hands(w);
+      for (std::size_t j = 0; j < hands.size(); j++) {
+        ASSERT_EQ(counts[w][j],
+                  hands[j].multiplier * combin.choose(deck_wild_cards, w))
+            << kind << " " << w << " " << j;
+      }
+    }
+  }
+}
+
+TEST(DecisionTable, MatchesStrategyScan) {
+  struct game {
+    game_kind kind;
+    denom_value min_pair;
+    std::vector<std::vector<const char *>> lines;
+  };
+  const game games[] = {
+      {GK_no_wild,
+       jack,
+       {{"RF 4", "Full House or Quads", "Trips", "Two Pair", "Straight",
+         "Flush", "SF 4", "Pair of J-A", "RF 3", "Flush 4", "Straight 4",
+         "Pair of 2-T", "SF 3 h1", "AKQJ", "RF 2 (QJ) [no fp]",
+         "Flush 3 h2", "SF 3 i h0 [no sp]", "QJ [dsc A]", "Just a J [no fp]",
+         "Nothing"}}},
+      {GK_deuces_wild,
+       three,
+       {{"Natural Royal Flush", "Straight, Flush, or Straight Flush", "RF 4",
+         "Trips", "SF 4", "One Pair", "Flush 4", "RF 2 (K high) [no fp]",
+         "Nothing"},
+        {"Straight Flush", "RF 4", "Trips", "SF 4 any", "RF 3",
+         "Just the deuce"},
+        {"Quads", "RF 4", "SF 4 (7-T high)", "Just the deuces"},
+        {"Wild Royal Flush", "Quints (T-A high)", "Just the deuces"},
+        {"Just the deuces"}}},
+  };
+
+  // The play looked up for a dealt hand must be the one found by
+  // sorting the hand and trying the lines in order, as the trainer did.
+  for (const game &g : games) {
+    game_parameters parms(g.kind, g.min_pair);
+    const hand_table table(g.kind);
+
+    std::vector<std::vector<StrategyLine>> strategy;
+    for (std::size_t w = 0; w < g.lines.size(); w++) {
+      strategy.emplace_back();
+      for (const char *line : g.lines[w]) {
+        strategy.back().push_back(parse_line(line, static_cast<int>(w)));
+      }
+    }
+    const decision_table decisions(parms, table, strategy);
+
+    std::mt19937 gen(5);
+    for (int trial = 0; trial < 20000; trial++) {
+      card deck[deck_size];
+      std::iota(deck, deck + deck_size, 0);
+      std::shuffle(deck, deck + deck_size, gen);
+      card *const dealt = deck;
+
+      EnumerateMatches matcher;
+      matcher.parms = &parms;
+      int positions[5];
+      unsigned wild_mask = 0;
+      int hand_size = 0;
+      card sorted[5];
+      std::copy(dealt, dealt + 5, sorted);
+      std::sort(sorted, sorted + 5);
+      for (int j = 0; j < 5; j++) {
+        const int p = static_cast<int>(std::find(dealt, dealt + 5, sorted[j]) -
+                                       dealt);
+        if (parms.is_wild(sorted[j])) {
+          wild_mask |= 1 << p;
+        } else {
+          matcher.hand[hand_size] = sorted[j];
+          positions[hand_size++] = p;
+        }
+      }
+      matcher.hand_size = hand_size;
+      matcher.wild_cards = 5 - hand_size;
+
+      const hand_classifier::sorted_hand h =
+          decisions.classifier().sort(dealt);
+      const decision_table::decision &d = decisions.find(h);
+      ASSERT_EQ(h.wild_mask, wild_mask);
+
+      int line = -1;
+      const auto &lines = strategy[matcher.wild_cards];
+      for (std::size_t j = 0; j < lines.size(); j++) {
+        matcher.find(lines[j].pattern);
+        if (matcher.match_count != 0) {
+          line = static_cast<int>(j);
+          break;
+        }
+      }
+      ASSERT_EQ(d.line, line) << trial;
+      if (line < 0) {
+        continue;
+      }
+
+      // When the line allows more than one play, which comes first
+      // depends on the suits, so the play need only be one of them.
+      std::uint32_t plays = 0;
+      bool found_play = false;
+      for (int k = 0; k < matcher.match_count; k++) {
+        unsigned mask = 0;
+        for (int j = 0; j < hand_size; j++) {
+          if ((matcher.matches[k] >> j) & 1) {
+            mask |= 1 << positions[j];
+          }
+        }
+        plays |= std::uint32_t(1) << hand_classifier::canonical_mask(h, mask);
+        found_play |= hand_classifier::hand_mask(h, d.mask) == mask;
+      }
+      EXPECT_EQ(d.plays, plays) << trial;
+      EXPECT_TRUE(found_play) << trial;
+    }
+  }
+}
+
+TEST(PlayOracle, MatchesDirectEvaluation) {
+  // Every play of a dealt hand must have the value found by counting
+  // the draws of that play of that hand, and a batch must give the
+  // same answers as one query at a time.
+  for (const vp_game *game : {&games::jacks_or_better, &games::deuces_wild}) {
+    game_parameters parms(*game);
+    C_left left(parms);
+    const play_oracle oracle(parms);
+
+    const int trials = 2000;
+    std::vector<card> hands;
+    std::mt19937 gen(11);
+    for (int trial = 0; trial < trials; trial++) {
+      card deck[deck_size];
+      std::iota(deck, deck + deck_size, 0);
+      std::shuffle(deck, deck + deck_size, gen);
+      hands.insert(hands.end(), deck, deck + 5);
+    }
+
+    std::vector<play_oracle::answer> answers(trials);
+    oracle.query(hands.data(), trials, answers.data(), 4);
+
+    for (int trial = 0; trial < trials; trial++) {
+      const card *dealt = &hands[5 * trial];
+      const play_oracle::answer a = oracle.query(dealt);
+
+      // kept_description wants the cards in order.
+      int order[5] = {0, 1, 2, 3, 4};
+      std::sort(order, order + 5,
+                [dealt](int x, int y) { return dealt[x] < dealt[y]; });
+      card cards[5];
+      int positions[5];
+      int hand_size = 0;
+      unsigned wild_mask = 0;
+      for (const int j : order) {
+        if (parms.is_wild(dealt[j])) {
+          wild_mask |= 1 << j;
+        } else {
+          cards[hand_size] = dealt[j];
+          positions[hand_size++] = j;
+        }
+      }
+      const int wild_cards = 5 - hand_size;
+
+      left.remove(cards, hand_size, wild_cards);
+      double best_value = -1.0;
+      for (unsigned play = 0; play < 32; play++) {
+        unsigned mask = 0;
+        for (int j = 0; j < hand_size; j++) {
+          if ((play >> positions[j]) & 1) {
+            mask |= 1 << j;
+          }
+        }
+        kept_description kept(cards, hand_size, mask, parms);
+        pay_dist pays;
+        kept.all_draws(std::popcount(play & wild_mask), left, pays);
+        const double value = play_value(pays, parms.pay_table);
+
+        ASSERT_EQ(a.values[play], value) << trial << " " << play;
+        ASSERT_EQ(answers[trial].values[play], value);
+        best_value = std::max(best_value, value);
+      }
+      left.replace(cards, hand_size, wild_cards);
+
+      for (unsigned play = 0; play < 32; play++) {
+        EXPECT_EQ((a.best >> play) & 1, a.values[play] == best_value);
+      }
+      EXPECT_EQ(a.play, std::countr_zero(a.best));
+      EXPECT_EQ(answers[trial].best, a.best);
+    }
+    EXPECT_LE(oracle.classes_evaluated(), static_cast<std::size_t>(trials));
+  }
+}
+
+// About 9/6 Jacks or Better, with two unused payoffs that pay the same
+// as used ones.
+void jacks_bankroll(pay_prob& probs, pay_values& pays) {
+  const double pay[last_pay + 1] = {0, 1, 2,  3,  4, 6, 9, 25, 25,
+                                    25, 25, 25, 50, 0, 0, 0, 800};
+  const double prob[last_pay + 1] = {
+      0.545447, 0.214585, 0.129279, 0.074449, 0.011229, 0.011015,
+      0.011512, 0.002363, 0,        0,        0,        0,
+      0.000109, 0,        0,        0,        0.000025};
+  const double total = std::accumulate(prob, prob + last_pay + 1, 0.0);
+  for (int j = first_pay; j <= last_pay; j++) {
+    pays[j] = pay[j];
+    probs[j] = prob[j] / total;
+  }
+}
+
+// One game, payoff by payoff at every bankroll.
+std::vector<double> bankroll_game(const pay_prob& probs,
+                                  const pay_values& pays,
+                                  const std::vector<double>& current) {
+  const int goal = static_cast<int>(current.size());
+  std::vector<double> next(goal);
+  next[0] = current[0];
+  for (int bankroll = 1; bankroll < goal; bankroll++) {
+    for (int p = first_pay; p <= last_pay; p++) {
+      int new_roll = bankroll - 1 + static_cast<int>(pays[p]);
+      if (new_roll >= goal) {
+        new_roll = 0;
+      }
+      next[new_roll] += probs[p] * current[bankroll];
+    }
+  }
+  return next;
+}
+
+TEST(Bankroll, Chain) {
+  pay_prob probs;
+  pay_values pays;
+  jacks_bankroll(probs, pays);
+
+  for (const int goal : {2, 20, 900}) {
+    const bankroll_chain chain(probs, pays, goal);
+    std::vector<double> expected = chain.start(goal / 2);
+    std::vector<double> current = expected;
+    std::vector<double> next(goal);
+    int median = -1;
+    for (int game = 1; game <= 200; game++) {
+      const std::vector<double> previous = expected;
+      expected = bankroll_game(probs, pays, expected);
+      chain.step(current, next);
+      current.swap(next);
+      for (int b = 0; b < goal; b++) {
+        ASSERT_NEAR(current[b], expected[b], 1e-15) << goal << " " << game;
+      }
+      if (median < 0 && expected[0] >= 0.5) {
+        median = 0.5 - previous[0] > expected[0] - 0.5 ? game - 1 : game;
+      }
+    }
+    if (median >= 0) {
+      EXPECT_EQ(chain.median_length(goal / 2), median);
+    }
+  }
+}
+
+TEST(Bankroll, Advance) {
+  pay_prob probs;
+  pay_values pays;
+  jacks_bankroll(probs, pays);
+
+  // Small enough that advance squares the transition.
+  const bankroll_chain chain(probs, pays, 12);
+  std::vector<double> squared = chain.start(5);
+  chain.advance(squared, 1000);
+
+  std::vector<double> stepped = chain.start(5);
+  std::vector<double> next(12);
+  for (int game = 0; game < 1000; game++) {
+    chain.step(stepped, next);
+    stepped.swap(next);
+  }
+  for (int b = 0; b < 12; b++) {
+    EXPECT_NEAR(squared[b], stepped[b], 1e-12) << b;
+  }
+}
+
+TEST(Bankroll, Ruin) {
+  pay_prob probs;
+  pay_values pays;
+  jacks_bankroll(probs, pays);
+  ruin_solver ruin(probs, pays);
+
+  for (const int goal : {1, 2, 7, 40}) {
+    // Play until the chance of still playing is negligible.
+    std::vector<double> bust(goal + 1);
+    bust[0] = 1.0;
+    for (int game = 0; game < 20000; game++) {
+      for (int bankroll = 1; bankroll < goal; bankroll++) {
+        double sum = 0.0;
+        for (int p = first_pay; p <= last_pay; p++) {
+          const int next = bankroll - 1 + static_cast<int>(pays[p]);
+          if (next < goal) {
+            sum += probs[p] * bust[next];
+          }
+        }
+        bust[bankroll] = sum;
+      }
+    }
+    for (int bankroll = 0; bankroll <= goal; bankroll++) {
+      EXPECT_NEAR(ruin.bust_prob(bankroll, goal), bust[bankroll], 1e-12)
+          << bankroll << " " << goal;
+    }
+  }
+
+  const std::vector<int> goals = ruin.break_even_goals(200);
+  for (int bankroll = 0; bankroll <= 200; bankroll += 25) {
+    const int goal = ruin.break_even_goal(bankroll);
+    EXPECT_EQ(goals[bankroll], goal);
+    EXPECT_LE(ruin.bust_prob(bankroll, goal), 0.5);
+    EXPECT_GT(ruin.bust_prob(bankroll, goal + 1), 0.5);
+  }
+}
+
+TEST(Bankroll, MedianLengths) {
+  pay_prob probs;
+  pay_values pays;
+  jacks_bankroll(probs, pays);
+
+  for (const int goal : {2, 20, 150}) {
+    const bankroll_chain chain(probs, pays, goal);
+    const std::vector<int> lengths = chain.median_lengths();
+    ASSERT_EQ(lengths.size(), goal);
+    for (int bankroll = 0; bankroll < goal; bankroll++) {
+      EXPECT_EQ(lengths[bankroll], chain.median_length(bankroll))
+          << goal << " " << bankroll;
+    }
+  }
+}
+
+TEST(SessionSim, AliasTable) {
+  pay_prob probs;
+  pay_values pays;
+  jacks_bankroll(probs, pays);
+  const alias_table table(games::jacks_or_better, probs);
+
+  const int trials = 2000000;
+  std::map<int, double> counts;
+  counter_rng rng(7, 0);
+  for (int t = 0; t < trials; t++) {
+    counts[table.sample(rng())]++;
+  }
+
+  std::map<int, double> expected;
+  for (int j = first_pay; j <= last_pay; j++) {
+    if (probs[j] > 0.0) {
+      expected[(*games::jacks_or_better.pay_table)[j]] += probs[j];
+    }
+  }
+  ASSERT_EQ(counts.size(), expected.size());
+  for (const auto& [pay, prob] : expected) {
+    const double sd = std::sqrt(prob * (1.0 - prob) / trials);
+    EXPECT_NEAR(counts[pay] / trials, prob, 5.0 * sd) << pay;
+  }
+}
+
+TEST(SessionSim, SameForAnyThreads) {
+  pay_prob probs;
+  pay_values pays;
+  jacks_bankroll(probs, pays);
+
+  session_options options;
+  options.games = 500;
+  options.sessions = 3000;
+  options.seed = 11;
+  options.threads = 1;
+  const session_results one =
+      simulate_sessions(games::jacks_or_better, probs, options);
+  options.threads = 4;
+  const session_results four =
+      simulate_sessions(games::jacks_or_better, probs, options);
+
+  EXPECT_EQ(one.histogram, four.histogram);
+  EXPECT_EQ(one.mean, four.mean);
+  EXPECT_EQ(one.variance, four.variance);
+  EXPECT_EQ(one.min_win, four.min_win);
+  EXPECT_EQ(one.max_win, four.max_win);
+  EXPECT_EQ(one.ahead, four.ahead);
+
+  const std::uint64_t binned =
+      std::accumulate(one.histogram.begin(), one.histogram.end(),
+                      std::uint64_t{0});
+  EXPECT_EQ(binned + one.under + one.over, options.sessions);
+
+  double mean = 0.0;
+  for (int j = first_pay; j <= last_pay; j++) {
+    mean += probs[j] * (pays[j] - 1.0);
+  }
+  EXPECT_NEAR(one.mean, mean * options.games, 2.0 * one.mean_error());
+
+  options.seed = 12;
+  EXPECT_NE(simulate_sessions(games::jacks_or_better, probs, options).mean,
+            one.mean);
+}
+
+TEST(DealSim, ReadStrategyFile) {
+  const std::string filename = "test_strategy.txt";
+  const char *const sections[] = {
+      "0 Deuces\n"
+      "Natural Royal Flush\n"
+      "Straight, Flush, or Straight Flush\n"
+      "RF 4  # with a comment\n"
+      "\n"
+      "Nothing\n",
+      "1 Deuce\n"
+      "Straight Flush\n"
+      "Just the deuce\n",
+      "2 Deuces\n"
+      "Quads\n"
+      "Just the deuces\n",
+      "3 Deuces\n"
+      "Wild Royal Flush\n"
+      "Just the deuces\n",
+      "4 Deuces\n"
+      "Just the deuces\n"};
+
+  for (const int wild_sections : {5, 4}) {
+    {
+      std::ofstream out(filename);
+      // Some tests make local games with the names of built in ones,
+      // which vp_game::find goes on returning after they are gone.
+      out << "8/15 Loose Deuces Wild\nTest\n";
+      for (int w = 0; w < wild_sections; w++) {
+        out << sections[w];
+      }
+    }
+
+    if (wild_sections < 5) {
+      EXPECT_THROW(read_strategy_file(filename), std::runtime_error);
+      continue;
+    }
+    const strategy_file file = read_strategy_file(filename);
+    EXPECT_EQ(file.game, &games::loose_deuces_wild);
+    ASSERT_EQ(file.lines.size(), 5);
+    EXPECT_EQ(file.lines[0].size(), 4);
+    EXPECT_EQ(file.lines[1].size(), 2);
+    EXPECT_EQ(file.lines[4].size(), 1);
+    EXPECT_STREQ(file.lines[0][2].image, "RF 4");
+  }
+
+  std::remove(filename.c_str());
+  EXPECT_THROW(read_strategy_file(filename), std::runtime_error);
+}
+
+TEST(DealSim, MatchesPayoffChances) {
+  // Dealing and drawing with optimal holds must find each payoff about
+  // as often as optimal play does, whatever the number of threads.
+  const vp_game &game = games::jacks_or_better;
+  pay_prob prob_pays;
+  const double payback = get_payback(game, prob_pays);
+
+  const hold_chooser chooser(game);
+  deal_options options;
+  options.hands = 100000;
+  options.seed = 3;
+  options.threads = 1;
+  const deal_results one = simulate_deals(game, chooser, options);
+  options.threads = 3;
+  const deal_results three = simulate_deals(game, chooser, options);
+
+  EXPECT_EQ(one.mean, three.mean);
+  EXPECT_EQ(one.variance, three.variance);
+  for (int p = first_pay; p <= last_pay; p++) {
+    EXPECT_EQ(one.counts[p], three.counts[p]);
+    EXPECT_NEAR(static_cast<double>(one.counts[p]) / options.hands,
+                prob_pays[p], 3.0 * one.frequency_error(p) + 1e-4)
+        << payoff_image[p];
+  }
+  EXPECT_NEAR(one.mean, payback, 2.0 * one.mean_error());
+
+  // Every line of a multi-play game is a hand drawn to.
+  options.hands = 1000;
+  options.lines = 10;
+  const deal_results multi = simulate_deals(game, chooser, options);
+  EXPECT_EQ(std::accumulate(multi.counts, multi.counts + last_pay + 1,
+                            std::uint64_t{0}),
+            options.hands * options.lines);
+}
+
+TEST(DealSim, MatchesPayoffChancesWithWildCards) {
+  // The same, where the final hands are named with wild cards.
+  const vp_game &game = games::deuces_wild;
+  pay_prob prob_pays;
+  const double payback = get_payback(game, prob_pays);
+
+  const hold_chooser chooser(game);
+  deal_options options;
+  options.hands = 100000;
+  options.seed = 5;
+  const deal_results results = simulate_deals(game, chooser, options);
+
+  for (int p = first_pay; p <= last_pay; p++) {
+    EXPECT_NEAR(static_cast<double>(results.counts[p]) / options.hands,
+                prob_pays[p], 3.0 * results.frequency_error(p) + 1e-4)
+        << payoff_image[p];
+  }
+  EXPECT_NEAR(results.mean, payback, 2.0 * results.mean_error());
+}
@@ -1,137 +1,168 @@
-#include <array>
-#include <chrono>
-#include <fstream>
-#include <functional>
-#include <iomanip>
+// Program to simulate video poker: sessions of games, to see how the
+// net win of a session is spread out, or hands dealt from a deck, to
+// check a strategy
+//
+// Usage:
+//   monte-carlo [--threads <n>] [--seed <n>] [--sessions <n>]
+//               <game name> [<games per session>]
+//   monte-carlo [--threads <n>] [--seed <n>] [--lines <n>] --deal <hands>
+//               (<game name> | --strategy <file>)
+//
+// The first samples the payoffs of each game, with the chance of each
+// that of optimal play of the game.  With --deal, it deals the cards
+// instead, and holds them optimally or as the strategy file says,
+// playing each dealt hand on the given number of lines.
+
+#include <stdio.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <iostream>
-#include <limits>
-#include <random>
-#include <stdexcept>
-#include <vector>
 
-// Pay table for 9-6 Jacks or Better (optimum play)
-const std::vector<std::pair<double, int>> pay_table = {
-    {0x1.1748f7e5d1781p-1, 0},   {0x1.b7760e67f1a8fp-3, 1},
-    {0x1.08c62a2d1af26p-3, 2},   {0x1.30f0f20250250p-4, 3},
-    {0x1.7028455de7e5ep-7, 4},   {0x1.6743eb39c271ap-7, 6},
-    {0x1.79396fb0bfdffp-7, 9},   {0x1.35a6ec6f3b9f0p-9, 25},
-    {0x1.ca7f3edc714fbp-14, 50}, {0x1.a5268d541aaffp-16, 800},
-};
-
-int one_play(std::function<double()> rand) {
-  const double rand_value = rand();
-  double running = 0;
-  for (auto iter = pay_table.begin();; ++iter) {
-    running += iter->first;
-    if (running >= rand_value || &*iter == &pay_table.back()) {
-      return iter->second;
+#include "../shared/deal_sim.h"
+#include "../shared/eval_game.h"
+#include "../shared/session_sim.h"
+
+static void report(const session_results& results) {
+  const double games = static_cast<double>(results.games);
+  printf("%zu sessions of %zu games in %.2f seconds, %.0f games/second\n",
+         results.sessions, results.games, results.seconds,
+         results.games_per_second());
+  printf("Mean net win %.2f +/- %.2f (return %.5f%% +/- %.5f%%)\n",
+         results.mean, results.mean_error(),
+         100.0 * (1.0 + results.mean / games),
+         100.0 * results.mean_error() / games);
+  printf("Standard deviation %.2f\n", std::sqrt(results.variance));
+  const double ahead =
+      static_cast<double>(results.ahead) / static_cast<double>(results.sessions);
+  printf("Sessions ahead %.4f%% +/- %.4f%%\n", 100.0 * ahead,
+         100.0 * results.ahead_error());
+  printf("min_win = %lld\n", static_cast<long long>(results.min_win));
+  printf("max_win = %lld\n", static_cast<long long>(results.max_win));
+  printf("under = %llu\n", static_cast<unsigned long long>(results.under));
+  printf("over = %llu\n", static_cast<unsigned long long>(results.over));
+
+  // About 100 buckets, each a number of net wins, printed as (middle
+  // of the bucket, fraction of sessions) where not empty.
+  const std::size_t size = results.histogram.size();
+  const std::size_t interval = (size + 99) / 100;
+  printf("interval = %zu\n", interval);
+  for (std::size_t i = 0; i < size; i += interval) {
+    std::uint64_t sum = 0;
+    std::size_t k;
+    for (k = i; k < size && k < i + interval; k++) {
+      sum += results.histogram[k];
+    }
+    if (sum != 0) {
+      const double middle = results.low + 0.5 * static_cast<double>(i + k - 1);
+      printf("(%g, %g),\n", middle,
+             static_cast<double>(sum) / static_cast<double>(results.sessions));
     }
   }
 }
 
-static constexpr std::size_t kNumGames = 6160;
-static constexpr std::size_t kLowerBound = kNumGames - 500;
-static constexpr std::size_t kUpperBound = kNumGames + 1000;
-
-void trial() {
-  std::mt19937 rng(std::random_device{}());
-  // std::mt19937 has an extremely long period. The generator produces a
-  // sequence of numbers that only repeats after generating approximately
-  // 1e6001 numbers.
-
-  std::uniform_real_distribution<double> dist(0.0, 1.0);
-  const auto gen_rand = [&rng, &dist]() { return dist(rng); };
-
-  std::size_t min_win = std::numeric_limits<std::size_t>::max();
-  std::size_t max_win = 0;
-
-  auto start = std::chrono::steady_clock::now();
-
-  std::size_t counter = 0;
-  std::size_t under = 0;
-  std::size_t over = 0;
-  std::array<std::size_t, kUpperBound - kLowerBound> histo{/*init to */};
-  for (;;) {
-    std::size_t sum = 0;
-    for (std::size_t i = 0; i < kNumGames; ++i) {
-      sum += static_cast<std::size_t>(one_play(gen_rand));
-    };
-    ++counter;
-    if (sum < kLowerBound) {
-      ++under;
-    } else if (sum >= kUpperBound) {
-      ++over;
-    } else {
-      ++histo[sum - kLowerBound];
-    }
-    if (sum >= max_win) {
-      max_win = sum;
+static void report(const deal_results& results) {
+  printf("%zu hands on %u lines in %.2f seconds, %.0f hands/minute\n",
+         results.hands, results.lines, results.seconds,
+         results.hands_per_minute());
+  printf("Return %.5f%% +/- %.5f%%\n", 100.0 * results.mean,
+         100.0 * results.mean_error());
+
+  const double lines =
+      static_cast<double>(results.hands) * static_cast<double>(results.lines);
+  for (int p = first_pay; p <= last_pay; p++) {
+    if (results.counts[p] != 0) {
+      printf("%-20s %.8f +/- %.8f\n", payoff_image[p],
+             static_cast<double>(results.counts[p]) / lines,
+             results.frequency_error(p));
     }
-    if (sum <= min_win) {
-      min_win = sum;
-    }
-
-    std::chrono::duration<double> elapsed_seconds =
-        std::chrono::steady_clock::now() - start;
+  }
+}
 
-    if (elapsed_seconds.count() >= 30.0) {
-      break;  // Exit loop after 30 seconds
+int main(int argc, const char* argv[]) {
+  session_options options;
+  deal_options deals;
+  bool deal = false;
+  const char* strategy = nullptr;
+  int j;
+  for (j = 1; j + 1 < argc && std::strncmp(argv[j], "--", 2) == 0; j += 2) {
+    if (std::strcmp(argv[j], "--threads") == 0) {
+      options.threads = deals.threads = std::atoi(argv[j + 1]);
+    } else if (std::strcmp(argv[j], "--seed") == 0) {
+      options.seed = deals.seed = std::strtoull(argv[j + 1], nullptr, 10);
+    } else if (std::strcmp(argv[j], "--sessions") == 0) {
+      options.sessions = std::strtoull(argv[j + 1], nullptr, 10);
+    } else if (std::strcmp(argv[j], "--deal") == 0) {
+      deal = true;
+      deals.hands = std::strtoull(argv[j + 1], nullptr, 10);
+    } else if (std::strcmp(argv[j], "--lines") == 0) {
+      deals.lines = std::atoi(argv[j + 1]);
+    } else if (std::strcmp(argv[j], "--strategy") == 0) {
+      strategy = argv[j + 1];
+    } else {
+      std::cerr << "Unknown option " << argv[j] << "\n";
+      return 1;
     }
   }
 
-  std::cout << "under = " << under << "\n";
-  std::cout << "over = " << over << "\n";
-  std::cout << "min_win = " << min_win << "\n";
-  std::cout << "max_win = " << max_win << "\n";
-
-  const std::size_t interval = std::lround((kUpperBound - kLowerBound) / 100.0);
-  std::cout << "interval = " << interval << "\n";
-
-  std::size_t i = kLowerBound;
-  for (std::size_t j = 0; j < 100; ++j) {
-    std::size_t sum = 0;
-    const double avg = 0.5 * static_cast<double>(i + i + interval - 1);
-    for (std::size_t k = 0; k < interval; ++k) {
-      sum += histo[i++ - kLowerBound];
+  if (deal) {
+    if (deals.hands == 0 || deals.lines == 0) {
+      std::cerr << "Need at least one hand and one line\n";
+      return 1;
     }
-    // Normalize to probability
-    if (sum != 0) {
-      std::cout << "(" << avg - kNumGames << ", "
-                << static_cast<double>(sum) / counter << "),\n";
+    try {
+      if (strategy != nullptr) {
+        const strategy_file file = read_strategy_file(strategy);
+        printf("%s: %s\n", file.game->name, strategy);
+        const hold_chooser chooser(*file.game, file.lines);
+        report(simulate_deals(*file.game, chooser, deals));
+        return 0;
+      }
+      const vp_game* game = j < argc ? vp_game::find(argv[j]) : nullptr;
+      if (game == nullptr) {
+        std::cerr << "Missing or unknown game name\n";
+        return 1;
+      }
+      printf("%s: optimal play\n", game->name);
+      report(simulate_deals(*game, hold_chooser(*game), deals));
+    } catch (const std::exception& e) {
+      std::cout << e.what() << std::endl;
+      return 1;
     }
+    return 0;
   }
-}
-
-void points() {
-  std::mt19937 rng(std::random_device{}());
-  // std::mt19937 has an extremely long period. The generator produces a
-  // sequence of numbers that only repeats after generating approximately
-  // 1e6001 numbers.
 
-  std::uniform_real_distribution<double> dist(0.0, 1.0);
-  const auto gen_rand = [&rng, &dist]() { return dist(rng); };
-
-  std::ofstream out_file("c:/users/sigma/documents/points.txt");
-  if (!out_file.is_open()) {
-    throw std::runtime_error("Cannot create file");
+  if (j >= argc) {
+    std::cerr << "Missing game name\n";
+    return 1;
   }
-  for (std::size_t i = 0; i < 10000; ++i) {
-    int sum = -static_cast<int>(kNumGames);
-    for (std::size_t j = 0; j < kNumGames; ++j) {
-      sum += one_play(gen_rand);
-    }
-    out_file << sum << "\n";
+  const vp_game* game = vp_game::find(argv[j]);
+  if (game == nullptr) {
+    std::cerr << "Unknown game " << argv[j] << "\n";
+    return 1;
+  }
+  if (j + 1 < argc) {
+    options.games = std::strtoull(argv[j + 1], nullptr, 10);
+  }
+  if (options.games == 0 || options.sessions == 0) {
+    std::cerr << "Need at least one game and one session\n";
+    return 1;
   }
-  out_file.close();
-}
 
-int main() {
   try {
-    points();
+    pay_prob prob_pays;
+    const double payback =
+        get_payback_parallel(*game, prob_pays, options.threads);
+    printf("%s: return %.5f%%\n", game->name, payback * 100.0);
+
+    report(simulate_sessions(*game, prob_pays, options));
   } catch (const std::exception& e) {
     std::cout << e.what() << std::endl;
-  } catch (...) {
-    std::cout << "Unknown exception" << std::endl;
+    return 1;
   }
 
   return 0;
@@ -0,0 +1,354 @@
+#include "bankroll.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <format>
+#include <stdexcept>
+
+#include "hold_kernel.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define BANKROLL_X64
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+static void scalar_add_scaled(double *dst, const double *src, double scale,
+                              std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    dst[i] += scale * src[i];
+  }
+}
+
+#ifdef BANKROLL_X64
+TARGET_AVX2
+static void avx2_add_scaled(double *dst, const double *src, double scale,
+                            std::size_t n) {
+  const __m256d factor = _mm256_set1_pd(scale);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256d product = _mm256_mul_pd(factor, _mm256_loadu_pd(src + i));
+    _mm256_storeu_pd(dst + i,
+                     _mm256_add_pd(_mm256_loadu_pd(dst + i), product));
+  }
+  for (; i < n; ++i) {
+    dst[i] += scale * src[i];
+  }
+}
+#endif
+
+void add_scaled(double *dst, const double *src, double scale, std::size_t n) {
+#ifdef BANKROLL_X64
+  // The same check of the processor as for the hold kernels.
+  static const bool avx2 = best_hold_kernel() != hold_kernel::scalar;
+  if (avx2) {
+    avx2_add_scaled(dst, src, scale, n);
+    return;
+  }
+#endif
+  scalar_add_scaled(dst, src, scale, n);
+}
+
+bankroll_chain::bankroll_chain(const pay_prob &prob_pays,
+                               const pay_values &pay_table, int goal)
+    : goal_(goal) {
+  assert(goal >= 2);
+  for (int j = first_pay; j <= last_pay; j++) {
+    if (prob_pays[j] == 0.0) {
+      continue;
+    }
+    assert(std::floor(pay_table[j]) == pay_table[j]);
+    const int shift = static_cast<int>(pay_table[j]) - 1;
+    const auto it = std::find_if(moves_.begin(), moves_.end(),
+                                 [shift](const move &m) {
+                                   return m.shift == shift;
+                                 });
+    if (it == moves_.end()) {
+      moves_.push_back({shift, prob_pays[j]});
+    } else {
+      it->prob += prob_pays[j];
+    }
+  }
+  std::sort(moves_.begin(), moves_.end(),
+            [](const move &x, const move &y) { return x.shift < y.shift; });
+}
+
+std::vector<double> bankroll_chain::start(int bankroll) const {
+  assert(bankroll >= 0 && bankroll < goal_);
+  std::vector<double> result(goal_);
+  result[bankroll] = 1.0;
+  return result;
+}
+
+void bankroll_chain::step(const std::vector<double> &current,
+                          std::vector<double> &next) const {
+  assert(current.size() == static_cast<std::size_t>(goal_) &&
+         next.size() == static_cast<std::size_t>(goal_));
+  std::fill(next.begin(), next.end(), 0.0);
+  double stopped = current[0];
+
+  for (const auto [shift, prob] : moves_) {
+    // The bankrolls from low to high are still playing after the move.
+    const int low = std::max(1, 1 - shift);
+    const int high = std::min(goal_ - 1, goal_ - 1 - shift);
+
+    for (int b = 1; b < std::min(low, goal_); ++b) {
+      stopped += prob * current[b];
+    }
+    for (int b = std::max(high + 1, low); b < goal_; ++b) {
+      stopped += prob * current[b];
+    }
+    if (low <= high) {
+      add_scaled(&next[low + shift], &current[low], prob, high - low + 1);
+    }
+  }
+
+  next[0] = stopped;
+}
+
+void bankroll_chain::step_back(const std::vector<double> &stopped,
+                               std::vector<double> &next) const {
+  assert(stopped.size() == static_cast<std::size_t>(goal_) &&
+         next.size() == static_cast<std::size_t>(goal_));
+  std::fill(next.begin(), next.end(), 0.0);
+
+  for (const auto [shift, prob] : moves_) {
+    // Same bounds as in step.
+    const int low = std::max(1, 1 - shift);
+    const int high = std::min(goal_ - 1, goal_ - 1 - shift);
+
+    for (int b = 1; b < std::min(low, goal_); ++b) {
+      next[b] += prob;
+    }
+    for (int b = std::max(high + 1, low); b < goal_; ++b) {
+      next[b] += prob;
+    }
+    if (low <= high) {
+      add_scaled(&next[low], &stopped[low + shift], prob, high - low + 1);
+    }
+  }
+
+  next[0] = 1.0;
+}
+
+std::vector<double> bankroll_chain::transition() const {
+  const std::size_t n = goal_;
+  std::vector<double> result(n * n);
+  result[0] = 1.0;
+  for (int from = 1; from < goal_; ++from) {
+    for (const auto [shift, prob] : moves_) {
+      const int to = from + shift;
+      result[(to <= 0 || to >= goal_ ? 0 : to) * n + from] += prob;
+    }
+  }
+  return result;
+}
+
+void bankroll_chain::advance(std::vector<double> &probs,
+                             unsigned int games) const {
+  assert(probs.size() == static_cast<std::size_t>(goal_));
+  const double n = goal_;
+  const double step_cost = games * n * static_cast<double>(moves_.size());
+  const double square_cost = std::log2(games + 1.0) * n * n * n;
+
+  if (step_cost <= square_cost) {
+    std::vector<double> next(goal_);
+    for (unsigned int g = 0; g < games; ++g) {
+      step(probs, next);
+      probs.swap(next);
+    }
+    return;
+  }
+
+  // power is the transition of 2^k games, for each bit k of games.
+  const std::size_t size = goal_;
+  std::vector<double> power = transition();
+  std::vector<double> product(size * size);
+  std::vector<double> result(size);
+  for (unsigned int bits = games;; bits >>= 1) {
+    if (bits & 1) {
+      std::fill(result.begin(), result.end(), 0.0);
+      for (std::size_t from = 0; from < size; ++from) {
+        if (probs[from] != 0.0) {
+          for (std::size_t to = 0; to < size; ++to) {
+            result[to] += power[to * size + from] * probs[from];
+          }
+        }
+      }
+      probs.swap(result);
+    }
+    if (bits <= 1) {
+      break;
+    }
+
+    // Row i of the square is the sum of the rows k of power,
+    // each scaled by power[i][k].
+    std::fill(product.begin(), product.end(), 0.0);
+    for (std::size_t i = 0; i < size; ++i) {
+      for (std::size_t k = 0; k < size; ++k) {
+        const double scale = power[i * size + k];
+        if (scale != 0.0) {
+          add_scaled(&product[i * size], &power[k * size], scale, size);
+        }
+      }
+    }
+    power.swap(product);
+  }
+}
+
+int bankroll_chain::median_length(int bankroll) const {
+  std::vector<double> current = start(bankroll);
+  std::vector<double> next(goal_);
+
+  int game_number;
+  for (game_number = 1;; game_number++) {
+    step(current, next);
+
+    // next[0] is the probability that we stop, either because we
+    // ran out of money or because we reached the goal.
+    if (next[0] >= 0.5) {
+      break;
+    }
+    current.swap(next);
+  }
+
+  // next[0] is the probability that we will stop after game_number games.
+  // current[0] is the probability that we will stop after game_number-1
+  // games.  Which is closer to .5?
+  if (0.5 - current[0] > next[0] - 0.5) {
+    game_number -= 1;
+  }
+  return game_number;
+}
+
+std::vector<int> bankroll_chain::median_lengths() const {
+  // stopped[b] is the chance that play from b has stopped after
+  // game_number - 1 games.
+  std::vector<double> stopped(goal_);
+  std::vector<double> next(goal_);
+  stopped[0] = 1.0;
+
+  std::vector<int> result(goal_, -1);
+  int remaining = goal_;
+  for (int game_number = 1; remaining > 0; game_number++) {
+    step_back(stopped, next);
+    for (int b = 0; b < goal_; b++) {
+      // The same choice as median_length.
+      if (result[b] < 0 && next[b] >= 0.5) {
+        result[b] =
+            0.5 - stopped[b] > next[b] - 0.5 ? game_number - 1 : game_number;
+        remaining--;
+      }
+    }
+    stopped.swap(next);
+  }
+  return result;
+}
+
+ruin_solver::ruin_solver(const pay_prob &prob_pays,
+                         const pay_values &pay_table) {
+  for (int j = first_pay; j <= last_pay; j++) {
+    assert(std::floor(pay_table[j]) == pay_table[j]);
+    const int pay = static_cast<int>(pay_table[j]);
+    if (pay == 0) {
+      down_ += prob_pays[j];
+    } else if (pay == 1) {
+      push_ += prob_pays[j];
+    } else if (prob_pays[j] != 0.0) {
+      ups_.emplace_back(pay - 1, prob_pays[j]);
+    }
+  }
+}
+
+void ruin_solver::extend(std::size_t size) {
+  // Let u(b) be the chance of going bust from b with goal n.  Then
+  //   (1 - push) u(b) = down u(b-1) + sum of prob u(b + win),
+  // where u is zero from n on.  With v(m) = u(n - 1 - m) / u(n - 1),
+  //   down v(m+1) = (1 - push) v(m) - sum of prob v(m - win),
+  // where v(0) = 1 and v is zero below 0, whatever n is.
+  if (v_.empty()) {
+    v_.push_back(1.0);
+  }
+  while (v_.size() < size) {
+    const std::size_t m = v_.size() - 1;
+    double next = (1.0 - push_) * v_[m];
+    for (const auto &[win, prob] : ups_) {
+      if (static_cast<std::size_t>(win) <= m) {
+        next -= prob * v_[m - win];
+      }
+    }
+    next /= down_;
+
+    // In a game with an edge for the player, v grows exponentially,
+    // but only its ratios matter.
+    if (next > 1e250) {
+      for (double &x : v_) {
+        x *= 1e-250;
+      }
+      next *= 1e-250;
+    }
+    v_.push_back(next);
+  }
+}
+
+double ruin_solver::bust_prob(int bankroll, int goal) {
+  if (goal <= bankroll) {
+    return 0.0;
+  }
+  if (down_ == 0.0) {
+    return bankroll > 0 ? 0.0 : 1.0;
+  }
+  extend(goal);
+  return v_[goal - 1 - bankroll] / v_[goal - 1];
+}
+
+int ruin_solver::break_even_goal(int bankroll) {
+  // Find a goal for which the bust probability is > 0.5
+  int winnings = 1;
+  while (bust_prob(bankroll, bankroll + winnings) <= 0.5) {
+    if (bankroll + winnings > max_goal) {
+      throw std::runtime_error(
+          std::format("No break even goal for a bankroll of {}", bankroll));
+    }
+    winnings *= 2;
+  }
+
+  // Use binary search to find the largest goal
+  // whose bust probability is <= 0.5
+  int left = bankroll;              // bust prob == 0
+  int right = bankroll + winnings;  // bust_prob > 0.5
+  for (;;) {
+    const int mid = left + (right - left) / 2;
+    if (mid == left) break;
+    if (bust_prob(bankroll, mid) <= 0.5) {
+      left = mid;
+    } else {
+      right = mid;
+    }
+  }
+  return left;
+}
+
+std::vector<int> ruin_solver::break_even_goals(int max_bankroll) {
+  std::vector<int> result;
+  result.reserve(max_bankroll + 1);
+  int goal = 0;
+  for (int bankroll = 0; bankroll <= max_bankroll; bankroll++) {
+    goal = std::max(goal, bankroll);
+    while (bust_prob(bankroll, goal + 1) <= 0.5) {
+      if (goal == max_goal) {
+        throw std::runtime_error(std::format(
+            "No break even goal for a bankroll of {}", bankroll));
+      }
+      goal++;
+    }
+    result.push_back(goal);
+  }
+  return result;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "game.h"
+#include "vpoker.h"
+
+// dst[i] += scale * src[i] for i < n, using vector instructions when
+// the processor has them.
+void add_scaled(double *dst, const double *src, double scale, std::size_t n);
+
+// A session of play as a Markov chain over the bankroll, counted in
+// bets.  The player bets one each game until the bankroll is gone or
+// reaches the goal.  A probability vector has goal elements: element
+// b, for b from 1 to goal - 1, is the probability of having a bankroll
+// of b and still playing, and element 0 is the probability that play
+// has stopped, either bust or at the goal.
+//
+// Each payoff with a nonzero probability moves every bankroll by the
+// same amount, the payoff less the bet, so a game is a few shifted
+// copies of the vector added together rather than a loop over all the
+// payoffs at every bankroll.
+class bankroll_chain {
+ public:
+  // prob_pays[j] is the probability of payoff j, which pays
+  // pay_table[j] bets, including the bet returned.
+  bankroll_chain(const pay_prob &prob_pays, const pay_values &pay_table,
+                 int goal);
+
+  int goal() const { return goal_; }
+
+  // The vector of a session that starts with bankroll bets.
+  std::vector<double> start(int bankroll) const;
+
+  // Plays one game from current into next.
+  void step(const std::vector<double> &current,
+            std::vector<double> &next) const;
+
+  // Plays the given number of games.  When the goal is small enough,
+  // this squares the transition matrix rather than playing each game.
+  void advance(std::vector<double> &probs, unsigned int games) const;
+
+  // The number of games after which the chance that play has stopped
+  // is closest to one half, starting with bankroll bets.
+  int median_length(int bankroll) const;
+
+  // The median_length of every bankroll below the goal, all found
+  // together by playing the chain backwards.
+  std::vector<int> median_lengths() const;
+
+ private:
+  // A payoff less the bet, and its probability.
+  struct move {
+    int shift;
+    double prob;
+  };
+
+  // The transpose of step: given the chances that play has stopped
+  // after n games from each bankroll, the chances after n + 1 games.
+  void step_back(const std::vector<double> &stopped,
+                 std::vector<double> &next) const;
+
+  // The transition matrix of one game, with element [to * goal_ + from].
+  std::vector<double> transition() const;
+
+  int goal_;
+
+  // In increasing order of shift, with the probabilities of payoffs
+  // that pay the same added together.
+  std::vector<move> moves_;
+};
+
+// The chance of going bust before reaching a goal, for any starting
+// bankroll and goal.  Since no payoff loses more than the bet, going
+// bust from bankroll b means passing through every bankroll below b.
+// So the chance of going bust from b with a goal of n is
+// v[n - 1 - b] / v[n - 1], where v is a single sequence, given by a
+// linear recurrence, that doesn't depend on the goal.  The sequence is
+// extended as larger goals are asked about, and each question after
+// that is a division.
+class ruin_solver {
+ public:
+  static const int max_goal = 1 << 24;
+
+  // prob_pays and pay_table are as for bankroll_chain.
+  ruin_solver(const pay_prob &prob_pays, const pay_values &pay_table);
+
+  // The chance of going bust, starting with bankroll bets, before the
+  // bankroll reaches goal or more.
+  double bust_prob(int bankroll, int goal);
+
+  // The largest goal for which the chance of going bust is at most one
+  // half.  Throws if there is no such goal up to max_goal, as in a game
+  // with a big enough edge for the player.
+  int break_even_goal(int bankroll);
+
+  // The break_even_goal of every bankroll from 0 to max_bankroll, found
+  // in one sweep, since a bigger bankroll never has a smaller one.
+  std::vector<int> break_even_goals(int max_bankroll);
+
+ private:
+  // Computes v up to at least size elements.
+  void extend(std::size_t size);
+
+  // The probabilities of losing the bet, and of getting it back.
+  double down_ = 0.0;
+  double push_ = 0.0;
+
+  // The payoffs that win, by how much they win.
+  std::vector<std::pair<int, double>> ups_;
+
+  std::vector<double> v_;
+};
@@ -0,0 +1,1288 @@
+#include "compiled_match.h"
+
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+#include "instrument.h"
+
+namespace {
+const unsigned char end_marker = 0xff;
+
+// How parse_line lays out the operands of each instruction.
+enum operand_layout {
+  no_operands,
+  one_byte,        // n
+  two_bytes,       // n and reach
+  mask_operand,    // A two-byte mask of denominations
+  counted_list,    // A count and that many denominations
+  offset_operand,  // The offset of pc_or and pc_else
+};
+
+operand_layout layout(unsigned code) {
+  switch (code) {
+    case pc_eof:
+    case pc_prefer:
+    case pc_nothing:
+    case pc_two_pair:
+    case pc_trips:
+    case pc_full_house:
+    case pc_quads:
+    case pc_quads_with_low_kicker:
+    case pc_no_fp:
+    case pc_dsc_fp:
+    case pc_no_sp:
+    case pc_dsc_sp:
+    case pc_no_pp:
+    case pc_dsc_pp:
+    case pc_no_pair:
+    case pc_dsc_pair:
+    case pc_least_sp:
+      return no_operands;
+
+    case pc_or:
+    case pc_else:
+      return offset_operand;
+
+    case pc_no_x:
+    case pc_with_x:
+    case pc_RF_n:
+    case pc_Flush_n:
+    case pc_suited_x:
+    case pc_high_n:
+    case pc_no_gp:
+    case pc_dsc_gp:
+    case pc_no_le_x:
+    case pc_dsc_le_x:
+    case pc_no_ge_x:
+    case pc_dsc_ge_x:
+    case pc_discard_suit_count_n:
+      return one_byte;
+
+    case pc_SF_n:
+    case pc_Straight_n:
+      return two_bytes;
+
+    case pc_pair_of_x:
+    case pc_just_a_x:
+    case pc_trip_x:
+    case pc_trip_x_with_low_kicker:
+    case pc_high_x:
+    case pc_low_x:
+      return mask_operand;
+
+    case pc_these_n:
+    case pc_no_these_n:
+    case pc_dsc_these_n:
+    case pc_no_these_n_and_fp:
+    case pc_dsc_these_n_and_fp:
+    case pc_no_these_suited_n:
+    case pc_dsc_these_suited_n:
+    case pc_no_these_offsuit_n:
+    case pc_dsc_these_offsuit_n:
+    case pc_no_these_onsuit_n:
+    case pc_dsc_these_onsuit_n:
+      return counted_list;
+  }
+  throw std::runtime_error("Unknown parser code");
+}
+}  // namespace
+
+MatchProgram::MatchProgram(const unsigned char *pattern) {
+  // The instruction that starts at each byte, and the byte each jump
+  // goes to.
+  std::vector<int> op_at;
+  std::vector<std::size_t> jumps;
+
+  std::size_t pos = 0;
+  for (;;) {
+    op o;
+    std::memset(&o, 0, sizeof(o));
+    o.code = pattern[pos];
+    o.target = -1;
+
+    op_at.resize(pos + 1, -1);
+    op_at[pos] = static_cast<int>(ops.size());
+    pos += 1;
+
+    switch (layout(o.code)) {
+      case no_operands:
+        break;
+
+      case offset_operand:
+        jumps.push_back(pos + 1 + pattern[pos]);
+        pos += 1;
+        break;
+
+      case one_byte:
+        o.n = pattern[pos++];
+        break;
+
+      case two_bytes:
+        o.n = pattern[pos++];
+        o.reach = pattern[pos++];
+        break;
+
+      case mask_operand:
+        o.denoms = pattern[pos] | pattern[pos + 1] << 8;
+        pos += 2;
+        break;
+
+      case counted_list:
+        o.n = pattern[pos++];
+        if (o.n > num_denoms) {
+          throw std::runtime_error("Too many cards in a strategy line");
+        }
+        o.size = o.n;
+        for (int j = 0; j < o.n; j++) {
+          o.list[j] = pattern[pos++];
+          o.denoms |= 1 << o.list[j];
+        }
+        break;
+    }
+
+    if (o.code == pc_trips) {
+      o.denoms = 0xffff;  // Trips of any denomination
+    }
+
+    ops.push_back(o);
+    if (o.code == pc_eof) {
+      break;
+    }
+  }
+
+  std::size_t j = 0;
+  for (op &o : ops) {
+    if (o.code == pc_or || o.code == pc_else) {
+      const std::size_t to = jumps[j++];
+      if (to >= op_at.size() || op_at[to] < 0) {
+        throw std::runtime_error("Bad jump in a strategy line");
+      }
+      o.target = op_at[to];
+    }
+  }
+}
+
+void CompiledMatcher::prepare() {
+  std::memcpy(prepared_hand_, hand, sizeof(hand));
+  prepared_size_ = hand_size;
+  facts_ready_ = 0;
+
+  if (parms != prepared_parms_) {
+    prepared_parms_ = parms;
+    high_ = 0;
+    for (int d = 0; d < num_denoms; d++) {
+      if (parms->is_high(d)) {
+        high_ |= 1 << d;
+      }
+    }
+  }
+
+  for (int j = 0; j < hand_size; j++) {
+    denom_[j] = pips(hand[j]);
+  }
+  denom_[hand_size] = end_marker;
+
+  num_runs_ = 0;
+  for (int j = 0; j < hand_size;) {
+    run &r = runs_[num_runs_++];
+    r.left = j;
+    r.d = denom_[j];
+    while (denom_[j] == r.d) {
+      j += 1;
+    }
+    r.after = j;
+  }
+  suits_ready_ = false;
+}
+
+void CompiledMatcher::prepare_suits() {
+  if (suits_ready_) {
+    return;
+  }
+  suits_ready_ = true;
+
+  for (int s = 0; s < num_suits; s++) {
+    suits_[s].size = 0;
+    royal_[s].size = 0;
+  }
+  for (int j = 0; j < hand_size; j++) {
+    const int v = pips(hand[j]);
+    suit_cards &sc = suits_[suit(hand[j])];
+    sc.denom[sc.size] = v;
+    sc.mask[sc.size++] = 1 << j;
+
+    if (v == ace || v >= ten) {
+      suit_cards &rc = royal_[suit(hand[j])];
+      rc.denom[rc.size] = v;
+      rc.mask[rc.size++] = 1 << j;
+    }
+  }
+}
+
+const CompiledMatcher::kept_facts &CompiledMatcher::facts(unsigned mask) {
+  kept_facts &f = facts_[mask];
+  if (facts_ready_ >> mask & 1) {
+    return f;
+  }
+  facts_ready_ |= 1u << mask;
+
+  f.have = 0;
+  std::memset(f.have_discard, 0, sizeof(f.have_discard));
+  f.num_kept = 0;
+  f.the_suit = -1;
+  f.suited = true;
+  f.have_suits = 0;
+  f.discard_suit_count = 0;
+  f.min_non_ace = king + 5;
+  f.max_non_ace = ace - 5;
+  f.suited_discard = 0;
+  f.min_discard = king + 1;
+  f.max_discard = -1;
+
+  unsigned discard_suits = 0;
+  for (int j = 0; j < hand_size; j++) {
+    const int s = suit(hand[j]);
+    const int d = pips(hand[j]);
+    if ((mask >> j & 1) == 0) {
+      continue;
+    }
+
+    f.num_kept += 1;
+    f.have |= 1 << d;
+    f.have_suits |= 1 << s;
+
+    if (d != ace) {
+      if (d < f.min_non_ace) {
+        f.min_non_ace = d;
+      }
+      if (d > f.max_non_ace) {
+        f.max_non_ace = d;
+      }
+    }
+
+    if (f.the_suit < 0) {
+      f.the_suit = s;
+    } else if (s != f.the_suit) {
+      f.suited = false;
+    }
+  }
+  f.high_denoms = std::popcount(static_cast<unsigned>(f.have & high_));
+
+  for (int j = 0; j < hand_size; j++) {
+    if (mask >> j & 1) {
+      continue;
+    }
+    const int s = suit(hand[j]);
+    const int p = pips(hand[j]);
+    const unsigned suit_mask = 1 << s;
+
+    if (f.suited && s == f.the_suit) {
+      f.suited_discard += 1;
+    }
+    f.have_discard[p] |= suit_mask;
+    discard_suits |= suit_mask;
+
+    // For the purposes of min_discard and max_discard,
+    // ace is counted low.
+    if (p > f.max_discard) {
+      f.max_discard = p;
+    }
+    if (p < f.min_discard) {
+      f.min_discard = p;
+    }
+  }
+  f.discard_suit_count = std::popcount(discard_suits);
+
+  return f;
+}
+
+void CompiledMatcher::check(unsigned mask) {
+  const int save_pat_eof = pat_eof_;
+
+  const int code = ops_[tail_].code;
+  if (code == pc_eof || code == pc_prefer) {
+    // There is no tail to match.
+    pat_eof_ = tail_;
+  } else if (!matches_tail(mask)) {
+    return;
+  }
+
+  if (save_pat_eof < 0) {
+    // First match of a new preference.
+    std::memset(result_vector, 0, sizeof(result_vector));
+    match_count = 0;
+  }
+
+  if (!result_vector[mask]) {
+    result_vector[mask] = true;
+    matches[match_count++] = mask;
+  }
+}
+
+bool CompiledMatcher::matches_tail(unsigned mask) {
+  const kept_facts &f = facts(mask);
+
+  int pc = tail_;
+  int or_operand = -1;
+
+  for (;;) {
+    const MatchProgram::op &o = ops_[pc++];
+    bool pass = true;
+
+    switch (o.code) {
+      case pc_eof:
+      case pc_prefer:
+        pat_eof_ = pc - 1;
+        return true;
+
+      case pc_or:
+        _ASSERT(or_operand < 0);
+        or_operand = o.target;
+        break;
+
+      case pc_else:
+        pc = o.target;
+        or_operand = -1;
+        break;
+
+      case pc_no_x:
+        pass = !f.has(o.n);
+        break;
+
+      case pc_with_x:
+        pass = f.has(o.n);
+        break;
+
+      case pc_high_n:
+        pass = (o.n & (1 << f.high_denoms)) != 0;
+        break;
+
+      case pc_these_n:
+        pass = f.num_kept == o.n && (f.have & o.denoms) == o.denoms;
+        break;
+
+      case pc_suited_x:
+        pass = f.suited && f.the_suit >= 0 && ((1 << f.the_suit) & o.n) != 0;
+        break;
+
+      case pc_high_x:
+      case pc_low_x: {
+        int d;
+        if (f.min_non_ace > f.max_non_ace) {
+          d = ace;
+          pass = f.has(ace);
+        } else if (o.code == pc_low_x) {
+          d = ace_is_low_ && f.has(ace) ? ace : f.min_non_ace;
+        } else {
+          d = !ace_is_low_ && f.has(ace) ? ace : f.max_non_ace;
+        }
+        pass = pass && (o.denoms & (1 << d)) != 0;
+      } break;
+
+      case pc_no_fp:
+        pass = f.suited_discard == 0;
+        break;
+
+      case pc_dsc_fp:
+        pass = f.suited_discard != 0;
+        break;
+
+      case pc_dsc_gp:
+      case pc_no_gp: {
+        if (f.num_kept <= 1) {
+          break;
+        }
+
+        int min_denom, max_denom, reach;
+        if (f.has(ace)) {
+          // Choose ace to be high or low to minimize the reach
+          const int r_lo = f.max_non_ace - ace + 1;
+          const int r_hi = king + 1 - f.min_non_ace + 1;
+          if (r_lo < r_hi) {
+            reach = r_lo;
+            min_denom = ace;
+            max_denom = f.max_non_ace;
+          } else {
+            reach = r_hi;
+            min_denom = f.min_non_ace;
+            max_denom = king + 1;
+          }
+        } else {
+          min_denom = f.min_non_ace;
+          max_denom = f.max_non_ace;
+          reach = f.max_non_ace - f.min_non_ace + 1;
+        }
+        if (reach > 5) {
+          break;
+        }
+
+        bool has_gp = false;
+        for (int j = min_denom + 1; j <= max_denom - 1; j++) {
+          if (!f.has(j) && std::popcount(f.have_discard[j]) == o.n) {
+            has_gp = true;
+          }
+        }
+        pass = has_gp == (o.code == pc_dsc_gp);
+      } break;
+
+      case pc_dsc_sp:
+      case pc_no_sp: {
+        bool has_sp = false;
+
+        if (f.has(ace) && f.min_non_ace > f.max_non_ace) {
+          // Just the ace, which is both low and high.
+          for (int j = deuce; j <= 5; j++) {
+            if (f.have_discard[j]) {
+              has_sp = true;
+            }
+          }
+          for (int j = ten; j <= king; j++) {
+            if (f.have_discard[j]) {
+              has_sp = true;
+            }
+          }
+        } else {
+          int min_denom, reach;
+          if (f.has(ace)) {
+            const int r_lo = f.max_non_ace - ace + 1;
+            const int r_hi = king + 1 - f.min_non_ace + 1;
+            if (r_lo < r_hi) {
+              reach = r_lo;
+              min_denom = ace;
+            } else {
+              reach = r_hi;
+              min_denom = f.min_non_ace;
+            }
+          } else {
+            min_denom = f.min_non_ace;
+            reach = f.max_non_ace - f.min_non_ace + 1;
+          }
+          if (reach > 5) {
+            break;
+          }
+
+          const int max_denom = min_denom + reach - 1;
+          int lo = max_denom - 4;
+          int hi = min_denom + 4;
+          bool check_ace = false;
+
+          if (lo < ace) {
+            lo = ace;
+          }
+          if (hi > king) {
+            hi = king;
+            check_ace = true;
+          }
+
+          for (int j = lo; j <= hi; j++) {
+            if (!f.has(j) && f.have_discard[j]) {
+              has_sp = true;
+            }
+          }
+          if (check_ace && !f.has(ace) && f.have_discard[ace]) {
+            has_sp = true;
+          }
+        }
+        pass = has_sp == (o.code == pc_dsc_sp);
+      } break;
+
+      case pc_dsc_pp:
+      case pc_no_pp: {
+        std::uint16_t discarded = 0;
+        for (int d = 0; d < num_denoms; d++) {
+          if (f.have_discard[d]) {
+            discarded |= 1 << d;
+          }
+        }
+        const bool discard_pair = (discarded & f.have & high_) != 0;
+        pass = discard_pair == (o.code == pc_dsc_pp);
+      } break;
+
+      case pc_dsc_pair:
+      case pc_no_pair: {
+        bool discard_pair = false;
+        for (int d = 0; d < num_denoms; d++) {
+          if (f.have_discard[d] && f.has(d)) {
+            discard_pair = true;
+          }
+        }
+        pass = discard_pair == (o.code == pc_dsc_pair);
+      } break;
+
+      case pc_no_le_x:
+        pass = f.min_discard > o.n;
+        break;
+
+      case pc_dsc_le_x:
+        pass = f.min_discard <= o.n;
+        break;
+
+      case pc_no_ge_x:
+        pass = f.max_discard < o.n && !f.have_discard[ace];
+        break;
+
+      case pc_dsc_ge_x:
+        pass = f.have_discard[ace] || f.max_discard >= o.n;
+        break;
+
+      case pc_no_these_n_and_fp:
+      case pc_dsc_these_n_and_fp:
+      case pc_no_these_n:
+      case pc_dsc_these_n: {
+        int these_suited = 0;
+        bool answer = true;
+        for (int j = 0; j < o.size; j++) {
+          const int p = o.list[j];
+          if (f.suited && (f.have_discard[p] & (1 << f.the_suit))) {
+            these_suited += 1;
+          }
+          if (!f.have_discard[p]) {
+            answer = false;
+          }
+        }
+
+        if (o.code == pc_no_these_n_and_fp || o.code == pc_dsc_these_n_and_fp) {
+          if (these_suited == f.suited_discard) {
+            answer = false;
+          }
+        }
+        pass = answer != (o.code == pc_no_these_n ||
+                          o.code == pc_no_these_n_and_fp);
+      } break;
+
+      case pc_discard_suit_count_n:
+        pass = o.n == f.discard_suit_count;
+        break;
+
+      case pc_no_these_suited_n:
+      case pc_dsc_these_suited_n: {
+        // "suited" means the cards match each other
+        int answer = ~0;
+        for (int j = 0; j < o.size; j++) {
+          answer &= f.have_discard[o.list[j]];
+        }
+        pass = (answer == 0) == (o.code == pc_no_these_suited_n);
+      } break;
+
+      case pc_no_these_offsuit_n:
+      case pc_dsc_these_offsuit_n:
+      case pc_no_these_onsuit_n:
+      case pc_dsc_these_onsuit_n: {
+        // "offsuit" means different from any of the suits being held,
+        // and "onsuit" means the same as one of them.
+        const bool offsuit = o.code == pc_no_these_offsuit_n ||
+                             o.code == pc_dsc_these_offsuit_n;
+        const unsigned suits = offsuit ? ~f.have_suits : f.have_suits;
+        bool answer = true;
+        for (int j = 0; j < o.size; j++) {
+          if ((f.have_discard[o.list[j]] & suits) == 0) {
+            answer = false;
+          }
+        }
+        pass = answer != (o.code == pc_no_these_offsuit_n ||
+                          o.code == pc_no_these_onsuit_n);
+      } break;
+
+      case pc_least_sp: {
+        if (f.num_kept != 1) {
+          pass = false;
+          break;
+        }
+        const int denom_kept = f.has(ace) ? ace : f.min_non_ace;
+
+        int inner_lo, inner_hi;
+        if (denom_kept == five || denom_kept == ten) {
+          inner_lo = five;
+          inner_hi = ten;
+        } else {
+          inner_lo = six;
+          inner_hi = nine;
+          if (denom_kept < inner_lo || denom_kept > inner_hi) {
+            pass = false;
+            break;
+          }
+        }
+
+        int min_inner = denom_kept;
+        int max_inner = denom_kept;
+        for (int d = inner_lo; d <= inner_hi; ++d) {
+          if (f.have_discard[d]) {
+            if (d < min_inner) {
+              min_inner = d;
+            }
+            if (d > max_inner) {
+              max_inner = d;
+            }
+          }
+        }
+        if (denom_kept == min_inner && denom_kept == max_inner) {
+          break;
+        }
+        if ((denom_kept != min_inner && denom_kept != max_inner) ||
+            f.have_discard[ace]) {
+          pass = false;
+          break;
+        }
+
+        int low_pen = num_denoms;  // really big
+        for (int d = deuce; d < inner_lo; d++) {
+          if (f.have_discard[d]) {
+            low_pen = min_inner - d;
+          }
+        }
+        int high_pen = num_denoms;  // really big
+        for (int d = king; d > inner_hi; d--) {
+          if (f.have_discard[d]) {
+            high_pen = d - max_inner;
+          }
+        }
+
+        pass = (denom_kept == min_inner && low_pen >= high_pen) ||
+               (denom_kept == max_inner && high_pen >= low_pen);
+      } break;
+
+      default:
+        _ASSERT(0);
+    }
+
+    if (!pass) {
+      if (or_operand < 0) {
+        return false;
+      }
+      pc = or_operand;
+      or_operand = -1;
+    }
+  }
+}
+
+void CompiledMatcher::find(const MatchProgram &program) {
+  instrument::count(instrument::find_calls);
+  instrument::phase_timer timer(instrument::matching);
+
+  if (hand_size != prepared_size_ || parms != prepared_parms_ ||
+      std::memcmp(hand, prepared_hand_, hand_size * sizeof(card)) != 0) {
+    prepare();
+  }
+
+  ops_ = program.ops.data();
+  std::memset(result_vector, 0, sizeof(result_vector));
+  match_count = 0;
+
+  int pc = 0;
+  int or_operand = -1;
+
+  pat_eof_ = -1;
+  for (;;) {
+    ace_is_low_ = false;
+
+    const MatchProgram::op &o = ops_[pc++];
+    tail_ = pc;
+
+    switch (o.code) {
+      case pc_or:
+        _ASSERT(or_operand < 0);
+        or_operand = o.target;
+        continue;
+
+      case pc_else:
+        pc = o.target;
+        or_operand = -1;
+        break;
+
+      case pc_nothing:
+        check(0);
+        break;
+
+      case pc_two_pair:
+        two_pair();
+        break;
+
+      case pc_trips:
+      case pc_trip_x:
+      case pc_trip_x_with_low_kicker:
+        trips(o);
+        break;
+
+      case pc_full_house:
+        full_house();
+        break;
+
+      case pc_quads:
+      case pc_quads_with_low_kicker:
+        quads(o);
+        break;
+
+      case pc_pair_of_x:
+        pair_of_x(o);
+        break;
+
+      case pc_Flush_n:
+        flush_n(o);
+        break;
+
+      case pc_these_n:
+        these_n(o);
+        break;
+
+      case pc_just_a_x:
+        just_a_x(o);
+        break;
+
+      case pc_RF_n:
+        rf_n(o);
+        break;
+
+      case pc_SF_n:
+        sf_n(o);
+        break;
+
+      case pc_Straight_n:
+        straight_n(o);
+        break;
+
+      default:
+        throw 0;
+    }
+
+    if (or_operand >= 0) {
+      pc = or_operand;
+      or_operand = -1;
+      continue;
+    }
+
+    // Go on to the next preference, if this one matched.
+    if (pat_eof_ < 0 || ops_[pat_eof_].code == pc_eof) {
+      return;
+    }
+    if (ops_[pat_eof_].code != pc_prefer) {
+      throw 0;
+    }
+    pc = pat_eof_ + 1;
+    pat_eof_ = -1;
+  }
+}
+
+void CompiledMatcher::two_pair() {
+  const run *pairs[2];
+  int pcount = 0;
+  for (int r = 0; r < num_runs_; r++) {
+    if (runs_[r].after - runs_[r].left >= 2) {
+      _ASSERT(pcount < 2);
+      pairs[pcount++] = &runs_[r];
+    }
+  }
+  if (pcount != 2) {
+    return;
+  }
+
+  unsigned masks[2][3];
+  int mcount[2];
+  for (int z = 0; z < 2; z++) {
+    const int first = pairs[z]->left;
+    switch (pairs[z]->after - first) {
+      case 2:
+        masks[z][0] = 3 << first;
+        mcount[z] = 1;
+        break;
+
+      case 3:
+        masks[z][0] = 3 << first;
+        masks[z][1] = 5 << first;
+        masks[z][2] = 6 << first;
+        mcount[z] = 3;
+        break;
+
+      default:
+        _ASSERT(0);
+    }
+  }
+
+  for (int j0 = 0; j0 < mcount[0]; j0++) {
+    for (int j1 = 0; j1 < mcount[1]; j1++) {
+      check(masks[0][j0] | masks[1][j1]);
+    }
+  }
+}
+
+void CompiledMatcher::trips(const MatchProgram::op &o) {
+  for (int r = 0; r < num_runs_; r++) {
+    const int left = runs_[r].left;
+    const int d = runs_[r].d;
+    const int count = runs_[r].after - left;
+    if (count < 3 || ((1 << d) & o.denoms) == 0) {
+      continue;
+    }
+
+    // The low kickers that are not d.
+    unsigned kickers[5];
+    int num_kickers = 0;
+    if (o.code == pc_trip_x_with_low_kicker) {
+      for (int k = 0; k < hand_size; k++) {
+        if (denom_[k] != d && denom_[k] <= four) {
+          kickers[num_kickers++] = 1 << k;
+        }
+      }
+    }
+    if (num_kickers == 0) {
+      kickers[num_kickers++] = 0;
+    }
+
+    switch (count) {
+      case 3:
+        for (int z = 0; z < num_kickers; ++z) {
+          check((7 << left) | kickers[z]);
+        }
+        break;
+
+      case 4:
+        // All the four-bit patterns with exactly three bits on.
+        for (int z = 0; z < num_kickers; ++z) {
+          check((7 << left) | kickers[z]);
+          check((11 << left) | kickers[z]);
+          check((13 << left) | kickers[z]);
+          check((14 << left) | kickers[z]);
+        }
+        break;
+
+      default:
+        _ASSERT(0);
+    }
+  }
+}
+
+void CompiledMatcher::full_house() {
+  int sizes[2];
+  int pcount = 0;
+  for (int r = 0; r < num_runs_; r++) {
+    const int count = runs_[r].after - runs_[r].left;
+    if (count >= 2) {
+      _ASSERT(pcount < 2);
+      sizes[pcount++] = count;
+    }
+  }
+  if (pcount == 2 && sizes[0] + sizes[1] == 5 &&
+      (sizes[0] == 3 || sizes[1] == 3)) {
+    // Full house uses all five cards
+    check(0x1f);
+  }
+}
+
+void CompiledMatcher::quads(const MatchProgram::op &o) {
+  int kicker = -1;
+  int quad_pos = -1;
+  for (int r = 0; r < num_runs_; r++) {
+    switch (runs_[r].after - runs_[r].left) {
+      case 1:
+        kicker = runs_[r].d;
+        break;
+      case 4:
+        quad_pos = runs_[r].left;
+        break;
+    }
+  }
+  if (quad_pos >= 0) {
+    if (o.code == pc_quads_with_low_kicker && kicker >= 0 && kicker <= four) {
+      check(0x1f);  // Keep all five
+    } else {
+      check(0xf << quad_pos);  // Keep just the quads
+    }
+  }
+}
+
+void CompiledMatcher::pair_of_x(const MatchProgram::op &o) {
+  for (int r = 0; r < num_runs_; r++) {
+    const run &q = runs_[r];
+    if (q.after - q.left >= 2 && ((1 << q.d) & o.denoms) != 0) {
+      // Iterate all pairs
+      for (int p1 = q.left; p1 < q.after; p1++) {
+        for (int p2 = p1 + 1; p2 < q.after; p2++) {
+          check((1 << p1) | (1 << p2));
+        }
+      }
+    }
+  }
+}
+
+void CompiledMatcher::flush_n(const MatchProgram::op &o) {
+  prepare_suits();
+  const int n = o.n;
+  for (int s = 0; s < num_suits; s++) {
+    const suit_cards &sc = suits_[s];
+    if (sc.size < n) {
+      continue;
+    }
+
+    // subset holds the indexes into sc of the cards kept, and mask
+    // their union.
+    int subset[5];
+    unsigned mask = 0;
+    for (int k = 0; k < n; k++) {
+      subset[k] = k;
+      mask |= sc.mask[k];
+    }
+
+    for (bool more = true; more;) {
+      check(mask);
+
+      // Go on to the next subset in lexicographic order, searching
+      // from the right for an index not at its maximum.
+      for (int z = 1;; z++) {
+        int y = n - z;
+        int index = subset[y];
+        mask ^= sc.mask[index];
+
+        if (index < sc.size - z) {
+          while (y < n) {
+            subset[y++] = ++index;
+            mask |= sc.mask[index];
+          }
+          break;
+        }
+        if (y == 0) {
+          more = false;
+          break;
+        }
+      }
+    }
+  }
+}
+
+void CompiledMatcher::these_n(const MatchProgram::op &o) {
+  std::uint16_t need = o.denoms;
+
+  struct iter_element {
+    int left, right, iter;
+  } list[5];
+  int count = 0;
+  unsigned mask = 0;
+
+  for (int r = 0; r < num_runs_; r++) {
+    const run &q = runs_[r];
+    if (need & (1 << q.d)) {
+      need ^= 1 << q.d;
+      list[count].left = q.left;
+      list[count].right = q.after - 1;
+      list[count].iter = q.left;
+      mask |= 1 << q.left;
+      count += 1;
+    }
+  }
+  if (need != 0) {
+    return;
+  }
+
+  for (;;) {
+    check(mask);
+    for (int j = 0;;) {
+      iter_element *q = list + j;
+      if (q->iter < q->right) {
+        mask ^= 3 << q->iter;
+        q->iter += 1;
+        break;
+      }
+
+      mask &= ~(1 << q->iter);
+      q->iter = q->left;
+      mask |= 1 << q->iter;
+
+      if (++j >= count) {
+        return;
+      }
+    }
+  }
+}
+
+void CompiledMatcher::just_a_x(const MatchProgram::op &o) {
+  for (int j = 0; j < hand_size; j++) {
+    if (o.denoms & (1 << denom_[j])) {
+      check(1 << j);
+    }
+  }
+}
+
+void CompiledMatcher::rf_n(const MatchProgram::op &o) {
+  prepare_suits();
+  const int n = o.n;
+  for (int s = 0; s < num_suits; s++) {
+    const suit_cards &st = royal_[s];
+    if (st.size < n) {
+      continue;
+    }
+
+    int subset[5];
+    unsigned mask = 0;
+    for (int z = 0; z < n; z++) {
+      subset[z] = z;
+      mask |= st.mask[z];
+    }
+
+    for (bool more = true; more;) {
+      check(mask);
+
+      // Go on to the lexicographically next subset, searching from
+      // the right for an index not at its maximum.
+      for (int z = 1;; z++) {
+        int y = n - z;
+        int index = subset[y];
+        mask ^= st.mask[index];
+
+        if (index < st.size - z) {
+          while (y < n) {
+            subset[y++] = ++index;
+            mask |= st.mask[index];
+          }
+          break;
+        }
+        if (y == 0) {
+          more = false;
+          break;
+        }
+      }
+    }
+  }
+}
+
+void CompiledMatcher::sf_n(const MatchProgram::op &o) {
+  prepare_suits();
+  const int n = o.n;
+  int reach = o.reach;
+  bool any_flag = false;
+
+  if (reach == 0) {
+    reach = 5;
+    any_flag = true;
+  }
+
+  for (;;) {
+    for (int s = 0; s < num_suits; s++) {
+      const suit_cards &st = suits_[s];
+      if (st.size < n) {
+        continue;
+      }
+
+      int queue[6];
+      int q_rear = 0, q_front = 0;
+      bool high_ace = false;
+      ace_is_low_ = true;
+
+      for (int j = 0;;) {
+        if (high_ace) {
+          break;
+        }
+
+        int left;
+        int high;
+
+        if (j >= st.size) {
+          if (st.size == 0 || st.denom[0] != ace) {
+            break;
+          }
+          high_ace = true;
+          ace_is_low_ = false;
+          left = 0;
+          j = 1;
+          high = king + 1;
+        } else {
+          left = j++;
+          high = st.denom[left];
+        }
+
+        // Push the current denomination on the queue
+        queue[q_rear++] = left;
+
+        while (q_front < q_rear - 1 &&
+               high - st.denom[queue[q_front]] + 1 > reach) {
+          q_front += 1;
+        }
+
+        if (q_rear - q_front >= n &&
+            high - st.denom[queue[q_front]] + 1 == reach) {
+          // subset holds the n indexes of queue to keep.  The last is
+          // always the card just pushed.
+          int subset[5];
+          unsigned mask = 0;
+          for (int z = 0; z < n - 1; z++) {
+            subset[z] = q_front + z;
+            mask |= st.mask[queue[q_front + z]];
+          }
+          subset[n - 1] = q_rear - 1;
+          mask |= st.mask[queue[q_rear - 1]];
+
+          for (bool more = true; more;) {
+            check(mask);
+
+            // No iteration to be done for a SF 2
+            if (n == 2) {
+              break;
+            }
+
+            for (int z = 1;; z++) {
+              int y = n - 1 - z;
+              int index = subset[y];
+              mask ^= st.mask[index];
+
+              if (index < q_rear - 1 - z) {
+                while (y < n - 1) {
+                  subset[y++] = ++index;
+                  mask |= st.mask[index];
+                }
+                break;
+              }
+              if (y == 1) {
+                more = false;
+                break;
+              }
+            }
+          }
+
+          // Having iterated the current contents of the queue,
+          // we now move on.
+          q_front += 1;
+        }
+      }
+    }
+
+    if (any_flag && reach > n) {
+      reach -= 1;
+    } else {
+      break;
+    }
+  }
+}
+
+void CompiledMatcher::straight_n(const MatchProgram::op &o) {
+  const int size = o.n;
+  int reach = o.reach;
+  bool any_flag = false;
+
+  if (reach == 0) {
+    reach = 5;
+    any_flag = true;
+  }
+
+  for (;;) {
+    bool high_ace = false;
+    ace_is_low_ = true;
+
+    struct q_element {
+      int left, iter, right;
+    } queue[6];
+    int q_rear = 0, q_front = 0;
+
+    for (int j = 0;;) {
+      if (high_ace) {
+        break;
+      }
+
+      int left = j++;
+      int d = denom_[left];
+      int high = d;
+
+      if (d == end_marker) {
+        if (hand_size == 0 || denom_[0] != ace) {
+          break;
+        }
+
+        // Wrap around and treat the ace as high
+        high_ace = true;
+        ace_is_low_ = false;
+        left = 0;
+        j = 1;
+        d = ace;
+        high = king + 1;
+      }
+      while (denom_[j] == d) {
+        j += 1;
+      }
+
+      // Push the current denomination on the queue
+      queue[q_rear].left = left;
+      queue[q_rear].right = j - 1;
+      q_rear += 1;
+
+      while (q_front < q_rear - 1 &&
+             high - denom_[queue[q_front].left] + 1 > reach) {
+        q_front += 1;
+      }
+
+      if (q_rear - q_front >= size &&
+          high - denom_[queue[q_front].left] + 1 == reach) {
+        // subset holds the "size" indexes of queue to keep.
+        int subset[5];
+        for (int z = 0; z < size - 1; z++) {
+          subset[z] = q_front + z;
+        }
+        subset[size - 1] = q_rear - 1;
+
+        for (;;) {
+          // Iterate the cards of each denomination in the subset,
+          // keeping mask the union of the iter values.
+          unsigned mask = 0;
+          for (int w = 0; w < size; w++) {
+            q_element *q = queue + subset[w];
+            q->iter = q->left;
+            mask |= 1 << q->iter;
+          }
+
+          for (bool more = true; more;) {
+            check(mask);
+
+            for (int w = 0;;) {
+              q_element *q = queue + subset[w];
+              if (q->iter < q->right) {
+                mask ^= 3 << q->iter;
+                q->iter += 1;
+                break;
+              }
+
+              mask &= ~(1 << q->iter);
+              q->iter = q->left;
+              mask |= 1 << q->iter;
+
+              if (++w >= size) {
+                more = false;
+                break;
+              }
+            }
+          }
+
+          // Go on to the lexicographically next subset.
+          // No iteration to be done for a ST 2
+          if (size == 2) {
+            break;
+          }
+
+          bool more = true;
+          for (int z = 1;; z++) {
+            int y = size - 1 - z;
+            int index = subset[y];
+            if (index < q_rear - 1 - z) {
+              while (y < size - 1) {
+                subset[y++] = ++index;
+              }
+              break;
+            }
+            if (y == 1) {
+              more = false;
+              break;
+            }
+          }
+          if (!more) {
+            break;
+          }
+        }
+
+        // Having iterated the current contents of the queue,
+        // we now move on.
+        q_front += 1;
+      }
+    }
+
+    if (any_flag && reach > size) {
+      reach -= 1;
+    } else {
+      break;
+    }
+  }
+}
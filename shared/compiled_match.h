@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "enum_match.h"
+#include "game.h"
+#include "vpoker.h"
+
+// A strategy line pattern decoded once, so that matching does not
+// have to re-read the bytes produced by parse_line for every hand and
+// every candidate play.  Each instruction has its operands unpacked,
+// the lists of denominations it names turned into bit masks, and the
+// offsets of pc_or and pc_else turned into instruction indexes.
+class MatchProgram {
+ public:
+  explicit MatchProgram(const unsigned char *pattern);
+
+  struct op {
+    std::uint8_t code;    // A parser_codes value
+    std::uint8_t n;       // The first one-byte operand, if any
+    std::uint8_t reach;   // The second operand of pc_SF_n and pc_Straight_n
+    std::uint8_t size;    // The number of denominations in list
+    std::uint16_t denoms;  // A two-byte operand, or the union of list
+    std::int32_t target;   // The instruction pc_or and pc_else go to
+    std::uint8_t list[num_denoms];
+  };
+
+  // Ends with pc_eof.
+  std::vector<op> ops;
+};
+
+// Gives the same results as EnumerateMatches, running MatchProgram
+// instead of interpreting the pattern bytes.  What depends only on the
+// hand is worked out once when the hand changes, and what depends
+// only on the hand and the cards kept is worked out once per play, so
+// trying every line of a strategy on a hand shares that work.
+class CompiledMatcher {
+ public:
+  CompiledMatcher() {}
+
+  // Input parameters, as in EnumerateMatches.
+  card hand[5];
+  int hand_size;
+  int wild_cards;
+
+  game_parameters *parms;  // Needed to tell if a card is "high".
+
+  // Output parameters set by find, as in EnumerateMatches, with the
+  // matches in the same order.
+  bool result_vector[32];
+  unsigned char matches[32];
+  int match_count;
+
+  void find(const MatchProgram &program);
+  void find(const StrategyLine &line) { find(*line.program); }
+
+ private:
+  // What the tail of a pattern needs to know about keeping the cards
+  // in a mask and discarding the rest.
+  struct kept_facts {
+    std::uint16_t have;                  // The denominations kept
+    std::uint8_t have_discard[num_denoms];  // The suits discarded of each
+    int num_kept;
+    int the_suit;  // The suit of the first card kept, or -1
+    bool suited;
+    unsigned have_suits;
+    int discard_suit_count;
+    int high_denoms;
+    int min_non_ace, max_non_ace;
+    int suited_discard;
+    int min_discard, max_discard;
+
+    bool has(int d) const { return (have >> d) & 1; }
+  };
+
+  // A run of cards of the same denomination in the sorted hand.
+  struct run {
+    int left, after, d;
+  };
+
+  // The cards of one suit, in hand order.
+  struct suit_cards {
+    int size;
+    unsigned char mask[5];
+    unsigned char denom[5];
+  };
+
+  void prepare();
+  void prepare_suits();
+  const kept_facts &facts(unsigned mask);
+  void check(unsigned mask);
+  bool matches_tail(unsigned mask);
+
+  void two_pair();
+  void trips(const MatchProgram::op &o);
+  void full_house();
+  void quads(const MatchProgram::op &o);
+  void pair_of_x(const MatchProgram::op &o);
+  void flush_n(const MatchProgram::op &o);
+  void these_n(const MatchProgram::op &o);
+  void just_a_x(const MatchProgram::op &o);
+  void rf_n(const MatchProgram::op &o);
+  void sf_n(const MatchProgram::op &o);
+  void straight_n(const MatchProgram::op &o);
+
+  // The hand that was prepared, to notice when the inputs change.
+  card prepared_hand_[5];
+  int prepared_size_ = -1;
+  const game_parameters *prepared_parms_ = nullptr;  // Sets high_
+
+  unsigned char denom_[6];  // Ends with end_marker
+  run runs_[5];
+  int num_runs_;
+  suit_cards suits_[num_suits];
+  suit_cards royal_[num_suits];  // Only the cards that can make a royal
+  bool suits_ready_;  // suits_ and royal_ are filled in when first needed
+  std::uint16_t high_;           // The denominations that are high
+
+  kept_facts facts_[32];
+  std::uint32_t facts_ready_;
+
+  // The state of find.
+  const MatchProgram::op *ops_;
+  int tail_;     // The first instruction after the current head
+  int pat_eof_;  // The pc_eof or pc_prefer a match reached, or -1
+  bool ace_is_low_;
+};
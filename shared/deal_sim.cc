@@ -0,0 +1,279 @@
+#include "deal_sim.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+
+#include "hand_class.h"
+#include "kept.h"
+#include "parse_line.h"
+#include "session_sim.h"
+#include "workers.h"
+
+strategy_file read_strategy_file(const std::string &filename) {
+  std::ifstream in(filename);
+  if (!in.is_open()) {
+    throw std::runtime_error(std::format("Could not open {}", filename));
+  }
+
+  strategy_file result;
+  int number_wild_cards = 0;
+  int wild_count = 0;
+  int line_number = 0;
+  int header_lines = 0;
+  std::string line;
+  while (std::getline(in, line)) {
+    ++line_number;
+
+    // Strip any comment and trailing blanks, as the strategy program
+    // does.
+    line.erase(std::min(line.find('#'), line.size()));
+    line.erase(line.find_last_not_of(" \r") + 1);
+    if (line.empty()) {
+      continue;
+    }
+
+    if (header_lines == 0) {
+      result.game = vp_game::find(line.c_str());
+      if (result.game == nullptr) {
+        throw std::runtime_error(std::format("Unknown game name {}", line));
+      }
+      number_wild_cards = game_parameters(*result.game).number_wild_cards;
+      result.lines.resize(number_wild_cards + 1);
+      ++header_lines;
+    } else if (header_lines == 1) {
+      // The command or the level.
+      ++header_lines;
+    } else if ('0' <= line[0] && line[0] <= '4' &&
+               (line.substr(1) == " Deuces" || line == "1 Deuce")) {
+      wild_count = line[0] - '0';
+      if (wild_count > number_wild_cards) {
+        throw std::runtime_error(std::format(
+            "Line {}: {} wild cards in a game with {}", line_number,
+            wild_count, number_wild_cards));
+      }
+    } else {
+      try {
+        result.lines[wild_count].push_back(parse_line(
+            line.c_str(), number_wild_cards == 0 ? -1 : wild_count));
+      } catch (const std::runtime_error &e) {
+        throw std::runtime_error(
+            std::format("Line {}: {}", line_number, e.what()));
+      }
+    }
+  }
+
+  if (header_lines < 2) {
+    throw std::runtime_error(std::format("Incomplete strategy file {}",
+                                         filename));
+  }
+  for (int w = 0; w <= number_wild_cards; w++) {
+    if (result.lines[w].empty()) {
+      throw std::runtime_error(std::format(
+          "No strategy for {} wild cards in {}", w, filename));
+    }
+  }
+  return result;
+}
+
+hold_chooser::hold_chooser(
+    const vp_game &game,
+    const std::vector<std::vector<StrategyLine>> &strategy)
+    : parms_(game),
+      table_(hand_table::open(game.kind)),
+      decisions_(std::make_unique<decision_table>(parms_, *table_,
+                                                  strategy)) {}
+
+hold_chooser::hold_chooser(const vp_game &game)
+    : parms_(game), oracle_(std::make_unique<play_oracle>(parms_)) {}
+
+unsigned hold_chooser::hold(const card *hand) const {
+  if (oracle_) {
+    return oracle_->query(hand).play;
+  }
+
+  // As the trainer plays: the first line that matches, keeping the
+  // wild cards.
+  const hand_classifier::sorted_hand h = decisions_->classifier().sort(hand);
+  const decision_table::decision &d = decisions_->find(h);
+  if (d.line < 0) {
+    return h.wild_mask;
+  }
+  return hand_classifier::hand_mask(h, d.mask) | h.wild_mask;
+}
+
+double deal_results::mean_error() const {
+  return hands == 0 ? 0.0
+                    : 1.96 * std::sqrt(variance / static_cast<double>(hands)) /
+                          lines;
+}
+
+double deal_results::frequency_error(int p) const {
+  // Lines of the same dealt hand aren't independent, so this is only
+  // exact for one line.
+  const double n = static_cast<double>(hands) * lines;
+  if (n == 0.0) {
+    return 0.0;
+  }
+  const double f = counts[p] / n;
+  return 1.96 * std::sqrt(f * (1.0 - f) / n);
+}
+
+double deal_results::hands_per_minute() const {
+  return seconds > 0.0 ? 60.0 * static_cast<double>(hands) * lines / seconds
+                       : 0.0;
+}
+
+// A random number from 0 to n - 1.
+static int random_below(counter_rng &rng, int n) {
+  return static_cast<int>(((rng() >> 32) * static_cast<std::uint64_t>(n)) >>
+                          32);
+}
+
+// Moves a random card of deck[0..size-1] to deck[size-1] and returns
+// it, which is one step of the trainer's shuffle_hand.
+static card draw_card(card *deck, int size, counter_rng &rng) {
+  const int top = size - 1;
+  const int x = random_below(rng, size);
+  std::swap(deck[x], deck[top]);
+  return deck[top];
+}
+
+// The payoff of a final hand, counted as the hand kept whole with
+// nothing to draw, which tells the special quads apart.
+static payoff_name final_payoff(const card *hand, game_parameters &parms,
+                                C_left &left) {
+  card sorted[5];
+  int hand_size = 0;
+  bool swap_wild_suits = false;
+  for (int j = 0; j < 5; j++) {
+    if (parms.is_wild(hand[j])) {
+      swap_wild_suits =
+          parms.kind == GK_one_eyed_jacks_wild && suit(hand[j]) == 1;
+    } else {
+      sorted[hand_size++] = hand[j];
+    }
+  }
+
+  // count_draws deems a lone wild jack to be of suit zero when it
+  // tells a natural royal from a wild one, as hand_classifier does.
+  if (swap_wild_suits && hand_size == 4) {
+    for (int j = 0; j < hand_size; j++) {
+      if (suit(sorted[j]) < 2) {
+        sorted[j] = make_card(pips(sorted[j]), suit(sorted[j]) ^ 1);
+      }
+    }
+  }
+  std::sort(sorted, sorted + hand_size);
+
+  pay_dist pays;
+  kept_description(sorted, hand_size, (1u << hand_size) - 1, parms)
+      .count_draws(5 - hand_size, left, pays);
+  const int p =
+      static_cast<int>(std::find(pays, pays + last_pay + 1, 1) - pays);
+  assert(p <= last_pay);
+  return static_cast<payoff_name>(p);
+}
+
+deal_results simulate_deals(const vp_game &game, const hold_chooser &chooser,
+                            const deal_options &options) {
+  const auto start_time = std::chrono::steady_clock::now();
+  const game_parameters game_parms(game);
+
+  // Each batch of hands keeps its own totals, added up in order at
+  // the end.
+  struct batch_totals {
+    std::int64_t won = 0;
+    double squares = 0.0;  // of the total won on each dealt hand
+    std::uint64_t counts[last_pay + 1] = {};
+  };
+  constexpr std::size_t batch = 4096;
+  const std::size_t batches = (options.hands + batch - 1) / batch;
+  std::vector<batch_totals> totals(batches);
+
+  // What each thread owns: the deck, and what it takes to name the
+  // payoff of a final hand.
+  struct thread_state {
+    game_parameters parms;
+    C_left left;
+    std::vector<card> deck;
+
+    explicit thread_state(const game_parameters &p)
+        : parms(p), left(parms), deck(parms.deck_size) {}
+  };
+
+  run_workers(
+      batches, worker_threads(options.threads, batches),
+      [&] { return std::make_unique<thread_state>(game_parms); },
+      [&](std::unique_ptr<thread_state> &state, std::size_t b) {
+        game_parameters &parms = state->parms;
+        card *const deck = state->deck.data();
+        const int deck_size = parms.deck_size;
+        batch_totals &t = totals[b];
+
+        // Every batch starts from the same deck, so that its hands
+        // depend only on its stream.
+        std::iota(state->deck.begin(), state->deck.end(), card(0));
+        counter_rng rng(options.seed, b);
+
+        const std::size_t end = std::min(options.hands, (b + 1) * batch);
+        for (std::size_t n = b * batch; n < end; n++) {
+          card dealt[5];
+          for (int j = 0; j < 5; j++) {
+            dealt[j] = draw_card(deck, deck_size - j, rng);
+          }
+          const unsigned hold = chooser.hold(dealt);
+
+          // Each line draws from the 47 (or 48) cards left, which
+          // are deck[0..remaining-1] in some order.
+          const int remaining = deck_size - 5;
+          std::int64_t won = 0;
+          for (unsigned line = 0; line < options.lines; line++) {
+            card final_hand[5];
+            int drawn = 0;
+            for (int j = 0; j < 5; j++) {
+              final_hand[j] = (hold >> j) & 1
+                                  ? dealt[j]
+                                  : draw_card(deck, remaining - drawn++, rng);
+            }
+
+            const payoff_name p = final_payoff(final_hand, parms, state->left);
+            t.counts[p]++;
+            won += static_cast<std::int64_t>(parms.pay_table[p]);
+          }
+          t.won += won;
+          t.squares += static_cast<double>(won) * static_cast<double>(won);
+        }
+      });
+
+  deal_results results;
+  results.hands = options.hands;
+  results.lines = options.lines;
+  std::int64_t won = 0;
+  double squares = 0.0;
+  for (const batch_totals &t : totals) {
+    won += t.won;
+    squares += t.squares;
+    for (int p = first_pay; p <= last_pay; p++) {
+      results.counts[p] += t.counts[p];
+    }
+  }
+
+  if (options.hands > 0 && options.lines > 0) {
+    const double n = static_cast<double>(options.hands);
+    const double mean = won / n;  // of all the lines of a hand
+    results.mean = mean / options.lines;
+    results.variance =
+        options.hands > 1 ? (squares - n * mean * mean) / (n - 1.0) : 0.0;
+  }
+
+  results.seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start_time)
+                        .count();
+  return results;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "decision_table.h"
+#include "enum_match.h"
+#include "game.h"
+#include "hand_table.h"
+#include "play_oracle.h"
+#include "vpoker.h"
+
+// A strategy file as the strategy program and the trainer read them:
+// the name of the game, a line that is ignored here (the command or
+// the level), and then the lines of the strategy, divided by "n Deuces"
+// headers in games with wild cards.  Comments after # are ignored.
+struct strategy_file {
+  const vp_game *game = nullptr;
+
+  // lines[w] holds the lines for w wild cards, in order of preference.
+  std::vector<std::vector<StrategyLine>> lines;
+};
+
+// Throws std::runtime_error if the file can't be read, the game is
+// unknown, or a line can't be parsed.
+strategy_file read_strategy_file(const std::string &filename);
+
+// Chooses which cards of a dealt hand to hold, either as the lines of
+// a strategy say, as the trainer does, or optimally.  Bit j of a hold
+// keeps hand[j].  hold may be called from any number of threads.
+class hold_chooser {
+ public:
+  hold_chooser(const vp_game &game,
+               const std::vector<std::vector<StrategyLine>> &strategy);
+  explicit hold_chooser(const vp_game &game);
+
+  hold_chooser(const hold_chooser &) = delete;
+  hold_chooser &operator=(const hold_chooser &) = delete;
+
+  unsigned hold(const card *hand) const;
+
+ private:
+  // The decision_table keeps a reference to parms_.
+  game_parameters parms_;
+  std::unique_ptr<hand_table> table_;
+  std::unique_ptr<decision_table> decisions_;  // Null for optimal play
+  std::unique_ptr<play_oracle> oracle_;        // Null for a strategy
+};
+
+struct deal_options {
+  std::size_t hands = 1000000;  // dealt
+  unsigned lines = 1;           // played from each dealt hand
+  unsigned threads = 0;         // zero means one per core
+  std::uint64_t seed = 0;
+};
+
+struct deal_results {
+  std::size_t hands = 0;
+  unsigned lines = 0;
+
+  // The number of final hands of each payoff, over all the lines.
+  std::uint64_t counts[last_pay + 1] = {};
+
+  // The mean return of a line, in bets, and the variance of the total
+  // return of the lines of one dealt hand, which are not independent.
+  double mean = 0.0;
+  double variance = 0.0;
+  double seconds = 0.0;
+
+  // Half the width of the 95% confidence interval of the mean.
+  double mean_error() const;
+
+  // The same for the fraction of lines that end with payoff p.
+  double frequency_error(int p) const;
+
+  // Lines played, each a hand drawn to.
+  double hands_per_minute() const;
+};
+
+// Deals hands from a shuffled deck, holds what chooser says, and draws
+// the replacements of each line from its own copy of the rest of the
+// deck, as in a multi-play game.  The hands are dealt in batches, each
+// with its own counter_rng stream and deck, spread over threads, so the
+// results depend only on the options' seed, not on the number of
+// threads.
+deal_results simulate_deals(const vp_game &game, const hold_chooser &chooser,
+                            const deal_options &options);
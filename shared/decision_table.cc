@@ -0,0 +1,61 @@
+#include "decision_table.h"
+
+#include "compiled_match.h"
+
+decision_table::decision_table(
+    game_parameters &parms, const hand_table &table,
+    const std::vector<std::vector<StrategyLine>> &strategy)
+    : classifier_(parms, table) {
+  for (int wild_cards = 0; wild_cards <= table.max_wild_cards() &&
+                           wild_cards < static_cast<int>(strategy.size());
+       wild_cards++) {
+    const std::vector<StrategyLine> &lines = strategy[wild_cards];
+    const auto hands = table.hands(wild_cards);
+    std::vector<decision> &decisions = decisions_[wild_cards];
+    decisions.reserve(hands.size());
+
+    CompiledMatcher matcher;
+    matcher.hand_size = 5 - wild_cards;
+    matcher.wild_cards = wild_cards;
+    matcher.parms = &parms;
+
+    for (const hand_record &r : hands) {
+      std::copy(r.cards, r.cards + 5, matcher.hand);
+      const hand_classifier::sorted_hand h =
+          classifier_.sort(r.cards, matcher.hand_size, wild_cards);
+
+      decision d;
+      d.plays = 0;
+      d.line = -1;
+      d.next_line = -1;
+      d.mask = 0;
+      d.next_mask = 0;
+
+      for (std::size_t j = 0; j < lines.size() && lines[j].pattern; j++) {
+        matcher.find(lines[j]);
+        if (matcher.match_count == 0) {
+          continue;
+        }
+
+        const unsigned mask =
+            hand_classifier::canonical_mask(h, matcher.matches[0]);
+        if (d.line < 0) {
+          d.line = static_cast<std::int16_t>(j);
+          d.mask = static_cast<std::uint8_t>(mask);
+          for (int k = 0; k < matcher.match_count; k++) {
+            d.plays |= std::uint32_t(1)
+                       << hand_classifier::canonical_mask(h,
+                                                          matcher.matches[k]);
+          }
+        } else if (mask != d.mask) {
+          // A later line that makes the same play for another reason
+          // is not a different choice.
+          d.next_line = static_cast<std::int16_t>(j);
+          d.next_mask = static_cast<std::uint8_t>(mask);
+          break;
+        }
+      }
+      decisions.push_back(d);
+    }
+  }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "enum_match.h"
+#include "game.h"
+#include "hand_class.h"
+#include "hand_table.h"
+
+// The play a strategy makes on every canonical hand, found once by
+// trying the lines of the strategy in order, so that playing a dealt
+// hand is a hand_classifier lookup and a table read instead of a scan
+// of the strategy.
+class decision_table {
+ public:
+  // strategy[w] holds the lines for w wild cards, in order of
+  // preference.  A line without a pattern ends a section early.
+  decision_table(game_parameters &parms, const hand_table &table,
+                 const std::vector<std::vector<StrategyLine>> &strategy);
+
+  // The masks are of the cards that are not wild, in the canonical
+  // order of hand_classifier.  When a line allows more than one play,
+  // mask is the one it picks on the canonical hand, which may not be
+  // the one it picks on another hand of the class; plays has them all.
+  struct decision {
+    std::uint32_t plays;      // Bit m is set for every play m of line
+    std::int16_t line;        // The first line that matches, or -1
+    std::int16_t next_line;   // The next line with another play, or -1
+    std::uint8_t mask;        // The play the line makes
+    std::uint8_t next_mask;   // The play next_line makes
+  };
+
+  const hand_classifier &classifier() const { return classifier_; }
+
+  const decision &at(int wild_cards, unsigned hand) const {
+    return decisions_[wild_cards][hand];
+  }
+
+  const decision &find(const hand_classifier::sorted_hand &h) const {
+    return at(h.wild_cards, classifier_.find(h));
+  }
+
+ private:
+  hand_classifier classifier_;
+  std::vector<decision> decisions_[5];
+};
@@ -0,0 +1,370 @@
+#define _CRT_SECURE_NO_WARNINGS  // For Microsoft Visual Studio
+#include "draw_cache.h"
+
+#include <stdio.h>
+
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <stdexcept>
+#include <system_error>
+
+#include "combin.h"
+#include "eval_game.h"
+#include "game.h"
+#include "hold_kernel.h"
+#include "kept.h"
+#include "workers.h"
+
+struct draw_cache_header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t kind;
+  std::uint32_t min_high_pair;
+  std::uint32_t hands;  // offsets has one more element than this
+  std::uint64_t data;   // The number of elements in data
+  std::uint64_t fingerprint;
+};
+
+static const char cache_magic[8] = {'V', 'P', 'D', 'R', 'A', 'W', 'S', 0};
+
+// Change this whenever all_draws or the encoding change the counts, so
+// that old files are not used.
+static const std::uint32_t cache_version = 4;
+
+namespace {
+// The data owned by each thread that computes the cache.
+struct cache_worker {
+  game_parameters parms;
+  C_left left;
+
+  cache_worker(game_kind kind, denom_value min_high_pair)
+      : parms(kind, min_high_pair), left(parms) {}
+};
+
+// The entries computed by one unit of work.
+struct cache_unit {
+  std::vector<std::uint32_t> sizes;  // Number of elements for each hand
+  std::vector<std::uint32_t> data;
+};
+
+const std::size_t hands_per_unit = 1024;
+
+void encode(const pay_dist &pays, std::vector<std::uint32_t> &data) {
+  std::uint32_t present = 0;
+  for (int j = first_pay; j <= last_pay; j++) {
+    if (pays[j]) {
+      present |= 1u << j;
+    }
+  }
+
+  data.push_back(present);
+  for (int j = first_pay; j <= last_pay; j++) {
+    if (pays[j]) {
+      data.push_back(static_cast<std::uint32_t>(pays[j]));
+    }
+  }
+}
+
+const std::uint32_t *decode(const std::uint32_t *entry, pay_dist &pays) {
+  // Returns the start of the next entry.
+  std::uint32_t present = *entry++;
+
+  for (int j = first_pay; j <= last_pay; j++) {
+    pays[j] = (present & (1u << j)) ? static_cast<int>(*entry++) : 0;
+  }
+  return entry;
+}
+}  // namespace
+
+draw_cache::draw_cache(game_kind kind, denom_value min_high_pair,
+                       unsigned threads)
+    : kind_(kind),
+      min_high_pair_(min_high_pair),
+      hands_(hand_table::open(kind)) {
+  fingerprint_ = fingerprint(kind, min_high_pair, *hands_);
+
+  // All the hands, for every number of wild cards.
+  const hand_record *const first = hands_->hands(0).data();
+  const std::size_t count =
+      hands_->hands(hands_->max_wild_cards()).data() +
+      hands_->hands(hands_->max_wild_cards()).size() - first;
+
+  std::vector<cache_unit> units((count + hands_per_unit - 1) /
+                                hands_per_unit);
+  threads = worker_threads(threads, units.size());
+
+  printf("Computing draw counts with %u threads", threads);
+
+  run_workers(
+      units.size(), threads,
+      [&]() { return cache_worker(kind, min_high_pair); },
+      [&](cache_worker &state, std::size_t u) {
+        cache_unit &unit = units[u];
+        const std::size_t end = std::min(count, (u + 1) * hands_per_unit);
+
+        for (std::size_t h = u * hands_per_unit; h < end; h++) {
+          const hand_record &r = first[h];
+          const int wild_cards = r.wild_cards;
+          const int hand_size = 5 - wild_cards;
+          const std::size_t before = unit.data.size();
+
+          state.left.remove(r.cards, hand_size, wild_cards);
+
+          // The builder visits the masks out of order, so the counts
+          // are collected first and then encoded in mask order.
+          pay_dist pays[hold_table::max_rows];
+          kept_builder builder(r.cards, hand_size, state.parms);
+          do {
+            const unsigned row = builder.mask() * (wild_cards + 1);
+            for (int keep_deuces = 0; keep_deuces <= wild_cards;
+                 keep_deuces++) {
+              builder.current().all_draws(keep_deuces, state.left,
+                                          pays[row + keep_deuces]);
+            }
+          } while (builder.next());
+
+          const unsigned rows = (1u << hand_size) * (wild_cards + 1);
+          for (unsigned row = 0; row < rows; row++) {
+            encode(pays[row], unit.data);
+          }
+
+          state.left.replace(r.cards, hand_size, wild_cards);
+
+          unit.sizes.push_back(
+              static_cast<std::uint32_t>(unit.data.size() - before));
+        }
+
+        if (u % 16 == 0) {
+          printf(".");
+        }
+      });
+
+  printf("\n");
+
+  offsets_.reserve(count + 1);
+  offsets_.push_back(0);
+  for (const cache_unit &unit : units) {
+    for (const std::uint32_t size : unit.sizes) {
+      offsets_.push_back(offsets_.back() + size);
+    }
+    data_.insert(data_.end(), unit.data.begin(), unit.data.end());
+  }
+}
+
+draw_cache::draw_cache(const std::string &filename) {
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file == nullptr) {
+    throw std::runtime_error(std::format("Could not open {}", filename));
+  }
+
+  draw_cache_header header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) == 0 &&
+            header.version == cache_version;
+
+  if (ok) {
+    kind_ = static_cast<game_kind>(header.kind);
+    min_high_pair_ = static_cast<denom_value>(header.min_high_pair);
+    fingerprint_ = header.fingerprint;
+    offsets_.resize(header.hands + std::size_t(1));
+    data_.resize(header.data);
+    ok = fread(offsets_.data(), sizeof(std::uint32_t), offsets_.size(),
+               file) == offsets_.size() &&
+         fread(data_.data(), sizeof(std::uint32_t), data_.size(), file) ==
+             data_.size() &&
+         offsets_.back() == data_.size();
+  }
+  fclose(file);
+
+  if (ok) {
+    ok = header.kind <= GK_one_eyed_jacks_wild && header.min_high_pair <= king;
+  }
+
+  if (ok) {
+    hands_ = hand_table::open(kind_);
+    const int max_wild = hands_->max_wild_cards();
+    ok = hands_->hands(max_wild).data() + hands_->hands(max_wild).size() -
+             hands_->hands(0).data() ==
+         static_cast<std::ptrdiff_t>(header.hands);
+  }
+
+  // The counts must have been computed from the same game and hands as
+  // this build would compute them from.
+  ok = ok && fingerprint_ == fingerprint(kind_, min_high_pair_, *hands_);
+
+  if (!ok) {
+    throw std::runtime_error(
+        std::format("{} is not a valid draw cache", filename));
+  }
+}
+
+void draw_cache::write(const std::string &filename) const {
+  draw_cache_header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+  header.version = cache_version;
+  header.kind = kind_;
+  header.min_high_pair = min_high_pair_;
+  header.hands = static_cast<std::uint32_t>(offsets_.size() - 1);
+  header.data = data_.size();
+  header.fingerprint = fingerprint_;
+
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error(std::format("Could not create {}", filename));
+  }
+
+  const bool ok =
+      fwrite(&header, sizeof(header), 1, file) == 1 &&
+      fwrite(offsets_.data(), sizeof(std::uint32_t), offsets_.size(), file) ==
+          offsets_.size() &&
+      fwrite(data_.data(), sizeof(std::uint32_t), data_.size(), file) ==
+          data_.size();
+  if (fclose(file) != 0 || !ok) {
+    throw std::runtime_error(std::format("Could not write {}", filename));
+  }
+}
+
+double draw_cache::get_payback(const vp_game &game,
+                               pay_prob &prob_pays) const {
+  if (game.kind != kind_ || game.min_high_pair != min_high_pair_) {
+    throw std::runtime_error(
+        std::format("The draw cache does not apply to {}", game.name));
+  }
+
+  // This follows get_payback step by step, so that the floating
+  // point operations, and hence the results, are identical.
+  game_parameters parms(game);
+
+  for (int j = first_pay; j <= last_pay; j++) {
+    prob_pays[j] = 0.0;
+  }
+
+  const int total_hands = combin.choose(parms.deck_size, 5);
+  int counter = 0;
+  std::size_t h = 0;
+  hold_table holds;
+
+  for (int wild_cards = 0; wild_cards <= parms.number_wild_cards;
+       wild_cards++) {
+    const int hand_size = 5 - wild_cards;
+    const int wmult = combin.choose(parms.number_wild_cards, wild_cards);
+
+    for (const hand_record &r : hands_->hands(wild_cards)) {
+      const std::uint32_t *entry = data_.data() + offsets_[h++];
+
+      holds.clear();
+      for (unsigned mask = 0; mask < (1u << hand_size); mask++) {
+        for (int keep_deuces = 0; keep_deuces <= wild_cards; keep_deuces++) {
+          pay_dist pays;
+          entry = decode(entry, pays);
+          merge_unpaid(pays, parms.pay_table);
+          holds.add(pays);
+        }
+      }
+
+      double values[hold_table::max_rows];
+      const unsigned optimal_mask =
+          score_holds(holds, parms.pay_table, values) / (wild_cards + 1);
+
+      // get_payback always plays the optimal mask keeping
+      // all the wild cards.
+      pay_dist pays;
+      holds.get(optimal_mask * (wild_cards + 1) + wild_cards, pays);
+
+      const int mult = wmult * r.multiplier;
+      add_draws(pays, hand_size - std::popcount(optimal_mask), parms,
+                static_cast<double>(mult) / static_cast<double>(total_hands),
+                prob_pays);
+      counter += mult;
+    }
+  }
+
+  if (counter != total_hands) {
+    printf("Iteration counter wrong\n");
+    throw 0;
+  }
+
+  double ev = 0.0;
+  for (std::size_t i = first_pay; i <= last_pay; ++i) {
+    ev += prob_pays[i] * (*game.pay_table)[i];
+  }
+  return ev;
+}
+
+std::uint64_t draw_cache::fingerprint(game_kind kind,
+                                      denom_value min_high_pair,
+                                      const hand_table &hands) {
+  // FNV-1a over the parameters and every canonical hand.
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  auto add = [&hash](const void *bytes, std::size_t size) {
+    for (std::size_t j = 0; j < size; j++) {
+      hash ^= static_cast<const unsigned char *>(bytes)[j];
+      hash *= 0x100000001b3ull;
+    }
+  };
+
+  const game_parameters parms(kind, min_high_pair);
+  const std::int32_t values[] = {
+      static_cast<std::int32_t>(cache_version), kind, min_high_pair,
+      parms.deck_size, parms.number_wild_cards, last_pay};
+  add(values, sizeof(values));
+
+  for (int wild_cards = 0; wild_cards <= hands.max_wild_cards();
+       wild_cards++) {
+    const std::span<const hand_record> records = hands.hands(wild_cards);
+    add(records.data(), records.size_bytes());
+  }
+  return hash;
+}
+
+std::string draw_cache::directory() {
+  const char *const dir = std::getenv("VPOKER_CACHE_DIR");
+  if (dir != nullptr && *dir != '\0') {
+    return dir;
+  }
+  std::error_code error;
+  const std::filesystem::path temp =
+      std::filesystem::temp_directory_path(error);
+  return (error ? std::filesystem::path("vpoker") : temp / "vpoker").string();
+}
+
+std::string draw_cache::file_name(game_kind kind, denom_value min_high_pair) {
+  static const char *const names[] = {"no_wild", "deuces_wild", "joker_wild",
+                                      "one_eyed_jacks_wild"};
+  return (std::filesystem::path(directory()) /
+          std::format("draws_{}_{}.bin", names[kind],
+                      denom_image[min_high_pair]))
+      .string();
+}
+
+std::unique_ptr<draw_cache> draw_cache::open(game_kind kind,
+                                             denom_value min_high_pair) {
+  const std::string filename = file_name(kind, min_high_pair);
+
+  try {
+    auto result = std::make_unique<draw_cache>(filename);
+    if (result->kind() == kind && result->min_high_pair() == min_high_pair) {
+      printf("Using the draw counts in %s\n", filename.c_str());
+      return result;
+    }
+  } catch (const std::runtime_error &) {
+    // Fall through and compute the cache.
+  }
+
+  auto result = std::make_unique<draw_cache>(kind, min_high_pair);
+  try {
+    std::error_code error;
+    std::filesystem::create_directories(
+        std::filesystem::path(filename).parent_path(), error);
+    result->write(filename);
+    printf("Saved the draw counts in %s\n", filename.c_str());
+  } catch (const std::runtime_error &e) {
+    // The cache is only an optimization.
+    printf("%s\n", e.what());
+  }
+  return result;
+}
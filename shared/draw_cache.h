@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hand_table.h"
+#include "vpoker.h"
+
+// The draw counts computed by all_draws depend on the kind of game,
+// the minimum high pair, the hand, the cards kept and the number of
+// wild cards kept, but not on what each combination pays.  This cache
+// holds the counts for every way of playing every canonical hand, so
+// that evaluating a new pay table for the same kind of game is just
+// a pass of dot products over the counts.
+
+// The counts are stored before merge_unpaid is applied; the merge is
+// done when a pay table is scored.
+
+class draw_cache {
+ public:
+  // Computes all the counts, spread over the given number of threads.
+  // Zero means one thread per hardware core.
+  draw_cache(game_kind kind, denom_value min_high_pair, unsigned threads = 0);
+
+  // Reads a file written by write()
+  explicit draw_cache(const std::string &filename);
+
+  void write(const std::string &filename) const;
+
+  game_kind kind() const { return kind_; }
+  denom_value min_high_pair() const { return min_high_pair_; }
+
+  // Identifies what the counts were computed from: the kind of game,
+  // the minimum high pair, the deck and its wild cards, the payoffs
+  // and the canonical hands.  A file is only used if it matches.
+  std::uint64_t fingerprint() const { return fingerprint_; }
+  static std::uint64_t fingerprint(game_kind kind, denom_value min_high_pair,
+                                   const hand_table &hands);
+
+  // Same as get_payback (bit for bit), for any game of this kind
+  // with the same minimum high pair.
+  double get_payback(const vp_game &game, pay_prob &prob_pays) const;
+
+  // The directory the caches are kept in: the one named by the
+  // VPOKER_CACHE_DIR environment variable if it is set, otherwise
+  // "vpoker" in the system's temporary directory.
+  static std::string directory();
+
+  // The conventional file for the cache, in directory().
+  static std::string file_name(game_kind kind, denom_value min_high_pair);
+
+  // Reads the conventional file if it exists and is valid.  Otherwise
+  // computes the cache, and writes it to the file for the next time.
+  // Says which file it used or saved.
+  static std::unique_ptr<draw_cache> open(game_kind kind,
+                                          denom_value min_high_pair);
+
+ private:
+  game_kind kind_;
+  denom_value min_high_pair_;
+  std::uint64_t fingerprint_;
+  std::unique_ptr<hand_table> hands_;
+
+  // For each hand in the order of the hand table, for each mask, for
+  // each number of wild cards kept, there is an entry in data_.  An
+  // entry is a bit mask of the payoffs with nonzero counts, followed
+  // by those counts.  offsets_[h] is the first entry of hand h.
+  std::vector<std::uint32_t> offsets_;
+  std::vector<std::uint32_t> data_;
+};
@@ -0,0 +1,246 @@
+#include "draw_table.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <mutex>
+
+#include "game.h"
+#include "hand_table.h"
+
+namespace {
+const int denom_bits = 13;
+const unsigned denom_mask = (1u << denom_bits) - 1;
+
+// The key of a set of cards is its four bit masks of denominations,
+// one per suit, sorted in decreasing order so that sets that differ
+// only by a permutation of the suits have the same key.
+std::uint64_t key_of(const unsigned (&masks)[num_suits]) {
+  unsigned m0 = masks[0], m1 = masks[1], m2 = masks[2], m3 = masks[3];
+  if (m0 < m1) std::swap(m0, m1);
+  if (m2 < m3) std::swap(m2, m3);
+  if (m0 < m2) std::swap(m0, m2);
+  if (m1 < m3) std::swap(m1, m3);
+  if (m1 < m2) std::swap(m1, m2);
+
+  return static_cast<std::uint64_t>(m0) << (3 * denom_bits) |
+         static_cast<std::uint64_t>(m1) << (2 * denom_bits) |
+         static_cast<std::uint64_t>(m2) << denom_bits | m3;
+}
+
+void masks_of(std::uint64_t key, unsigned (&masks)[num_suits]) {
+  for (int s = num_suits - 1; s >= 0; s--) {
+    masks[s] = static_cast<unsigned>(key) & denom_mask;
+    key >>= denom_bits;
+  }
+}
+}  // namespace
+
+draw_table::draw_table(denom_value min_high_pair)
+    : slot_keys_(std::size_t(1) << slot_bits, empty_key),
+      slot_index_(std::size_t(1) << slot_bits, -1) {
+  // Find the classes of sets of each size, by adding each card to
+  // each of the classes one smaller.  level[n] is the first set of
+  // size n in keys_.
+  std::size_t level[7];
+  level[0] = 0;
+  insert(0);
+  level[1] = keys_.size();
+
+  for (int size = 0; size < 5; size++) {
+    for (std::size_t i = level[size]; i < level[size + 1]; i++) {
+      unsigned masks[num_suits];
+      masks_of(keys_[i], masks);
+
+      for (int s = 0; s < num_suits; s++) {
+        for (int d = 0; d < num_denoms; d++) {
+          if ((masks[s] >> d & 1) == 0) {
+            masks[s] ^= 1u << d;
+            const std::uint64_t key = key_of(masks);
+            if (find(key) < 0) {
+              insert(key);
+            }
+            masks[s] ^= 1u << d;
+          }
+        }
+      }
+    }
+    level[size + 2] = keys_.size();
+  }
+
+  counts_.resize(keys_.size());
+
+  // The five-card hands are scored by the case analysis, keeping
+  // every card.
+  {
+    game_parameters parms(GK_no_wild, min_high_pair);
+    C_left left(parms);
+
+    for (std::size_t i = level[5]; i < level[6]; i++) {
+      unsigned masks[num_suits];
+      masks_of(keys_[i], masks);
+
+      card hand[5];
+      int n = 0;
+      for (int s = 0; s < num_suits; s++) {
+        for (unsigned m = masks[s]; m != 0; m &= m - 1) {
+          hand[n++] = make_card(std::countr_zero(m), s);
+        }
+      }
+      std::sort(hand, hand + 5);
+
+      pay_dist pays;
+      left.remove(hand, 5, 0);
+      kept_description(hand, 5, 0x1f, parms).count_draws(0, left, pays);
+      left.replace(hand, 5, 0);
+
+      std::copy(pays, pays + last_pay + 1, counts_[i].counts);
+    }
+  }
+
+  // Adding each of the other cards to a smaller set counts each hand
+  // once for every card it has beyond the set.
+  for (int size = 4; size >= 0; size--) {
+    for (std::size_t i = level[size]; i < level[size + 1]; i++) {
+      unsigned masks[num_suits];
+      masks_of(keys_[i], masks);
+      entry &result = counts_[i];
+
+      for (int s = 0; s < num_suits; s++) {
+        for (int d = 0; d < num_denoms; d++) {
+          if ((masks[s] >> d & 1) == 0) {
+            masks[s] ^= 1u << d;
+            const entry &larger = counts_[find(key_of(masks))];
+            for (int j = first_pay; j <= last_pay; j++) {
+              result.counts[j] += larger.counts[j];
+            }
+            masks[s] ^= 1u << d;
+          }
+        }
+      }
+
+      for (int j = first_pay; j <= last_pay; j++) {
+        _ASSERT(result.counts[j] % (5 - size) == 0);
+        result.counts[j] /= 5 - size;
+      }
+    }
+  }
+}
+
+const draw_table &draw_table::get(denom_value min_high_pair) {
+  // The tables are never freed.
+  static std::atomic<const draw_table *> tables[num_denoms];
+  static std::mutex lock;
+
+  const draw_table *table =
+      tables[min_high_pair].load(std::memory_order_acquire);
+  if (table == nullptr) {
+    std::lock_guard<std::mutex> guard(lock);
+    table = tables[min_high_pair].load(std::memory_order_relaxed);
+    if (table == nullptr) {
+      table = new draw_table(min_high_pair);
+      tables[min_high_pair].store(table, std::memory_order_release);
+    }
+  }
+  return *table;
+}
+
+int draw_table::find(std::uint64_t key) const {
+  const std::size_t mask = slot_keys_.size() - 1;
+  std::size_t slot = (key * 0x9e3779b97f4a7c15ull) >> (64 - slot_bits);
+
+  for (;;) {
+    const std::uint64_t k = slot_keys_[slot];
+    if (k == key) {
+      return slot_index_[slot];
+    }
+    if (k == empty_key) {
+      return -1;
+    }
+    slot = (slot + 1) & mask;
+  }
+}
+
+int draw_table::insert(std::uint64_t key) {
+  const std::size_t mask = slot_keys_.size() - 1;
+  std::size_t slot = (key * 0x9e3779b97f4a7c15ull) >> (64 - slot_bits);
+
+  while (slot_keys_[slot] != empty_key) {
+    slot = (slot + 1) & mask;
+  }
+
+  const int index = static_cast<int>(keys_.size());
+  slot_keys_[slot] = key;
+  slot_index_[slot] = index;
+  keys_.push_back(key);
+  return index;
+}
+
+void draw_table::draws(const unsigned (&kept)[num_suits],
+                       const card *discards, int num_discards,
+                       pay_dist &pays) const {
+  unsigned masks[num_suits] = {kept[0], kept[1], kept[2], kept[3]};
+
+  const entry &all = counts_[find(key_of(masks))];
+  for (int j = first_pay; j <= last_pay; j++) {
+    pays[j] = all.counts[j];
+  }
+
+  // Visit the subsets of the discards in Gray code order, so each
+  // differs from the one before by one card, and its sign alternates.
+  int sign = 1;
+  for (unsigned step = 1; step < (1u << num_discards); step++) {
+    const card c = discards[std::countr_zero(step)];
+    masks[suit(c)] ^= 1u << pips(c);
+    sign = -sign;
+
+    const entry &e = counts_[find(key_of(masks))];
+    for (int j = first_pay; j <= last_pay; j++) {
+      pays[j] += sign * e.counts[j];
+    }
+  }
+}
+
+std::size_t draw_table::validate(denom_value min_high_pair) {
+  game_parameters parms(GK_no_wild, min_high_pair);
+  C_left left(parms);
+  const draw_table &table = get(min_high_pair);
+  const std::unique_ptr<hand_table> hands = hand_table::open(GK_no_wild);
+
+  std::size_t errors = 0;
+  for (const hand_record &r : hands->hands(0)) {
+    left.remove(r.cards, 5, 0);
+
+    for (unsigned mask = 0; mask < 0x20; mask++) {
+      unsigned kept[num_suits] = {};
+      card discards[5];
+      int num_discards = 0;
+      for (int j = 0; j < 5; j++) {
+        if (mask >> j & 1) {
+          kept[suit(r.cards[j])] |= 1u << pips(r.cards[j]);
+        } else {
+          discards[num_discards++] = r.cards[j];
+        }
+      }
+
+      pay_dist expected;
+      kept_description(r.cards, 5, mask, parms).count_draws(0, left, expected);
+      pay_dist actual;
+      table.draws(kept, discards, num_discards, actual);
+
+      if (!std::equal(expected, expected + last_pay + 1, actual)) {
+        if (++errors <= 10) {
+          printf("Draw table differs for %s\n",
+                 move_image(r.cards, 5, mask).c_str());
+        }
+      }
+    }
+
+    left.replace(r.cards, 5, 0);
+  }
+
+  return errors;
+}
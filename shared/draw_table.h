@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "kept.h"
+#include "vpoker.h"
+
+// Draw counts for games without wild cards, by table lookup instead of
+// the case analysis in all_draws.
+//
+// Let f(K) be the counts of the payoffs of all the five-card hands
+// that contain the set of cards K, drawing the rest from the other
+// 52 - |K| cards.  f depends only on K up to a permutation of the
+// suits, and there are only about 150,000 such classes of sets of at
+// most five cards, so f can be tabulated exactly.  Then the counts
+// for keeping K and discarding D, which must avoid drawing any card
+// of D, follow by inclusion and exclusion over the subsets S of D:
+//
+//   draws(K, D) = sum over S of (-1)^|S| f(K + S)
+//
+// The counts are stored before merge_unpaid is applied.
+//
+// The counts are for drawing from the whole deck less the five cards
+// dealt, the kept cards and the discards.  all_draws uses the table
+// for games without wild cards only when its C_left is exactly that,
+// and otherwise falls back to the case analysis.
+
+class draw_table {
+ public:
+  // Computes the table.  Only the minimum high pair matters.
+  explicit draw_table(denom_value min_high_pair);
+
+  // The table for the minimum high pair, computed on first use.
+  // Safe to call from any thread.
+  static const draw_table &get(denom_value min_high_pair);
+
+  // The counts for keeping the cards in kept, given as a bit mask of
+  // denominations for each suit, and discarding the given cards.
+  void draws(const unsigned (&kept)[num_suits], const card *discards,
+             int num_discards, pay_dist &pays) const;
+
+  // The number of classes of sets of cards in the table.
+  std::size_t size() const { return counts_.size(); }
+
+  // Compares the table with the case analysis for every way of
+  // playing every canonical hand, printing the first few differences.
+  // Returns the number of plays that differ.  The strategy program's
+  // "draw table" command runs it.
+  static std::size_t validate(denom_value min_high_pair);
+
+ private:
+  struct entry {
+    std::int32_t counts[last_pay + 1];
+  };
+
+  // Finds the position of a set in counts_, or -1.
+  int find(std::uint64_t key) const;
+  int insert(std::uint64_t key);
+
+  // Open addressing with linear probing; empty slots hold empty_key.
+  static constexpr std::uint64_t empty_key = ~std::uint64_t(0);
+  static const int slot_bits = 19;
+  std::vector<std::uint64_t> slot_keys_;
+  std::vector<std::int32_t> slot_index_;
+
+  std::vector<std::uint64_t> keys_;
+  std::vector<entry> counts_;
+};
@@ -2,6 +2,17 @@
 
 #include <vector>
 
+#include "compiled_match.h"
+#include "instrument.h"
+
+StrategyLine::StrategyLine(std::vector<unsigned char> &pattern_input,
+                           char *image)
+    : options(nullptr), image(image) {
+  pattern_buffer = std::move(pattern_input);
+  pattern = pattern_buffer.data();
+  program = std::make_shared<const MatchProgram>(pattern);
+}
+
 static int count_suits(unsigned x) {
   switch (x) {
     default:
@@ -645,6 +656,9 @@ void EnumerateMatches::check(unsigned mask) {
 }
 
 void EnumerateMatches::find(unsigned char *pattern) {
+  instrument::count(instrument::find_calls);
+  instrument::phase_timer timer(instrument::matching);
+
   const unsigned end_marker = 0xff;
   pat = pattern;
 
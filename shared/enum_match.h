@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include "game.h"
@@ -78,20 +79,20 @@ enum parser_codes {
   pc_least_sp
 };
 
+class MatchProgram;
+
 // The output produced by parse_line.
 struct StrategyLine {
   StrategyLine() : options(nullptr), image(nullptr) {}
 
-  StrategyLine(std::vector<unsigned char> &pattern_input, char *image)
-      : options(nullptr), image(image) {
-    pattern_buffer = std::move(pattern_input);
-    pattern = pattern_buffer.data();
-  }
+  // Also compiles the pattern into program.
+  StrategyLine(std::vector<unsigned char> &pattern_input, char *image);
 
   // Copy constructor.
   StrategyLine(const StrategyLine &other) {
     pattern_buffer = other.pattern_buffer;  // Makes a copy
     pattern = pattern_buffer.data();
+    program = other.program;
 
     // Who owns this stuff?
     image = other.image;
@@ -103,6 +104,7 @@ struct StrategyLine {
     if (this != &other) {
       pattern_buffer = other.pattern_buffer;  // Makes a copy
       pattern = pattern_buffer.data();
+      program = other.program;
 
       // Who owns this stuff?
       image = other.image;
@@ -115,6 +117,10 @@ struct StrategyLine {
   // A pointer to a series of parser codes and small integers.
   unsigned char *pattern;
 
+  // The pattern decoded for CompiledMatcher, or null for the line that
+  // ends a strategy.
+  std::shared_ptr<const MatchProgram> program;
+
   // options is the contents of the line after the first #
   // The parser does not know the syntax of the options;
   // it just copies over the characters.
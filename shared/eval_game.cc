@@ -7,83 +7,80 @@
 
 #include "eval_game.h"
 
+#include <bit>
 #include <cstddef>
+#include <memory>
+#include <vector>
 
 #include "combin.h"
 #include "game.h"
 #include "hand_iter.h"
+#include "hand_table.h"
+#include "hold_kernel.h"
 #include "kept.h"
 #include "pay_dist.h"
 #include "vpoker.h"
+#include "workers.h"
 
-static void evaluate(hand_iter &h, int deuces, C_left &left,
-                     game_parameters &parms, double multiplier,
-                     pay_prob &prob_pays) {
-  // Compute the expected value of an initial five-card hand
-  // consisting of the cards returned by the iterator plus
-  // the indicated number of deuces.
-
-  card hand[5];
-
-  h.current(hand[0]);
-  const int hand_size = 5 - deuces;
+void find_holds(const card *hand, int wild_cards, C_left &left,
+                game_parameters &parms, hold_table &holds) {
+  const int hand_size = 5 - wild_cards;
 
-  left.remove(hand, hand_size, deuces);
+  left.remove(hand, hand_size, wild_cards);
   // Subtract the hand to be evaluated from the left structure
 
-  unsigned power = 1 << hand_size;
+  // The builder visits all 2^hand_size combinations of cards
+  // to be kept, one card at a time.
+  holds.rows = (1 << hand_size) * (wild_cards + 1);
 
-  double best_value = -1.0;
-
-  // Incrementing the binary mask iterates over all
-  // 2^hand_size combinations of cards to be kept.
-
-  unsigned optimal_mask;
-  unsigned optimal_deuces;
-
-  for (unsigned mask = 0; mask < power; mask++) {
-    kept_description kept(hand, hand_size, mask, parms);
-    // Build the description of subset of the hand
-    // indicated by mask.
+  pay_dist pays;
+  kept_builder builder(hand, hand_size, parms);
+  do {
+    kept_description &kept = builder.current();
+    const int row = builder.mask() * (wild_cards + 1);
 
     // In real video poker games offered by casinos you never
     // disard a wild card.  But it's possible to concoct
     // pay tables where that is the right move.
     // (four deuces pays 0; natural royal pays Avogadro's Number)
 
-    for (int keep_deuces = 0; keep_deuces <= deuces; keep_deuces++) {
-      pay_dist pays;
+    for (int keep_wild = 0; keep_wild <= wild_cards; keep_wild++) {
+      kept.all_draws(keep_wild, left, pays);
+      holds.set(row + keep_wild, pays);
+    }
+  } while (builder.next());
 
-      kept.all_draws(keep_deuces, left, pays);
-      {
-        int total_pays = 0;
-        double value = 0.0;
+  left.replace(hand, hand_size, wild_cards);
+}
 
-        for (int j = first_pay; j <= last_pay; j++) {
-          const int pay = pays[j];
-          total_pays += pay;
-          value += (double)pay * parms.pay_table[j];
-        }
+static int find_optimal_draws(const card *hand, int deuces, C_left &left,
+                              game_parameters &parms, pay_dist &pays) {
+  // Find the optimal play for an initial five-card hand
+  // consisting of the given cards plus the indicated number
+  // of deuces.  Stores the draw counts for that play into pays,
+  // and returns the number of discards.
 
-        value /= (double)total_pays;
+  const int hand_size = 5 - deuces;
 
-        if (value > best_value) {
-          best_value = value;
-          optimal_mask = mask;
-          optimal_deuces = deuces;
-        }
-      }
-    }
-  }
+  hold_table holds;
+  find_holds(hand, deuces, left, parms, holds);
 
-  kept_description kept(hand, hand_size, optimal_mask, parms);
-  pay_dist pays;
+  double values[hold_table::max_rows];
+  const unsigned optimal_mask =
+      score_holds(holds, parms.pay_table, values) / (deuces + 1);
+
+  // The optimal play always keeps all the deuces.
+  holds.get(optimal_mask * (deuces + 1) + deuces, pays);
 
-  kept.all_draws(optimal_deuces, left, pays);
+  return hand_size - std::popcount(optimal_mask);
+}
 
+void add_draws(const pay_dist &pays, int discards,
+               const game_parameters &parms, double multiplier,
+               pay_prob &prob_pays) {
   double scale_factor =
-      multiplier / static_cast<double>(combin.choose(
-                       parms.deck_size - 5, kept.number_of_discards()));
+      multiplier /
+      static_cast<double>(combin.choose(parms.deck_size - 5, discards));
 
   int total_pays = 0;
 
@@ -94,10 +91,22 @@ static void evaluate(hand_iter &h, int deuces, C_left &left,
     }
   }
 
-  _ASSERT(total_pays ==
-          combin.choose(parms.deck_size - 5, kept.number_of_discards()));
+  _ASSERT(total_pays == combin.choose(parms.deck_size - 5, discards));
+}
+
+static void evaluate(hand_iter &h, int deuces, C_left &left,
+                     game_parameters &parms, double multiplier,
+                     pay_prob &prob_pays) {
+  // Compute the expected value of an initial five-card hand
+  // consisting of the cards returned by the iterator plus
+  // the indicated number of deuces.
+
+  card hand[5];
+  h.current(hand[0]);
 
-  left.replace(hand, hand_size, deuces);
+  pay_dist pays;
+  const int discards = find_optimal_draws(hand, deuces, left, parms, pays);
+  add_draws(pays, discards, parms, multiplier, prob_pays);
 }
 
 double get_payback(const vp_game &game, pay_prob &prob_pays) {
@@ -155,7 +164,130 @@ double get_payback(const vp_game &game, pay_prob &prob_pays) {
   return ev;
 }
 
+// The parallel version of get_payback partitions the canonical hands
+// into work units.  Each unit is a contiguous run of the hand table
+// for one number of wild cards, all sharing the same leading (lowest)
+// denomination.  Long runs are split further so that the hands
+// containing an ace don't end up on a single thread.
+
+// Each worker thread owns its own game_parameters and C_left, finds
+// the optimal play for every hand of a unit, and records the draw
+// counts for that play.  When all the units are done, the draw counts
+// are added into prob_pays in the order the serial version visits the
+// hands.  Floating point addition is not associative, so this is what
+// makes the result bit-for-bit identical to get_payback, no matter how
+// many threads are used.
+
+namespace {
+struct work_unit {
+  const hand_record *first;
+  std::size_t count;
+};
+
+struct hand_draws {
+  unsigned mult;
+  int discards;
+  pay_dist pays;
+};
+
+const std::size_t max_unit_size = 2048;
+
+// The data owned by each worker thread.
+struct worker_state {
+  game_parameters parms;
+  C_left left;
+
+  explicit worker_state(const vp_game &game) : parms(game), left(parms) {}
+};
+
+std::vector<work_unit> make_work_units(const hand_table &table) {
+  std::vector<work_unit> result;
+
+  for (int wild_cards = 0; wild_cards <= table.max_wild_cards();
+       wild_cards++) {
+    int leading_denom = -1;
+
+    for (const hand_record &r : table.hands(wild_cards)) {
+      if (pips(r.cards[0]) != leading_denom ||
+          result.back().count == max_unit_size) {
+        leading_denom = pips(r.cards[0]);
+        result.push_back(work_unit{&r, 0});
+      }
+      result.back().count += 1;
+    }
+  }
+
+  return result;
+}
+}  // namespace
+
+double get_payback_parallel(const vp_game &game, pay_prob &prob_pays,
+                            unsigned threads) {
+  game_parameters parms(game);
+
+  printf("Evaluating optimal return for %s\n", game.name);
+
+  for (int j = first_pay; j <= last_pay; j++) {
+    prob_pays[j] = 0.0;
+  }
+
+  const int total_hands = combin.choose(parms.deck_size, 5);
+
+  const std::unique_ptr<hand_table> table = hand_table::open(parms.kind);
+  const std::vector<work_unit> units = make_work_units(*table);
+  std::vector<std::vector<hand_draws>> draws(units.size());
+
+  threads = worker_threads(threads, units.size());
+  printf("Computing with %u threads", threads);
+
+  run_workers(
+      units.size(), threads, [&]() { return worker_state(game); },
+      [&](worker_state &state, std::size_t u) {
+        const work_unit &unit = units[u];
+
+        std::vector<hand_draws> &result = draws[u];
+        result.resize(unit.count);
+
+        for (std::size_t j = 0; j < unit.count; j++) {
+          const hand_record &r = unit.first[j];
+          hand_draws &d = result[j];
+
+          d.mult = combin.choose(state.parms.number_wild_cards, r.wild_cards) *
+                   r.multiplier;
+          d.discards = find_optimal_draws(r.cards, r.wild_cards, state.left,
+                                          state.parms, d.pays);
+        }
+
+        if (u % 16 == 0) {
+          printf(".");
+        }
+      });
+
+  printf("\n");
+
+  int counter = 0;
+  for (const std::vector<hand_draws> &unit_draws : draws) {
+    for (const hand_draws &d : unit_draws) {
+      add_draws(d.pays, d.discards, parms,
+                static_cast<double>(d.mult) / static_cast<double>(total_hands),
+                prob_pays);
+      counter += d.mult;
+    }
+  }
+
+  if (counter != total_hands) {
+    printf("Iteration counter wrong\n");
+    throw 0;
+  }
+
+  double ev = 0.0;
+  for (std::size_t i = first_pay; i <= last_pay; ++i) {
+    ev += prob_pays[i] * (*game.pay_table)[i];
+  }
+  return ev;
+}
+
 void eval_game(const vp_game &game, pay_prob &prob_pays) {
-  const double ev = get_payback(game, prob_pays);
+  const double ev = get_payback_parallel(game, prob_pays);
   printf("Return %.5f%%\n", ev * 100.0);
 }
@@ -1,6 +1,28 @@
 #pragma once
 
+#include "game.h"
+#include "hold_kernel.h"
+#include "kept.h"
 #include "vpoker.h"
 
 double get_payback(const vp_game &game, pay_prob &prob_pays);
+
+// Same result as get_payback, bit for bit, but spreads the work
+// over multiple threads.  Zero means one thread per hardware core.
+double get_payback_parallel(const vp_game &game, pay_prob &prob_pays,
+                            unsigned threads = 0);
 void eval_game(const vp_game &game, pay_prob &prob_pays);
+
+// Stores the draw counts of every play of the hand made of the given
+// cards plus wild_cards wild cards into holds.  The play that keeps
+// mask of the cards and keep of the wild cards is row
+// mask * (wild_cards + 1) + keep.
+void find_holds(const card *hand, int wild_cards, C_left &left,
+                game_parameters &parms, hold_table &holds);
+
+// Adds the draw counts of an optimally played hand, weighted by
+// multiplier, into the probabilities of each payoff.  The discards
+// are the number of cards drawn.
+void add_draws(const pay_dist &pays, int discards,
+               const game_parameters &parms, double multiplier,
+               pay_prob &prob_pays);
@@ -8,7 +8,20 @@ game_parameters::game_parameters(const vp_game &g)
     pay_table[j] = static_cast<double>((*g.pay_table)[j]);
   }
 
-  switch (g.kind) {
+  set_kind(g.kind);
+}
+
+game_parameters::game_parameters(game_kind k, denom_value mhp)
+    : kind(k), min_high_pair(mhp), deck_size(52) {
+  for (int j = first_pay; j <= last_pay; j++) {
+    pay_table[j] = 1.0;
+  }
+
+  set_kind(k);
+}
+
+void game_parameters::set_kind(game_kind k) {
+  switch (k) {
     case GK_no_wild:
       number_wild_cards = 0;
       break;
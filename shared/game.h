@@ -7,6 +7,11 @@ typedef double pay_values[last_pay + 1];
 struct game_parameters {
   game_parameters(const vp_game &g);
 
+  // Parameters for computations that don't depend on the pay table,
+  // such as draw counts.  Every combination is treated as paying,
+  // so all_draws never merges one into a more general category.
+  game_parameters(game_kind k, denom_value mhp);
+
   game_kind kind;
   denom_value min_high_pair;
   pay_values pay_table;
@@ -15,4 +20,7 @@ struct game_parameters {
 
   bool is_high(int d) { return d == ace || d >= min_high_pair; };
   bool is_wild(card c);
+
+ private:
+  void set_kind(game_kind k);
 };
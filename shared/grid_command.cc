@@ -0,0 +1,47 @@
+#include "grid_command.h"
+
+#include <optional>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+std::vector<int> grid_range::values() const {
+  std::vector<int> result;
+  for (int value = low; value <= high; value += step) {
+    result.push_back(value);
+    if (value > high - step) {
+      break;
+    }
+  }
+  return result;
+}
+
+// This function parses a command line of the form
+//
+//   bankroll grid low high step low high step
+//
+// where the first three numbers are the starting bankrolls and the
+// last three are the goals, all in bets.  Every number is a positive
+// integer, and each low is at most its high.
+//
+// Unlike multi_command, this one uses std::regex to check the form of
+// the line, so the numbers can simply be read off afterwards.
+
+std::optional<grid_ranges> bankroll_grid_command(const std::string &line) {
+  static const std::regex pattern(" *bankroll +grid((?: +[0-9]{1,9}){6}) *");
+  std::smatch match;
+  if (!std::regex_match(line, match, pattern)) {
+    return std::nullopt;
+  }
+
+  std::istringstream iss(match[1].str());
+  grid_ranges result;
+  for (grid_range *range : {&result.bankrolls, &result.goals}) {
+    iss >> range->low >> range->high >> range->step;
+    if (range->low <= 0 || range->step <= 0 || range->low > range->high) {
+      return std::nullopt;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <vector>
+
+// Every step'th value from low to high, inclusive.
+struct grid_range {
+  int low;
+  int high;
+  int step;
+
+  std::vector<int> values() const;
+};
+
+struct grid_ranges {
+  grid_range bankrolls;
+  grid_range goals;
+};
+
+std::optional<grid_ranges> bankroll_grid_command(const std::string &line);
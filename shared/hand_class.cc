@@ -0,0 +1,283 @@
+#include "hand_class.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+// The finalizer of MurmurHash3, which makes every bit of the result
+// depend on every bit of x.
+std::uint64_t mix(std::uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  x ^= x >> 33;
+  return x;
+}
+
+std::size_t bucket_of(std::uint64_t key, std::size_t buckets) {
+  return static_cast<std::size_t>(mix(key) >> 32) & (buckets - 1);
+}
+
+std::size_t slot_of(std::uint64_t key, unsigned seed, std::size_t slots) {
+  return static_cast<std::size_t>(
+             mix(key + (seed + 1) * 0x9e3779b97f4a7c15ull)) &
+         (slots - 1);
+}
+
+std::size_t power_of_two(std::size_t n) {
+  std::size_t result = 1;
+  while (result < n) {
+    result *= 2;
+  }
+  return result;
+}
+}  // namespace
+
+hand_classifier::hand_classifier(game_parameters &parms,
+                                 const hand_table &table)
+    : parms_(parms) {
+  if (parms.kind != table.kind()) {
+    throw std::runtime_error("The hand table is for another kind of game");
+  }
+
+  for (int wild_cards = 0; wild_cards <= table.max_wild_cards();
+       wild_cards++) {
+    // As in the constructor of hand_iter, the suits of the wild jacks
+    // are a class of their own, which is split in two when one of them
+    // is dealt.
+    for (int s = 0; s < num_suits; s++) {
+      int c = 0;
+      if (table.kind() == GK_one_eyed_jacks_wild) {
+        c = s >= 2 ? 2 : wild_cards == 1 ? s : 0;
+      }
+      suit_class_[wild_cards][s] = static_cast<unsigned char>(c);
+    }
+
+    const auto hands = table.hands(wild_cards);
+    std::vector<slot> entries(hands.size());
+    for (std::size_t j = 0; j < hands.size(); j++) {
+      const sorted_hand h = sort(hands[j].cards, 5 - wild_cards, wild_cards);
+      slot &e = entries[j];
+      e.key = h.key;
+      e.hand = static_cast<std::int32_t>(j);
+      for (int s = 0; s < num_suits; s++) {
+        e.suits[h.canonical_suit[s]] = static_cast<unsigned char>(s);
+      }
+    }
+    build(tables_[wild_cards], entries);
+  }
+}
+
+void hand_classifier::build(key_table &t, const std::vector<slot> &entries) {
+  // About two keys to a bucket, and the slots at most four fifths full.
+  const std::size_t buckets =
+      power_of_two(std::max<std::size_t>(1, entries.size() / 2));
+  t.seeds.assign(buckets, 0);
+  t.slots.assign(power_of_two(entries.size() + entries.size() / 4 + 1),
+                 slot{0, -1, {0, 0, 0, 0}});
+
+  std::vector<std::vector<const slot *>> members(buckets);
+  for (const slot &e : entries) {
+    std::vector<const slot *> &m = members[bucket_of(e.key, buckets)];
+    for (const slot *other : m) {
+      if (other->key == e.key) {
+        throw std::runtime_error(
+            "Two canonical hands have the same cards in canonical order");
+      }
+    }
+    m.push_back(&e);
+  }
+
+  // Place the biggest buckets first, while most slots are free.
+  std::vector<std::size_t> order(buckets);
+  for (std::size_t b = 0; b < buckets; b++) {
+    order[b] = b;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&members](std::size_t x, std::size_t y) {
+                     return members[x].size() > members[y].size();
+                   });
+
+  std::vector<std::size_t> taken;
+  for (const std::size_t b : order) {
+    const std::vector<const slot *> &m = members[b];
+    if (m.empty()) {
+      break;
+    }
+
+    for (unsigned seed = 0;; seed++) {
+      if (seed > 0xffff) {
+        throw std::runtime_error(
+            "Could not build a perfect hash of the canonical hands");
+      }
+
+      taken.clear();
+      for (const slot *e : m) {
+        const std::size_t s = slot_of(e->key, seed, t.slots.size());
+        if (t.slots[s].hand >= 0 ||
+            std::find(taken.begin(), taken.end(), s) != taken.end()) {
+          break;
+        }
+        taken.push_back(s);
+      }
+
+      if (taken.size() == m.size()) {
+        t.seeds[b] = static_cast<std::uint16_t>(seed);
+        for (std::size_t k = 0; k < m.size(); k++) {
+          t.slots[taken[k]] = *m[k];
+        }
+        break;
+      }
+    }
+  }
+}
+
+hand_classifier::sorted_hand hand_classifier::sort(const card *dealt) const {
+  card cards[5];
+  int positions[5];
+  int hand_size = 0;
+  unsigned wild_mask = 0;
+  bool swap_wild_suits = false;
+
+  for (int j = 0; j < 5; j++) {
+    if (parms_.is_wild(dealt[j])) {
+      wild_mask |= 1 << j;
+      swap_wild_suits = parms_.kind == GK_one_eyed_jacks_wild &&
+                        suit(dealt[j]) == 1;
+    } else {
+      cards[hand_size] = dealt[j];
+      positions[hand_size++] = j;
+    }
+  }
+
+  // Only one wild jack tells the two wild suits apart.
+  if (hand_size != 4) {
+    swap_wild_suits = false;
+  }
+
+  sorted_hand h;
+  h.wild_mask = wild_mask;
+  sort_cards(cards, positions, hand_size, swap_wild_suits, h);
+  return h;
+}
+
+hand_classifier::sorted_hand hand_classifier::sort(const card *cards,
+                                                   int hand_size,
+                                                   int wild_cards) const {
+  _ASSERT(hand_size + wild_cards == 5);
+  const int positions[5] = {0, 1, 2, 3, 4};
+
+  sorted_hand h;
+  h.wild_mask = 0;
+  sort_cards(cards, positions, hand_size, false, h);
+  return h;
+}
+
+void hand_classifier::sort_cards(const card *cards, const int *positions,
+                                 int hand_size, bool swap_wild_suits,
+                                 sorted_hand &h) const {
+  h.hand_size = hand_size;
+  h.wild_cards = 5 - hand_size;
+  const unsigned char *classes = suit_class_[h.wild_cards];
+
+  int suits[5];
+  unsigned denoms[num_suits] = {0, 0, 0, 0};
+  for (int j = 0; j < hand_size; j++) {
+    suits[j] = suit(cards[j]);
+    if (swap_wild_suits && suits[j] < 2) {
+      suits[j] ^= 1;
+    }
+    denoms[suits[j]] |= 1 << pips(cards[j]);
+  }
+
+  // Order the suits by class, and within a class by the denominations
+  // they hold.
+  int order[num_suits] = {0, 1, 2, 3};
+  for (int j = 1; j < num_suits; j++) {
+    const int s = order[j];
+    int k = j;
+    for (; k > 0; k--) {
+      const int t = order[k - 1];
+      if (classes[t] < classes[s] ||
+          (classes[t] == classes[s] && denoms[t] >= denoms[s])) {
+        break;
+      }
+      order[k] = t;
+    }
+    order[k] = s;
+  }
+
+  int canonical_suit[num_suits];
+  h.key = 0;
+  for (int k = 0; k < num_suits; k++) {
+    canonical_suit[order[k]] = k;
+    h.key |= static_cast<std::uint64_t>(denoms[order[k]])
+             << (num_denoms * k);
+  }
+  for (int s = 0; s < num_suits; s++) {
+    h.canonical_suit[s] = static_cast<unsigned char>(
+        canonical_suit[swap_wild_suits && s < 2 ? s ^ 1 : s]);
+  }
+
+  // Then order the cards by denomination and canonical suit.
+  card sorted[5];
+  for (int j = 0; j < hand_size; j++) {
+    const card c = make_card(pips(cards[j]), canonical_suit[suits[j]]);
+    int k = j;
+    for (; k > 0 && sorted[k - 1] > c; k--) {
+      sorted[k] = sorted[k - 1];
+      h.position[k] = h.position[k - 1];
+    }
+    sorted[k] = c;
+    h.position[k] = static_cast<unsigned char>(positions[j]);
+  }
+}
+
+const hand_classifier::slot &hand_classifier::find_slot(
+    const sorted_hand &h) const {
+  const key_table &t = tables_[h.wild_cards];
+  const std::uint16_t seed = t.seeds[bucket_of(h.key, t.seeds.size())];
+  const slot &s = t.slots[slot_of(h.key, seed, t.slots.size())];
+  if (s.hand < 0 || s.key != h.key) {
+    throw std::runtime_error("The hand is not in the hand table");
+  }
+  return s;
+}
+
+unsigned hand_classifier::find(const sorted_hand &h) const {
+  return find_slot(h).hand;
+}
+
+hand_classifier::hand_class hand_classifier::classify(
+    const sorted_hand &h) const {
+  const slot &s = find_slot(h);
+  hand_class result;
+  result.hand = s.hand;
+  for (int j = 0; j < num_suits; j++) {
+    result.suit_map[j] = s.suits[h.canonical_suit[j]];
+  }
+  return result;
+}
+
+unsigned hand_classifier::hand_mask(const sorted_hand &h,
+                                    unsigned canonical_mask) {
+  unsigned result = 0;
+  for (int j = 0; j < h.hand_size; j++) {
+    if ((canonical_mask >> j) & 1) {
+      result |= 1 << h.position[j];
+    }
+  }
+  return result;
+}
+
+unsigned hand_classifier::canonical_mask(const sorted_hand &h,
+                                         unsigned hand_mask) {
+  unsigned result = 0;
+  for (int j = 0; j < h.hand_size; j++) {
+    if ((hand_mask >> h.position[j]) & 1) {
+      result |= 1 << j;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "game.h"
+#include "hand_table.h"
+#include "vpoker.h"
+
+// Finds the canonical hand that a dealt hand is equivalent to: the
+// hand in a hand_table with the same cards up to a relabeling of the
+// suits.  Canonical hands are numbered by their position in
+// hand_table::hands, which is the order hand_iter visits them.
+//
+// The suits of a hand are put in a canonical order by sorting the
+// sets of denominations held in each suit, among the suits that
+// hand_iter treats as interchangeable.  The sorted sets are a key
+// that is the same for every hand of the class, and the key is
+// looked up in a perfect hash of the keys of the canonical hands, so
+// that finding the class of any hand takes constant time.
+class hand_classifier {
+ public:
+  hand_classifier(game_parameters &parms, const hand_table &table);
+
+  // A hand with its suits in canonical order.
+  struct sorted_hand {
+    int wild_cards;
+    int hand_size;        // The number of cards that are not wild
+    unsigned wild_mask;   // The positions of the wild cards
+    std::uint64_t key;    // 13 bits of denominations for each suit
+
+    // The position in the sorted hand of each card that is not wild,
+    // in canonical order: by denomination, and then by canonical suit.
+    // Every hand of a class has the same cards in canonical order.
+    unsigned char position[5];
+
+    // The canonical suit of each suit of the hand.
+    unsigned char canonical_suit[num_suits];
+  };
+
+  // Sorts the five cards of a dealt hand, which may include wild
+  // cards.  In One Eyed Jacks with one wild card, the suit of the
+  // jack becomes suit 0, as the evaluator assumes.
+  sorted_hand sort(const card *dealt) const;
+
+  // Sorts a hand that has had its wild cards removed, such as a
+  // canonical hand.
+  sorted_hand sort(const card *cards, int hand_size, int wild_cards) const;
+
+  // The number of the canonical hand in hands(h.wild_cards).
+  unsigned find(const sorted_hand &h) const;
+
+  // The canonical hand, and the relabeling of the suits that turns
+  // the cards of the hand that are not wild into it.
+  struct hand_class {
+    unsigned hand;                      // As returned by find
+    unsigned char suit_map[num_suits];  // The suit each suit becomes
+  };
+  hand_class classify(const sorted_hand &h) const;
+
+  // Converts a mask of cards in canonical order to a mask of their
+  // positions in the sorted hand, and back.  Wild cards are not
+  // included.  A play recorded in canonical order for one hand of a
+  // class is the same play for every other hand of the class.
+  static unsigned hand_mask(const sorted_hand &h, unsigned canonical_mask);
+  static unsigned canonical_mask(const sorted_hand &h, unsigned hand_mask);
+
+ private:
+  game_parameters &parms_;
+
+  // For each number of wild cards, the suit classes as hand_iter
+  // starts with them: suits with the same number are interchangeable.
+  unsigned char suit_class_[5][num_suits];
+
+  // A perfect hash of the keys of the canonical hands, for each
+  // number of wild cards.  The keys are divided into buckets, and each
+  // bucket has a seed, found when the table is built, that sends its
+  // keys to slots no other key uses.
+  struct slot {
+    std::uint64_t key;
+    std::int32_t hand;  // The number of the canonical hand, or -1
+    unsigned char suits[num_suits];  // The suit of the canonical hand
+                                     // at each canonical suit
+  };
+  struct key_table {
+    std::vector<std::uint16_t> seeds;  // For each bucket
+    std::vector<slot> slots;
+  };
+  key_table tables_[5];
+
+  const slot &find_slot(const sorted_hand &h) const;
+  void build(key_table &t, const std::vector<slot> &entries);
+  void sort_cards(const card *cards, const int *positions, int hand_size,
+                  bool swap_wild_suits, sorted_hand &h) const;
+};
@@ -1,5 +1,7 @@
 #include "hand_iter.h"
 
+#include <mutex>
+
 // The iterator returns all possible N-card poker hands that
 // contain no wild cards, ignoring hands that are isomporphic
 // with respect to suits.  Each successive value returns one
@@ -67,8 +69,8 @@ hand_iter &hand_iter::operator=(const hand_iter &val) {
     stack[j].count = val.stack[j].count;
     stack[j].denom = val.stack[j].denom;
     stack[j].suit_classes = val.stack[j].suit_classes;
-    stack[j].suit_1 = val.stack[j].suit_classes;
-    stack[j].suit_2 = val.stack[j].suit_classes;
+    stack[j].suit_1 = val.stack[j].suit_1;
+    stack[j].suit_2 = val.stack[j].suit_2;
   }
 
   top = &(stack[val.top - val.stack]);
@@ -115,9 +117,9 @@ void hand_iter::current(card &hand) const {
   }
 }
 
-unsigned hand_iter::multiplier() const {
-  unsigned char start = stack[0].suit_classes;
-  unsigned char c = top->suit_classes;
+static unsigned class_multiplier(unsigned char start, unsigned char c) {
+  // Computes the multiplier for a hand whose suit equivalence
+  // classes began as start, and ended up as c.
 
   if ((start & (1 << 2)) != 0) {
     // This is a one-eyed jacks game where the suits
@@ -182,6 +184,10 @@ unsigned hand_iter::multiplier() const {
   return 0;
 }
 
+unsigned hand_iter::multiplier() const {
+  return class_multiplier(stack[0].suit_classes, top->suit_classes);
+}
+
 void hand_iter::start_state() {
   top->suit_1 = top->denom == short_denom ? 1 : -1;
   top->suit_2 = 3;
@@ -344,3 +350,239 @@ hand_iter::hand_iter(int size, game_kind kind, int wild_cards)
     top += 1;
   }
 }
+
+// Random access
+
+// The sequence produced by next() is a depth-first walk of a tree.
+// Each level of the stack chooses a denomination, a count and suits,
+// always in increasing order: denominations in the outer loop, then
+// counts, then the suit choices made by next_suits.  The subtree below
+// a cell depends only on the suit classes after the cell, the lowest
+// denomination still available, and the number of cards still needed.
+// There are few enough of those that the size of every subtree can be
+// tabulated, which makes it possible to compute the position of a hand
+// in the sequence (rank) and to go directly to a position (seek) by
+// walking down the tree, without visiting the hands in between.
+
+// The tables depend only on the missing and short denominations and
+// on the initial suit classes, so they are shared by all iterators
+// with the same configuration, and are filled in on demand.
+
+struct hand_iter::subtree_table {
+  // Indexed by suit classes, lowest available denomination, and
+  // number of cards needed.
+  subtree size[32][num_denoms + 1][6];
+  bool known[32][num_denoms + 1][6];
+  std::mutex lock;
+};
+
+int hand_iter::next_denom(int denom) const {
+  denom += 1;
+  if (denom == missing_denom) {
+    denom += 1;
+  }
+  return denom;
+}
+
+hand_iter::subtree hand_iter::fill_subtree(subtree_table &table, int level,
+                                           int min_denom, int need) {
+  const unsigned char classes = stack[level - 1].suit_classes;
+
+  if (table.known[classes][min_denom][need]) {
+    return table.size[classes][min_denom][need];
+  }
+
+  subtree result = {0, 0};
+
+  if (need == 0) {
+    result.hands = 1;
+    result.dealt = class_multiplier(stack[0].suit_classes, classes);
+  } else {
+    for (int d = min_denom; d <= king; d = next_denom(d)) {
+      const int max_count = d == short_denom ? 2 : 4;
+
+      for (int c = 1; c <= need && c <= max_count; c++) {
+        top = stack + level;
+        top->denom = d;
+        top->count = c;
+        start_state();
+
+        do {
+          const subtree s = fill_subtree(table, level + 1, next_denom(d),
+                                         need - c);
+          result.hands += s.hands;
+          result.dealt += s.dealt;
+          top = stack + level;
+        } while (next_suits());
+      }
+    }
+  }
+
+  table.size[classes][min_denom][need] = result;
+  table.known[classes][min_denom][need] = true;
+  return result;
+}
+
+const hand_iter::subtree_table &hand_iter::subtrees() const {
+  static subtree_table tables[4];
+
+  // The four configurations are: regular games, deuces wild,
+  // one-eyed jacks, and one-eyed jacks with one wild card.
+  int config = 0;
+  if (missing_denom != 0xff) {
+    config = 1;
+  } else if (short_denom != 0xff) {
+    config = (stack[0].suit_classes & (1 << 1)) != 0 ? 3 : 2;
+  }
+  subtree_table &table = tables[config];
+
+  std::lock_guard<std::mutex> guard(table.lock);
+  hand_iter scratch(*this);
+  scratch.fill_subtree(table, 1, ace, hand_size);
+  return table;
+}
+
+unsigned hand_iter::count() const {
+  return subtrees().size[stack[0].suit_classes][ace][hand_size].hands;
+}
+
+unsigned hand_iter::rank() const {
+  const subtree_table &table = subtrees();
+
+  if (is_done) {
+    return table.size[stack[0].suit_classes][ace][hand_size].hands;
+  }
+
+  // Walk down the stack, counting the hands in all the subtrees
+  // that precede each cell.
+  hand_iter scratch(*this);
+  unsigned result = 0;
+  int min_denom = ace;
+  int need = hand_size;
+
+  for (int level = 1; stack + level <= top; level++) {
+    const stack_element &cell = stack[level];
+    stack_element *const p = scratch.stack + level;
+
+    for (int d = min_denom; d <= cell.denom; d = next_denom(d)) {
+      const int max_count = d == short_denom ? 2 : 4;
+
+      for (int c = 1; c <= need && c <= max_count; c++) {
+        scratch.top = p;
+        p->denom = d;
+        p->count = c;
+        scratch.start_state();
+
+        do {
+          if (d == cell.denom && c == cell.count &&
+              p->suit_1 == cell.suit_1 && p->suit_2 == cell.suit_2) {
+            goto found;
+          }
+          result +=
+              table.size[p->suit_classes][next_denom(d)][need - c].hands;
+        } while (scratch.next_suits());
+      }
+    }
+    _ASSERT(0);
+
+  found:
+    need -= cell.count;
+    min_denom = next_denom(cell.denom);
+  }
+
+  return result;
+}
+
+hand_iter::subtree hand_iter::locate(unsigned target, bool by_dealt) {
+  // Positions the iterator at the hand containing the target.
+  // The target is either a hand number, or, if by_dealt is true,
+  // a number in the range of the sum of the multipliers.
+  // Returns the number of hands before that one, and the sum
+  // of their multipliers.
+
+  const subtree_table &table = subtrees();
+  const subtree &total = table.size[stack[0].suit_classes][ace][hand_size];
+
+  if (target >= (by_dealt ? total.dealt : total.hands)) {
+    is_done = true;
+    return total;
+  }
+
+  is_done = false;
+  subtree result = {0, 0};
+  int min_denom = ace;
+  int need = hand_size;
+
+  for (int level = 1; need > 0; level++) {
+    for (int d = min_denom; d <= king; d = next_denom(d)) {
+      const int max_count = d == short_denom ? 2 : 4;
+
+      for (int c = 1; c <= need && c <= max_count; c++) {
+        top = stack + level;
+        top->denom = d;
+        top->count = c;
+        start_state();
+
+        do {
+          const subtree &s =
+              table.size[top->suit_classes][next_denom(d)][need - c];
+          const unsigned size = by_dealt ? s.dealt : s.hands;
+
+          if (target < size) {
+            goto found;
+          }
+          target -= size;
+          result.hands += s.hands;
+          result.dealt += s.dealt;
+        } while (next_suits());
+      }
+    }
+    _ASSERT(0);
+
+  found:
+    need -= top->count;
+    min_denom = next_denom(top->denom);
+  }
+
+  return result;
+}
+
+void hand_iter::seek(unsigned index) { locate(index, false); }
+
+unsigned hand_iter::dealt_before(unsigned index) const {
+  hand_iter scratch(*this);
+  return scratch.locate(index, false).dealt;
+}
+
+std::vector<hand_iter::range> hand_iter::split(unsigned first, unsigned last,
+                                               int k) const {
+  hand_iter scratch(*this);
+  const unsigned low = dealt_before(first);
+  const unsigned high = dealt_before(last);
+
+  std::vector<range> result;
+  unsigned begin = first;
+
+  for (int j = 1; j <= k; j++) {
+    unsigned end = last;
+
+    if (j < k) {
+      const unsigned target = low + static_cast<unsigned>(
+                                        static_cast<unsigned long long>(
+                                            high - low) *
+                                        j / k);
+      end = scratch.locate(target, true).hands;
+      if (end < begin) {
+        end = begin;
+      }
+      if (end > last) {
+        end = last;
+      }
+    }
+
+    result.push_back(range{begin, end});
+    begin = end;
+  }
+
+  return result;
+}
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <vector>
+
 #include "vpoker.h"
 
 class hand_iter {
  public:
   hand_iter(int size, game_kind kind, int wild_cards);
+  hand_iter(const hand_iter& val) { *this = val; }
   hand_iter& operator=(const hand_iter& val);
 
   void next();
@@ -13,6 +16,28 @@ class hand_iter {
   unsigned multiplier() const;
   int size() const { return hand_size; }
 
+  // Random access to the sequence.  The hands are numbered 0..count()-1
+  // in the order next() visits them.  rank() is the number of the
+  // current hand, and seek() positions the iterator at any number.
+  // Seeking to count() makes the iterator done.
+  unsigned count() const;
+  unsigned rank() const;
+  void seek(unsigned index);
+
+  // The sum of multiplier() over the hands numbered less than index.
+  unsigned dealt_before(unsigned index) const;
+
+  // A half-open range [first, last) of hand numbers.
+  struct range {
+    unsigned first;
+    unsigned last;
+  };
+
+  // Divide [first, last) into k consecutive ranges, each covering
+  // about the same number of dealt hands (the sum of multiplier()).
+  // Some ranges may be empty if k is large.
+  std::vector<range> split(unsigned first, unsigned last, int k) const;
+
  private:
   bool is_done;
   int hand_size;
@@ -30,4 +55,17 @@ class hand_iter {
   struct stack_element* top;
   bool next_suits();
   void start_state();
+
+  // The number of hands, and the sum of their multipliers, in
+  // each subtree of the enumeration.
+  struct subtree {
+    unsigned hands;
+    unsigned dealt;
+  };
+  struct subtree_table;
+  const subtree_table& subtrees() const;
+  subtree fill_subtree(subtree_table& table, int level, int min_denom,
+                       int need);
+  int next_denom(int denom) const;
+  subtree locate(unsigned target, bool by_dealt);
 };
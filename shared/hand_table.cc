@@ -0,0 +1,223 @@
+#define _CRT_SECURE_NO_WARNINGS  // For Microsoft Visual Studio
+#include "hand_table.h"
+
+#include <stdio.h>
+
+#include <cstring>
+#include <format>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "hand_iter.h"
+
+// The file consists of a header followed by the records for zero
+// wild cards, then the records for one wild card, and so on.
+struct hand_table_header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t kind;
+  std::uint32_t max_wild_cards;
+  std::uint32_t first[7];  // first[w] is the index of the first record
+                           // with w wild cards; first[max + 1] is the total
+};
+
+static const char table_magic[8] = {'V', 'P', 'H', 'A', 'N', 'D', 'S', 0};
+
+static int wild_cards_for(game_kind kind) {
+  switch (kind) {
+    case GK_no_wild:
+      return 0;
+    case GK_deuces_wild:
+      return num_suits;
+    case GK_joker_wild:
+      return 1;
+    case GK_one_eyed_jacks_wild:
+      return 2;
+  }
+  throw std::runtime_error("Undefined game kind");
+}
+
+// Checks everything hands() relies on, so that a truncated or stale
+// file is rebuilt rather than read out of bounds.
+static bool valid_header(const hand_table_header *header, std::size_t size) {
+  if (size < sizeof(hand_table_header) ||
+      std::memcmp(header->magic, table_magic, sizeof(table_magic)) != 0 ||
+      header->version != hand_table::version) {
+    return false;
+  }
+
+  switch (header->kind) {
+    case GK_no_wild:
+    case GK_deuces_wild:
+    case GK_joker_wild:
+    case GK_one_eyed_jacks_wild:
+      break;
+    default:
+      return false;
+  }
+  const std::uint32_t max_wild_cards =
+      wild_cards_for(static_cast<game_kind>(header->kind));
+  if (header->max_wild_cards != max_wild_cards || header->first[0] != 0) {
+    return false;
+  }
+  for (std::uint32_t w = 0; w <= max_wild_cards; w++) {
+    if (header->first[w + 1] < header->first[w]) {
+      return false;
+    }
+  }
+
+  const std::size_t count = header->first[max_wild_cards + 1];
+  return size == sizeof(hand_table_header) + count * sizeof(hand_record);
+}
+
+hand_table::hand_table(game_kind kind)
+    : kind_(kind),
+      max_wild_cards_(wild_cards_for(kind)),
+      mapping_(nullptr),
+      mapping_size_(0) {
+  for (int wild_cards = 0; wild_cards <= max_wild_cards_; wild_cards++) {
+    first_[wild_cards] = static_cast<std::uint32_t>(owned_.size());
+
+    const int hand_size = 5 - wild_cards;
+    hand_iter iter(hand_size, kind, wild_cards);
+    owned_.reserve(owned_.size() + iter.count());
+
+    while (!iter.done()) {
+      hand_record r;
+      std::memset(&r, 0, sizeof(r));
+      iter.current(r.cards[0]);
+      r.wild_cards = static_cast<std::uint8_t>(wild_cards);
+      r.multiplier = static_cast<std::uint16_t>(iter.multiplier());
+      owned_.push_back(r);
+
+      iter.next();
+    }
+  }
+  first_[max_wild_cards_ + 1] = static_cast<std::uint32_t>(owned_.size());
+  records_ = owned_.data();
+}
+
+hand_table::hand_table(const std::string &filename)
+    : mapping_(nullptr), mapping_size_(0) {
+#ifdef _WIN32
+  HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error(std::format("Could not open {}", filename));
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    throw std::runtime_error(std::format("Could not size {}", filename));
+  }
+  HANDLE section = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (section == NULL) {
+    throw std::runtime_error(std::format("Could not map {}", filename));
+  }
+  mapping_ = MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(section);
+  if (mapping_ == NULL) {
+    throw std::runtime_error(std::format("Could not map {}", filename));
+  }
+  mapping_size_ = static_cast<std::size_t>(size.QuadPart);
+#else
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error(std::format("Could not open {}", filename));
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error(std::format("Could not size {}", filename));
+  }
+  mapping_size_ = static_cast<std::size_t>(st.st_size);
+  void *p = mmap(nullptr, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    throw std::runtime_error(std::format("Could not map {}", filename));
+  }
+  mapping_ = p;
+#endif
+
+  const hand_table_header *header =
+      static_cast<const hand_table_header *>(mapping_);
+
+  if (!valid_header(header, mapping_size_)) {
+    unmap();
+    throw std::runtime_error(
+        std::format("{} is not a valid hand table", filename));
+  }
+
+  kind_ = static_cast<game_kind>(header->kind);
+  max_wild_cards_ = header->max_wild_cards;
+  for (int j = 0; j <= max_wild_cards_ + 1; j++) {
+    first_[j] = header->first[j];
+  }
+  records_ = reinterpret_cast<const hand_record *>(header + 1);
+}
+
+hand_table::~hand_table() { unmap(); }
+
+void hand_table::unmap() {
+  if (mapping_) {
+#ifdef _WIN32
+    UnmapViewOfFile(mapping_);
+#else
+    munmap(mapping_, mapping_size_);
+#endif
+    mapping_ = nullptr;
+  }
+}
+
+void hand_table::write(const std::string &filename) const {
+  hand_table_header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, table_magic, sizeof(table_magic));
+  header.version = version;
+  header.kind = kind_;
+  header.max_wild_cards = max_wild_cards_;
+  for (int j = 0; j <= max_wild_cards_ + 1; j++) {
+    header.first[j] = first_[j];
+  }
+
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error(std::format("Could not create {}", filename));
+  }
+
+  const std::size_t count = first_[max_wild_cards_ + 1];
+  const bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  fwrite(records_, sizeof(hand_record), count, file) == count;
+  if (fclose(file) != 0 || !ok) {
+    throw std::runtime_error(std::format("Could not write {}", filename));
+  }
+}
+
+std::string hand_table::file_name(game_kind kind) {
+  static const char *const names[] = {"no_wild", "deuces_wild", "joker_wild",
+                                      "one_eyed_jacks_wild"};
+  return std::format("hands_{}.bin", names[kind]);
+}
+
+std::unique_ptr<hand_table> hand_table::open(game_kind kind) {
+  try {
+    auto result = std::make_unique<hand_table>(file_name(kind));
+    if (result->kind() == kind) {
+      return result;
+    }
+  } catch (const std::runtime_error &) {
+    // Fall through and build the table.
+  }
+
+  return std::make_unique<hand_table>(kind);
+}
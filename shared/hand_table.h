@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "vpoker.h"
+
+// A flat table of the canonical hands produced by hand_iter, for
+// every number of wild cards a game kind can be dealt.  The table
+// can be written to a binary file once, and then memory mapped
+// read-only by any number of processes, so evaluators can scan an
+// array instead of re-running the iterator.
+
+struct hand_record {
+  card cards[5];             // In hand_iter order, unused slots are zero
+  std::uint8_t wild_cards;   // The number of wild cards not in cards
+  std::uint16_t multiplier;  // hand_iter::multiplier()
+};
+static_assert(sizeof(hand_record) == 8);
+
+class hand_table {
+ public:
+  // Builds the table in memory.
+  explicit hand_table(game_kind kind);
+
+  // Maps a file written by write() into memory.
+  explicit hand_table(const std::string &filename);
+
+  ~hand_table();
+  hand_table(const hand_table &) = delete;
+  hand_table &operator=(const hand_table &) = delete;
+
+  // Changes whenever the files or the order of the hands change.
+  static constexpr std::uint32_t version = 1;
+
+  game_kind kind() const { return kind_; }
+  int max_wild_cards() const { return max_wild_cards_; }
+
+  // The hands dealt with the given number of wild cards, in the
+  // order hand_iter(5 - wild_cards, kind, wild_cards) visits them.
+  std::span<const hand_record> hands(int wild_cards) const {
+    return std::span<const hand_record>(records_ + first_[wild_cards],
+                                        records_ + first_[wild_cards + 1]);
+  }
+
+  void write(const std::string &filename) const;
+
+  // The conventional file name for the table of a game kind.
+  static std::string file_name(game_kind kind);
+
+  // Maps the conventional file if it exists and is valid,
+  // otherwise builds the table in memory.
+  static std::unique_ptr<hand_table> open(game_kind kind);
+
+ private:
+  game_kind kind_;
+  int max_wild_cards_;
+  std::uint32_t first_[7];
+  const hand_record *records_;
+
+  std::vector<hand_record> owned_;
+  void *mapping_;
+  std::size_t mapping_size_;
+  void unmap();
+};
@@ -0,0 +1,193 @@
+#include "hold_kernel.h"
+
+#include <cstdint>
+#include <format>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define HOLD_KERNEL_X64
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// The vector kernels must round exactly as play_value does, so
+// the multiply and the add must not be fused.  Visual Studio does not
+// contract unless asked to with /fp:contract, but gcc does by default.
+#if defined(__GNUC__) && !defined(__clang__)
+#define TARGET_AVX2 \
+  __attribute__((target("avx2"), optimize("fp-contract=off")))
+#define TARGET_AVX512 \
+  __attribute__((target("avx2,avx512f"), optimize("fp-contract=off")))
+#elif defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx2,avx512f")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+double play_value(const pay_dist &pays, const pay_values &pay_table) {
+  int total_pays = 0;
+  double value = 0.0;
+
+  for (int j = first_pay; j <= last_pay; j++) {
+    const int pay = pays[j];
+    total_pays += pay;
+    value += (double)pay * pay_table[j];
+  }
+
+  return value / (double)total_pays;
+}
+
+static void scalar_values(const hold_table &holds, const pay_values &pay_table,
+                          double *values) {
+  for (int row = 0; row < holds.rows; row++) {
+    int total_pays = 0;
+    double value = 0.0;
+
+    for (int j = first_pay; j <= last_pay; j++) {
+      const int pay = holds.counts[j][row];
+      total_pays += pay;
+      value += (double)pay * pay_table[j];
+    }
+
+    values[row] = value / (double)total_pays;
+  }
+}
+
+#ifdef HOLD_KERNEL_X64
+
+// Rows past holds.rows are zero (or left over from an earlier hand);
+// their values are computed along with the rest and ignored.
+
+TARGET_AVX2
+static void avx2_values(const hold_table &holds, const pay_values &pay_table,
+                        double *values) {
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#endif
+  for (int row = 0; row < holds.rows; row += 4) {
+    __m128i total_pays = _mm_setzero_si128();
+    __m256d value = _mm256_setzero_pd();
+
+    for (int j = first_pay; j <= last_pay; j++) {
+      const __m128i pay = _mm_load_si128(
+          reinterpret_cast<const __m128i *>(&holds.counts[j][row]));
+      total_pays = _mm_add_epi32(total_pays, pay);
+      value = _mm256_add_pd(value, _mm256_mul_pd(_mm256_cvtepi32_pd(pay),
+                                                 _mm256_set1_pd(pay_table[j])));
+    }
+
+    _mm256_storeu_pd(values + row,
+                     _mm256_div_pd(value, _mm256_cvtepi32_pd(total_pays)));
+  }
+}
+
+TARGET_AVX512
+static void avx512_values(const hold_table &holds, const pay_values &pay_table,
+                          double *values) {
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#endif
+  for (int row = 0; row < holds.rows; row += 8) {
+    __m256i total_pays = _mm256_setzero_si256();
+    __m512d value = _mm512_setzero_pd();
+
+    for (int j = first_pay; j <= last_pay; j++) {
+      const __m256i pay = _mm256_load_si256(
+          reinterpret_cast<const __m256i *>(&holds.counts[j][row]));
+      total_pays = _mm256_add_epi32(total_pays, pay);
+      value = _mm512_add_pd(value, _mm512_mul_pd(_mm512_cvtepi32_pd(pay),
+                                                 _mm512_set1_pd(pay_table[j])));
+    }
+
+    _mm512_storeu_pd(values + row,
+                     _mm512_div_pd(value, _mm512_cvtepi32_pd(total_pays)));
+  }
+}
+
+#if defined(_MSC_VER)
+// The feature bits say what the processor can do, but the wide
+// registers are only usable if the operating system saves them.
+static bool os_saves(unsigned long long state) {
+  return (_xgetbv(0) & state) == state;
+}
+
+static hold_kernel detect_kernel() {
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) return hold_kernel::scalar;
+
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  if (!osxsave || !os_saves(0x6)) return hold_kernel::scalar;
+
+  __cpuidex(info, 7, 0);
+  const bool avx2 = (info[1] & (1 << 5)) != 0;
+  const bool avx512f = (info[1] & (1 << 16)) != 0;
+
+  if (avx2 && avx512f && os_saves(0xe6)) return hold_kernel::avx512;
+  if (avx2) return hold_kernel::avx2;
+  return hold_kernel::scalar;
+}
+#else
+static hold_kernel detect_kernel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("avx512f")) {
+    return hold_kernel::avx512;
+  }
+  if (__builtin_cpu_supports("avx2")) return hold_kernel::avx2;
+  return hold_kernel::scalar;
+}
+#endif
+
+#else
+
+static hold_kernel detect_kernel() { return hold_kernel::scalar; }
+
+#endif  // HOLD_KERNEL_X64
+
+hold_kernel best_hold_kernel() {
+  static const hold_kernel best = detect_kernel();
+  return best;
+}
+
+int score_holds(const hold_table &holds, const pay_values &pay_table,
+                double (&values)[hold_table::max_rows], hold_kernel kernel) {
+  switch (kernel) {
+    case hold_kernel::scalar:
+      scalar_values(holds, pay_table, values);
+      break;
+#ifdef HOLD_KERNEL_X64
+    case hold_kernel::avx2:
+      avx2_values(holds, pay_table, values);
+      break;
+    case hold_kernel::avx512:
+      avx512_values(holds, pay_table, values);
+      break;
+#endif
+    default:
+      throw std::runtime_error(std::format("Hold kernel {} is not available",
+                                           static_cast<int>(kernel)));
+  }
+
+  // Same choice as a loop over the plays that keeps a value only
+  // when it is strictly better.
+  double best_value = -1.0;
+  int best_row = 0;
+  for (int row = 0; row < holds.rows; row++) {
+    if (values[row] > best_value) {
+      best_value = values[row];
+      best_row = row;
+    }
+  }
+  return best_row;
+}
+
+int score_holds(const hold_table &holds, const pay_values &pay_table,
+                double (&values)[hold_table::max_rows]) {
+  static const hold_kernel kernel = best_hold_kernel();
+  return score_holds(holds, pay_table, values, kernel);
+}
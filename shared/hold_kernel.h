@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+#include "game.h"
+#include "kept.h"
+#include "vpoker.h"
+
+// The draw counts of all the ways of playing one hand, stored payoff
+// by payoff (structure of arrays) so that the values of all the plays
+// can be computed together with vector instructions.
+// counts[j][row] is the number of draws for play row that make payoff j.
+// A hand has at most 32 plays: five cards give 2^5 masks, and each
+// wild card dealt removes a card from the masks but adds a choice of
+// how many wild cards to keep.
+struct hold_table {
+  static const int max_rows = 32;
+
+  int rows = 0;
+  alignas(64) std::int32_t counts[last_pay + 1][max_rows] = {};
+
+  void clear() { rows = 0; }
+
+  // Appends a play, returning its row.
+  int add(const pay_dist &pays) {
+    set(rows, pays);
+    return rows++;
+  }
+
+  // Stores a play into a row that is already counted in rows.
+  void set(int row, const pay_dist &pays) {
+    for (int j = first_pay; j <= last_pay; j++) {
+      counts[j][row] = pays[j];
+    }
+  }
+
+  void get(int row, pay_dist &pays) const {
+    for (int j = first_pay; j <= last_pay; j++) {
+      pays[j] = counts[j][row];
+    }
+  }
+};
+
+// The expected value of a play, given its draw counts.
+double play_value(const pay_dist &pays, const pay_values &pay_table);
+
+enum class hold_kernel { scalar, avx2, avx512 };
+
+// The widest kernel the processor (and operating system) supports.
+hold_kernel best_hold_kernel();
+
+// Computes the value of every play in the table into values, bit for
+// bit the same as play_value, and returns the first row with the
+// highest value.  The kernel is chosen once, by best_hold_kernel.
+int score_holds(const hold_table &holds, const pay_values &pay_table,
+                double (&values)[hold_table::max_rows]);
+
+// Same, with a particular kernel, which must be supported.
+int score_holds(const hold_table &holds, const pay_values &pay_table,
+                double (&values)[hold_table::max_rows], hold_kernel kernel);
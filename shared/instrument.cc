@@ -0,0 +1,100 @@
+#include "instrument.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace instrument {
+
+bool enabled = false;
+
+namespace {
+
+std::atomic<std::uint64_t> counters[num_counters];
+std::atomic<std::int64_t> phase_ns[num_phases];
+
+// Calls of find for each strategy line, in the order the lines were
+// added, and where each line's image is in that order.
+std::mutex line_mutex;
+std::vector<std::pair<const char *, std::uint64_t>> line_counts;
+std::unordered_map<const char *, std::size_t> line_positions;
+
+const char *const counter_names[num_counters] = {
+    "canonical hands visited", "all_draws calls",   "eval cache hits",
+    "eval cache misses",       "find calls",        "left.remove calls",
+    "left.replace calls",      "distinct multi wagers"};
+
+const char *const phase_names[num_phases] = {
+    "enumeration", "matching", "draw counting", "sort_moves",
+    "report writing"};
+
+}  // namespace
+
+void enable() { enabled = true; }
+
+void add(counter c, std::uint64_t n) {
+  counters[c].fetch_add(n, std::memory_order_relaxed);
+}
+
+void add_time(phase p, std::chrono::steady_clock::duration d) {
+  phase_ns[p].fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(),
+      std::memory_order_relaxed);
+}
+
+void add_line(const char *image, std::uint64_t n) {
+  if (!enabled) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(line_mutex);
+  auto [entry, inserted] =
+      line_positions.try_emplace(image, line_counts.size());
+  if (inserted) {
+    line_counts.emplace_back(image, 0);
+  }
+  line_counts[entry->second].second += n;
+}
+
+void report(FILE *file, const char *command) {
+  if (!enabled) {
+    return;
+  }
+
+  fprintf(file, "\nStatistics for %s\n", command);
+
+  fprintf(file, "Counters\n");
+  for (int c = 0; c < num_counters; c++) {
+    fprintf(file, "  %-26s %14llu\n", counter_names[c],
+            static_cast<unsigned long long>(counters[c].load()));
+  }
+  const std::uint64_t removes = counters[left_removes].load();
+  const std::uint64_t replaces = counters[left_replaces].load();
+  if (removes != replaces) {
+    fprintf(file, "  left.remove and left.replace are unbalanced\n");
+  }
+
+  fprintf(file, "Phases (seconds, summed over threads; "
+                "enumeration includes the others)\n");
+  for (int p = 0; p < num_phases; p++) {
+    fprintf(file, "  %-26s %14.3f\n", phase_names[p],
+            static_cast<double>(phase_ns[p].load()) * 1e-9);
+  }
+
+  std::lock_guard<std::mutex> lock(line_mutex);
+  if (!line_counts.empty()) {
+    fprintf(file, "find calls by strategy line\n");
+    for (const auto &[image, n] : line_counts) {
+      fprintf(file, "  %14llu  %s\n", static_cast<unsigned long long>(n),
+              image);
+    }
+  }
+}
+
+}  // namespace instrument
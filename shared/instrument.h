@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Counters and phase timers for the hot paths.  Everything is off
+// unless enable() is called, and while it is off the cost of a counter
+// or timer is one test of a flag.  The counters are atomic, so work spread over
+// threads is counted correctly, and phase times are summed over all
+// the threads that run the phase.
+
+namespace instrument {
+
+enum counter {
+  hands_visited,  // canonical hands evaluated by the command
+  all_draws_calls,
+  eval_cache_hits,
+  eval_cache_misses,
+  find_calls,  // EnumerateMatches::find, all strategy lines
+  left_removes,
+  left_replaces,
+  multi_wagers,  // different wagers the multi command repeats
+  num_counters
+};
+
+enum phase {
+  enumeration,  // the loops over the canonical hands, including the rest
+  matching,     // EnumerateMatches::find
+  draw_counting,  // all_draws
+  sorting_moves,  // MoveList::sort_moves
+  report_writing,
+  num_phases
+};
+
+extern bool enabled;
+
+void enable();
+
+void add(counter c, std::uint64_t n);
+void add_time(phase p, std::chrono::steady_clock::duration d);
+
+inline void count(counter c) {
+  if (enabled) {
+    add(c, 1);
+  }
+}
+
+// Adds calls of EnumerateMatches::find for the strategy line with the
+// given image.  Callers count the calls of each line themselves and
+// add them from one thread, in strategy order, which is the order the
+// lines are reported in.
+void add_line(const char *image, std::uint64_t n);
+
+// Adds the time from construction to destruction to a phase.
+class phase_timer {
+ public:
+  explicit phase_timer(phase p) : phase_(p), running_(enabled) {
+    if (running_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+  ~phase_timer() {
+    if (running_) {
+      add_time(phase_, std::chrono::steady_clock::now() - start_);
+    }
+  }
+  phase_timer(const phase_timer &) = delete;
+  phase_timer &operator=(const phase_timer &) = delete;
+
+ private:
+  phase phase_;
+  bool running_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Prints everything collected for the command.  Does nothing unless
+// enabled.
+void report(FILE *file, const char *command);
+
+// Calls report when it goes out of scope, so a command is reported
+// however it returns.  The command is read only then, so it can be
+// filled in after the guard is made.
+class report_on_exit {
+ public:
+  report_on_exit(FILE *file, const std::string &command)
+      : file_(file), command_(command) {}
+  ~report_on_exit() { report(file_, command_.c_str()); }
+  report_on_exit(const report_on_exit &) = delete;
+  report_on_exit &operator=(const report_on_exit &) = delete;
+
+ private:
+  FILE *file_;
+  const std::string &command_;
+};
+
+}  // namespace instrument
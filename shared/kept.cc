@@ -1,10 +1,14 @@
 #include "kept.h"
 
+#include <bit>
 #include <iostream>
 #include <sstream>
 #include <string>
 
 #include "combin.h"
+#include "denom_list.h"
+#include "draw_table.h"
+#include "instrument.h"
 
 static const bool trace = true;
 
@@ -83,6 +87,7 @@ C_left::C_left(game_parameters &parms) : parms(parms) {
 }
 
 void C_left::remove(const card *hand, int hand_size, int jokers_in_hand) {
+  instrument::count(instrument::left_removes);
   for (int j = 0; j < hand_size; j++) {
     const card c = hand[j];
     const int d = pips(c);
@@ -101,6 +106,7 @@ void C_left::remove(const card *hand, int hand_size, int jokers_in_hand) {
 }
 
 void C_left::replace(const card *hand, int hand_size, int jokers_in_hand) {
+  instrument::count(instrument::left_replaces);
   for (int j = 0; j < hand_size; j++) {
     const card c = hand[j];
     const int d = pips(c);
@@ -204,6 +210,37 @@ C_kept_description::C_kept_description(const card *hand, int hand_size,
     mask >>= 1;
   }
 
+  set_reach(endpoint, end_index);
+
+  if (multi_count != 0) {
+    // Process one of the multiples
+    // (Duplicates previous code.  Ugh)
+
+    multi[multi_count] += 1;
+    if (multi_count == 1)
+      other_singleton = m_denom[1];
+    else if (multi_count == 2)
+      other_pair = m_denom[2];
+    m_denom[multi_count] = previous_d;
+  }
+
+  if (!suited) {
+    the_suit = -1;
+  }
+
+  int nn = 0;
+
+  for (j = 0; j < num_suits; j++) {
+    if (suit_count[j] == 1) {
+      singleton = one_card[j];
+      nn += 1;
+    }
+  }
+
+  has_singleton = (nn == 1);
+}
+
+void C_kept_description::set_reach(int *endpoint, int end_index) {
   switch (end_index) {
     case -1:
       // No cards
@@ -262,33 +299,122 @@ C_kept_description::C_kept_description(const card *hand, int hand_size,
     default:
       _ASSERT(false);
   }
+}
 
-  if (multi_count != 0) {
-    // Process one of the multiples
-    // (Duplicates previous code.  Ugh)
+kept_builder::kept_builder(const card *hand, int hand_size,
+                           game_parameters &parms)
+    : hand_size_(hand_size), kept_(hand, hand_size, 0, parms) {
+  for (int j = 0; j < hand_size; j++) {
+    hand_[j] = hand[j];
+    const int d = pips(hand[j]);
+    if (groups_ == 0 || group_denom_[groups_ - 1] != d) {
+      group_denom_[groups_] = d;
+      group_count_[groups_] = 0;
+      groups_ += 1;
+    }
+    card_group_[j] = groups_ - 1;
+  }
+}
 
-    multi[multi_count] += 1;
-    if (multi_count == 1)
-      other_singleton = m_denom[1];
-    else if (multi_count == 2)
-      other_pair = m_denom[2];
-    m_denom[multi_count] = previous_d;
+bool kept_builder::next() {
+  if (step_ + 1 >= (1u << hand_size_)) {
+    return false;
   }
 
-  if (!suited) {
-    the_suit = -1;
+  // Gray code step k changes the bit of the lowest one in k.
+  step_ += 1;
+  toggle(std::countr_zero(step_));
+  finish();
+  return true;
+}
+
+void kept_builder::toggle(int index) {
+  const card c = hand_[index];
+  const int d = pips(c);
+  const int s = suit(c);
+
+  const unsigned bit = 1u << index;
+  const int change = (mask_ & bit) ? -1 : 1;
+
+  mask_ ^= bit;
+  suit_bits_[s] ^= bit;
+  suit_count_[s] += change;
+  const int g = card_group_[index];
+  group_count_[g] += change;
+  if (group_count_[g] != 0) {
+    kept_groups_ |= 1u << g;
+  } else {
+    kept_groups_ &= ~(1u << g);
   }
 
-  int nn = 0;
+  const bool had = kept_.have_suit[d] != 0;
+  kept_.have_suit[d] ^= 1 << s;
+  const bool has = kept_.have_suit[d] != 0;
 
-  for (j = 0; j < num_suits; j++) {
-    if (suit_count[j] == 1) {
-      singleton = one_card[j];
-      nn += 1;
-    }
+  kept_.have[d] = has;
+  if (had != has && kept_.parms.is_high(d)) {
+    kept_.high_denoms += has ? 1 : -1;
   }
+}
 
-  has_singleton = (nn == 1);
+void kept_builder::finish() {
+  // Everything that depends on more than one card is recomputed
+  // from the counts of the runs and suits, in the same order as
+  // the constructor.
+  kept_description &k = kept_;
+
+  for (int j = 0; j <= num_suits; j++) {
+    k.multi[j] = 0;
+    k.m_denom[j] = -1;
+  }
+  k.other_pair = -1;
+  k.other_singleton = -1;
+
+  int endpoint[3];
+  int end_index = -1;
+
+  for (unsigned groups = kept_groups_; groups != 0; groups &= groups - 1) {
+    const int g = std::countr_zero(groups);
+    const int count = group_count_[g];
+
+    if (end_index < 2) end_index += 1;
+    endpoint[end_index] = group_denom_[g];
+
+    k.multi[count] += 1;
+    if (count == 1)
+      k.other_singleton = k.m_denom[1];
+    else if (count == 2)
+      k.other_pair = k.m_denom[2];
+    k.m_denom[count] = group_denom_[g];
+  }
+
+  k.set_reach(endpoint, end_index);
+
+  // These loops are written without branches, because whether
+  // a suit or card is kept changes unpredictably from mask to mask.
+  int suits_kept = 0;
+  int nn = 0;
+  int the_suit = -1;
+  for (int s = 0; s < num_suits; s++) {
+    const bool kept = suit_count_[s] != 0;
+    suits_kept += kept;
+    the_suit = kept ? s : the_suit;
+
+    const bool single = suit_count_[s] == 1;
+    nn += single;
+    k.singleton = single ? hand_[std::countr_zero(suit_bits_[s] | 0x10)]
+                         : k.singleton;
+  }
+  k.suited = suits_kept <= 1;
+  k.the_suit = k.suited ? the_suit : -1;
+  k.has_singleton = (nn == 1);
+
+  int num_discards = 0;
+  for (int j = 0; j < hand_size_; j++) {
+    k.discards[num_discards] = hand_[j];
+    num_discards += (mask_ >> j & 1) ^ 1;
+  }
+  k.num_discards = num_discards;
 }
 
 const char *C_kept_description::display() {
@@ -478,321 +604,78 @@ std::string C_kept_description::move_name() {
   return name.str();
 }
 
-class denom_list {
- private:
-  int *left;
-
- public:
-  inline void add(int denom) { avail[left[denom]]++; }
-  inline void remove(int denom) { avail[left[denom]]--; }
-  // The client must not add the same denomination twice,
-  // and must only remove denominations that have been
-  // added.  There is no checking of these restrictions.
-
-  int no_pair(int n);
-  // returns the number of ways of selecting n cards that do
-  // not pair up (that is only one of each denomination).
-
-  int one_pair(int n);
-  int two_pair(int n);
-  int triple(int n);
-  int full_house(int n);
-  int quad(int n);
-
-  int multi(int m, int n);
-  // m = 2 => one_pair
-  // m = 3 => triple, etc.
-
-  denom_list(int *left_table);
-
- private:
-  int avail[num_suits + 1];
-  // For each denomination added, we need to know the number of
-  // that kind of card is available.  This information is stored
-  // inverted-- for each number that might be available 0, 1, 2, 3, 4,
-  // we keep the number of denominations that have that availability.
+// Define an object with a function parameter such that
+// the function gets called when the object is destroyed.
+template <typename F>
+struct ScopeGuard {
+  F f;
+  ~ScopeGuard() { f(); }
+  ScopeGuard(F f) : f(f) {}
 };
 
-denom_list::denom_list(int *left_table) {
-  left = left_table;
-  for (int j = 0; j <= num_suits; j++) avail[j] = 0;
-}
-
-int denom_list::no_pair(int n) {
-  _ASSERT(n >= 0);
-  // Everything is unrolled here; we know num_suits=4
-
-  int sum4 = avail[4];
-  int sum3 = avail[3] + sum4;
-  int sum2 = avail[2] + sum3;
-  int sum1 = avail[1] + sum2;
-
-  if (n > sum1) return 0;
-  // Make sure there are enough different denominations to select
-
-  // The idea here is that we will select
-  //
-  //    n = j1 + j2 + j3 + j4
-  //
-  // cards, where j1 is the number of singleton denominations chosen,
-  // j2 is the number of doubleton demominations chosen, and so on.
-  //
-  // For each quadruple (j1, j2, j3, j4), the number of ways to
-  // select the cards is
-  //
-  //  Count (j1, j2, j3, j4) =
-  //     choose (avail [1], j1) * 1**j1 *
-  //     choose (avail [2], j2) * 2**j2 *
-  //     choose (avail [3], j3) * 3**j3 *
-  //     choose (avail [4], j4) * 4**j4
-  //
-  // The first subterm counts the number of subsets of demoninations
-  // available, and the second counts the number of suit patterns
-  // available for that subset.
-  //
-  // We iterate over all possible values of (j1, j2, j3, j4) and
-  // sum up Count (j1, j2, j3, j4) for each.
-  //
-  // We find all possible values using four nested loops.
-  // Since j1 + j2 + j3 + j4 = n, j1 is bounded below by
-  // by n - avail[j2] - avail[j3] - avail[j4].  Likewise,
-  // j1 is bounded above by both avail[1] and n.  There are
-  // similar constraints at the next two nesting levels.
-  // In the innermost level, j4 is determined by the equation
-  // j4 = n - j3 - j2 - j1.
-
-  int result = 0;
-
-  int min1 = max_int(n - sum2, 0);
-  int max1 = min_int(avail[1], n);
-  for (int j1 = min1; j1 <= max1; j1++) {
-    int f1 = combin.choose(avail[1], j1);
-    n -= j1;
-
-    int min2 = max_int(n - sum3, 0);
-    int max2 = min_int(avail[2], n);
-    for (int j2 = min2; j2 <= max2; j2++) {
-      int f2 = combin.choose(avail[2], j2) * (1 << j2) * f1;
-      // (1<<j2) == 2**j2
-
-      n -= j2;
-
-      int min3 = max_int(n - sum4, 0);
-      int max3 = min_int(avail[3], n);
-      for (int j3 = min3; j3 <= max3; j3++) {
-        int power = 1;
-        for (int jj = 0; jj < j3; jj++) power *= 3;
-        // power == 3**j3
-
-        int f3 = combin.choose(avail[3], j3) * power * f2;
-
-        int j4 = n - j3;
-        _ASSERT(0 <= j4 && j4 <= avail[4]);
-
-        int f4 = combin.choose(avail[4], j4) * (1 << (2 * j4)) * f3;
-        // (1<<(2*j4)) == 4**j4
-
-        result += f4;
-      }
-
-      n += j2;
-    }
-
-    n += j1;
-  }
-
-  return result;
-}
-
-int denom_list::multi(int m, int n) {
-  _ASSERT(m >= 1);
-
-  if (m == 1) return no_pair(n);
-
-  int result = 0;
-
-  if (n >= m) {
-    for (int j = m; j <= 4; j++) {
-      if (avail[j] != 0) {
-        const int a = avail[j];
-        avail[j]--;
-        result += a * combin.choose(j, m) * no_pair(n - m);
-        avail[j]++;
-      }
-    }
+void merge_unpaid(pay_dist &pays, const pay_values &pay_table) {
+  // For combos with no payoff, move their pays into the next more
+  // general category.
+  if (pay_table[N_quad_aces_kicker] == 0.0) {
+    pays[N_quad_aces] += pays[N_quad_aces_kicker];
+    pays[N_quad_aces_kicker] = 0;
   }
-
-  return result;
-}
-
-int denom_list::one_pair(int n) {
-  if (n < 2) return 0;
-
-  int result = 0;
-
-  if (avail[2] != 0) {
-    int a = avail[2];
-    avail[2]--;
-    result += a * no_pair(n - 2);
-    avail[2]++;
+  if (pay_table[N_quad_aces] == 0.0) {
+    pays[N_quads] += pays[N_quad_aces];
+    pays[N_quad_aces] = 0;
   }
-
-  if (avail[3] != 0) {
-    int a = avail[3];
-    avail[3]--;
-    result += a * 3 * no_pair(n - 2);
-    avail[3]++;
+  if (pay_table[N_quad_low_kicker] == 0.0) {
+    pays[N_quad_low] += pays[N_quad_low_kicker];
+    pays[N_quad_low_kicker] = 0;
   }
-
-  if (avail[4] != 0) {
-    int a = avail[4];
-    avail[4]--;
-    result += a * 6 * no_pair(n - 2);
-    avail[4]++;
+  if (pay_table[N_quad_low] == 0.0) {
+    pays[N_quads] += pays[N_quad_low];
+    pays[N_quad_low] = 0;
   }
-
-  return result;
-}
-
-int denom_list::triple(int n) {
-  if (n < 3) return 0;
-
-  int result = 0;
-
-  if (avail[3] != 0) {
-    int a = avail[3];
-    avail[3]--;
-    result += a * no_pair(n - 3);
-    avail[3]++;
-  }
-
-  if (avail[4] != 0) {
-    int a = avail[4];
-    avail[4]--;
-    result += a * 4 * no_pair(n - 3);
-    avail[4]++;
-  }
-
-  return result;
-}
-
-int denom_list::quad(int n) {
-  if (n < 4) return 0;
-
-  int result = 0;
-
-  if (avail[4] != 0) {
-    int a = avail[4];
-    avail[4]--;
-    result += a * no_pair(n - 4);
-    avail[4]++;
-  }
-
-  return result;
-}
-
-int denom_list::two_pair(int n) {
-  if (n < 4) return 0;
-
-  int result = 0;
-
-  if (avail[2] >= 2) {
-    int a = avail[2];
-    avail[2] -= 2;
-    result += combin.choose(a, 2) * no_pair(n - 4);
-    avail[2] += 2;
-  }
-
-  if (avail[3] >= 2) {
-    int a = avail[3];
-    avail[3] -= 2;
-    result += combin.choose(a, 2) * (3 * 3) * no_pair(n - 4);
-    avail[3] += 2;
-  }
-
-  if (avail[4] >= 2) {
-    int a = avail[4];
-    avail[4] -= 2;
-    result += combin.choose(a, 2) * (6 * 6) * no_pair(n - 4);
-    avail[4] += 2;
-    ;
-  }
-
-  if (avail[2] > 0 && avail[3] > 0) {
-    int a = avail[2];
-    int b = avail[3];
-
-    avail[2]--;
-    avail[3]--;
-    result += a * b * 3 * no_pair(n - 4);
-    avail[2]++;
-    avail[3]++;
-  }
-
-  if (avail[2] > 0 && avail[4] > 0) {
-    int a = avail[2];
-    int b = avail[4];
-
-    avail[2]--;
-    avail[4]--;
-    result += a * b * 6 * no_pair(n - 4);
-    avail[2]++;
-    avail[4]++;
-  }
-
-  if (avail[3] > 0 && avail[4] > 0) {
-    int a = avail[3];
-    int b = avail[4];
-
-    avail[3]--;
-    avail[4]--;
-    result += a * b * (3 * 6) * no_pair(n - 4);
-    avail[3]++;
-    avail[4]++;
-  }
-
-  return result;
 }
 
-int denom_list::full_house(int n) {
-  if (n < 5) return 0;
-
-  int result = 0;
-
-  if (avail[3] >= 2) {
-    result += avail[3] * (avail[3] - 1) * 3;
-  }
-
-  if (avail[4] >= 2) {
-    result += avail[4] * (avail[4] - 1) * (4 * 6);
-  }
-
-  if (avail[2] > 0 && avail[3] > 0) {
-    result += avail[2] * avail[3];
-  }
+void C_kept_description::all_draws(int deuces_kept, C_left &left,
+                                   pay_dist &pays) {
+  instrument::count(instrument::all_draws_calls);
+  instrument::phase_timer timer(instrument::draw_counting);
+
+  if (parms.kind == GK_no_wild) {
+    unsigned kept[num_suits] = {};
+    for (int d = 0; d < num_denoms; d++) {
+      for (int s = 0; s < num_suits; s++) {
+        kept[s] |= ((have_suit[d] >> s) & 1u) << d;
+      }
+    }
 
-  if (avail[2] > 0 && avail[4] > 0) {
-    result += avail[2] * avail[4] * 4;
-  }
+    // The table draws from the whole deck less the five cards dealt,
+    // whatever left says.  Anything else takes the case analysis.
+    int cards_left = 0;
+    for (int s = 0; s < num_suits; s++) {
+      cards_left += left.suits[s];
+    }
+    bool dealt_only = cards_left == parms.deck_size - 5;
+    for (int j = 0; dealt_only && j < num_discards; j++) {
+      dealt_only = !left.cards[discards[j]];
+    }
+    for (int s = 0; dealt_only && s < num_suits; s++) {
+      for (unsigned m = kept[s]; dealt_only && m != 0; m &= m - 1) {
+        dealt_only = !left.available(std::countr_zero(m), s);
+      }
+    }
 
-  if (avail[3] > 0 && avail[4] > 0) {
-    result += avail[3] * avail[4] * ((3 * 4) + 6);
+    if (dealt_only) {
+      draw_table::get(parms.min_high_pair)
+          .draws(kept, discards, num_discards, pays);
+      merge_unpaid(pays, parms.pay_table);
+      return;
+    }
   }
 
-  return result;
+  count_draws(deuces_kept, left, pays);
 }
 
-// Define an object with a function parameter such that
-// the function gets called when the object is destroyed.
-template <typename F>
-struct ScopeGuard {
-  F f;
-  ~ScopeGuard() { f(); }
-  ScopeGuard(F f) : f(f) {}
-};
-
-void C_kept_description::all_draws(int deuces_kept, C_left &left,
-                                   pay_dist &pays) {
+void C_kept_description::count_draws(int deuces_kept, C_left &left,
+                                     pay_dist &pays) {
   {
     for (int j = first_pay; j <= last_pay; j++) {
       pays[j] = 0;
@@ -803,32 +686,20 @@ void C_kept_description::all_draws(int deuces_kept, C_left &left,
     // Runs before return. It would be more straightforward to simply
     // put this code at the end of the function, but this code handles
     // return statements correctly.
-    const pay_values &pay_table = parms.pay_table;
-
-    // For combos with no payoff, move their pays into the next more
-    // general category.
-    if (pay_table[N_quad_aces_kicker] == 0.0) {
-      pays[N_quad_aces] += pays[N_quad_aces_kicker];
-      pays[N_quad_aces_kicker] = 0;
-    }
-    if (pay_table[N_quad_aces] == 0.0) {
-      pays[N_quads] += pays[N_quad_aces];
-      pays[N_quad_aces] = 0;
-    }
-    if (pay_table[N_quad_low_kicker] == 0.0) {
-      pays[N_quad_low] += pays[N_quad_low_kicker];
-      pays[N_quad_low_kicker] = 0;
-    }
-    if (pay_table[N_quad_low] == 0.0) {
-      pays[N_quads] += pays[N_quad_low];
-      pays[N_quad_low] = 0;
-    }
+    merge_unpaid(pays, parms.pay_table);
   });
 
   const int all_multiples = multi[2] + multi[3] + multi[4];
 
   const int cards_to_draw = num_discards + (num_jokers - deuces_kept);
 
+  // The cards there are to draw from.  That is usually the deck less
+  // the five dealt, but all_draws comes here when more are gone.
+  int cards_left = left.jokers;
+  for (int s = 0; s < num_suits; s++) {
+    cards_left += left.suits[s];
+  }
+
   denom_list any_kept(left.denoms);
   // This is the list of cards available to be drawn
   // that will make a pair (or trip or quad) with a
@@ -1200,17 +1071,27 @@ void C_kept_description::all_draws(int deuces_kept, C_left &left,
             }
           }
 
-          // Draw three to make quads
-          // _ASSERT(jokers == 0);
+          // Draw three to make quads.  With wild cards, draw fewer
+          // to match, and the kicker doesn't matter: no game with
+          // wild cards pays the special quads.
 
-          switch (multi[1]) {
+          if (jokers > 0) {
+            int match = 3 - jokers;
+
+            // With three wild cards the hand is already quads;
+            // that is counted with the new quads below.
+            if (must_draw >= match && match > 0) {
+              combos[N_quads] += any_kept.multi(match, match) *
+                                 not_kept.no_pair(must_draw - match);
+            }
+          } else switch (multi[1]) {
             case 1:
               // Holding one card.
               // Draw the other three plus a kicker
               {
                 const int d = m_denom[1];
                 if (left.denoms[d] == 3) {
-                  const int kickers = parms.deck_size - 5 - 3;
+                  const int kickers = cards_left - 3 - left.jokers;
 
                   int low_kickers = 0;
                   if (d != ace) low_kickers += left.denoms[ace];
@@ -1307,16 +1188,16 @@ void C_kept_description::all_draws(int deuces_kept, C_left &left,
           }
           combos[N_quints] += not_kept.multi(5 - jokers, must_draw);
 
-          // _ASSERT(jokers == 0);
-
-          switch (multi[1]) {
+          if (jokers > 0) {
+            combos[N_quads] += not_kept.multi(4 - jokers, must_draw);
+          } else switch (multi[1]) {
             case 0:
               // Holding no cards.
               // Draw draw four plus a kicker
               {
                 for (int d = 0; d < num_denoms; d++) {
                   if (left.denoms[d] == 4) {
-                    const int kickers = parms.deck_size - 5 - 4;
+                    const int kickers = cards_left - 4 - left.jokers;
 
                     int low_kickers = 0;
                     if (d != ace) low_kickers += left.denoms[ace];
@@ -1426,7 +1307,7 @@ void C_kept_description::all_draws(int deuces_kept, C_left &left,
                 switch (multi[1]) {
                   case 0:
                     kickers =
-                        parms.deck_size - 5 - left.denoms[d] - left.jokers;
+                        cards_left - left.denoms[d] - left.jokers;
 
                     if (d != ace) low_kickers += left.denoms[ace];
                     if (d != deuce) low_kickers += left.denoms[deuce];
@@ -1486,7 +1367,7 @@ void C_kept_description::all_draws(int deuces_kept, C_left &left,
 
     if (jokers == 4) {
       combos[N_four_deuces] +=
-          combin.choose(parms.deck_size - 5 - jokers_drawn, must_draw);
+          combin.choose(cards_left - jokers_drawn, must_draw);
     }
 
     // Count all the ways of making a straight
@@ -2822,12 +2703,17 @@ void C_kept_description::all_draws(int deuces_kept, C_left &left,
       switch (deuces_kept) {
         case 0:
           // We kept none but drew one.
-          _ASSERT(joker_factor == 2);
-
-          // We have added into pays all four combinations of
-          // the suited royals and the wild jacks.  On each
-          // of the royal combinations must be promoted.
-          promote_wild_royals += royals[1];
+          if (joker_factor == 2) {
+            // We have added into pays all four combinations of
+            // the suited royals and the wild jacks.  On each
+            // of the royal combinations must be promoted.
+            promote_wild_royals += royals[1];
+          } else {
+            // We were dealt a jack and threw it away.  As below, it
+            // is deemed to be suit zero, so the one left is suit one.
+            _ASSERT(joker_factor == 1);
+            promote_wild_royals = royals[1];
+          }
           break;
 
         case 1:
@@ -2863,7 +2749,7 @@ void C_kept_description::all_draws(int deuces_kept, C_left &left,
     // in pays.
 
     {
-      const int correct = combin.choose(parms.deck_size - 5, cards_to_draw);
+      const int correct = combin.choose(cards_left, cards_to_draw);
 
       if (total_pays != correct) {
         _ASSERT(0);
@@ -34,6 +34,11 @@ class C_left {
 
 typedef int pay_dist[last_pay + 1];
 
+void merge_unpaid(pay_dist &pays, const pay_values &pay_table);
+// Moves the counts of the special quads (aces, 2-4, with or without
+// kickers) that pay nothing into the next more general category.
+// all_draws does this before returning.
+
 typedef class C_kept_description {
  private:
   int num_jokers;
@@ -103,6 +108,13 @@ typedef class C_kept_description {
 
   game_parameters &parms;
 
+  void set_reach(int *endpoint, int end_index);
+  // Sets min_denom, reach, have_ace, min_non_ace and max_non_ace
+  // from the lowest, second lowest and highest denominations kept.
+  // end_index is one less than the number of those that are known.
+
+  friend class kept_builder;
+
  public:
   C_kept_description(const card *hand, int hand_size, unsigned mask,
                      game_parameters &parms);
@@ -124,6 +136,11 @@ typedef class C_kept_description {
   // The discards consist of the cards that are not described
   // by kept, deuces_kept, or left.
 
+  // For games without wild cards the counts come from draw_table.
+
+  void count_draws(int deuces_kept, C_left &left, pay_dist &pays);
+  // Same as all_draws, always by case analysis.
+
   payoff_name name();
 
   #if 0
@@ -136,3 +153,47 @@ typedef class C_kept_description {
   std::string move_name();
 
 } kept_description;
+
+// Builds the kept_description of every subset of a hand, one after
+// another.  The subsets are visited in Gray code order, so each one
+// differs from the previous one by a single card, and the description
+// is updated for that card rather than built from scratch.
+// The result for each mask is the same as constructing
+// kept_description(hand, hand_size, mask, parms).
+// The cards of the hand must be sorted by denomination.
+class kept_builder {
+ public:
+  kept_builder(const card *hand, int hand_size, game_parameters &parms);
+
+  // Starts with mask zero (nothing kept).
+  unsigned mask() const { return mask_; }
+  kept_description &current() { return kept_; }
+
+  // Moves to the next subset.  Returns false, and changes nothing,
+  // once all 2^hand_size of them have been visited.
+  bool next();
+
+ private:
+  void toggle(int index);
+  void finish();
+
+  card hand_[5] = {};
+  int hand_size_;
+  unsigned mask_ = 0;
+  unsigned step_ = 0;
+
+  int groups_ = 0;
+  int group_denom_[5];
+  int group_count_[5];
+  int card_group_[5];
+  unsigned kept_groups_ = 0;
+  // The runs of cards of the same denomination, how many of each
+  // are kept, which run each card of the hand belongs to, and which
+  // runs have any cards kept.
+
+  int suit_count_[num_suits] = {};
+  unsigned suit_bits_[num_suits] = {};
+  // The number of kept cards of each suit, and which they are
+
+  kept_description kept_;
+};
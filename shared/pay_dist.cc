@@ -1,11 +1,15 @@
 #include "pay_dist.h"
 
 #include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cmath>
+#include <complex>
+#include <cstdint>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <numbers>
 #include <numeric>
 #include <stdexcept>
 
@@ -46,6 +50,7 @@ void PayDistribution::scale(double prob) {
     pp.probability *= prob;
   }
   cutoff_prob_ *= prob;
+  error_bound_ *= prob;
 }
 
 void PayDistribution::normalize() {
@@ -77,33 +82,265 @@ void PayDistribution::normalize() {
   }
 }
 
+namespace {
+using convolution = PayDistribution::convolution;
+
+// succession uses the sparse convolution when fewer than one in this
+// many payoffs of the result would have a probability.
+const double sparse_ratio = 8.0;
+
+// Sums the probabilities of each payoff, which must be sorted, and
+// drops the payoffs that have none.
+void combine_sorted(const std::vector<ProbPay> &sorted,
+                    std::vector<ProbPay> &result) {
+  for (std::size_t i = 0; i < sorted.size();) {
+    const int pay = sorted[i].payoff;
+    double prob = 0.0;
+    for (; i < sorted.size() && sorted[i].payoff == pay; ++i) {
+      prob += sorted[i].probability;
+    }
+    if (prob > 0.0) {
+      result.emplace_back(prob, pay);
+    }
+  }
+}
+
+// Replaces z with its discrete Fourier transform, or with N times its
+// inverse.  The size of z must be a power of two.
+void fft(std::vector<std::complex<double>> &z, bool inverse) {
+  const std::size_t n = z.size();
+
+  for (std::size_t i = 1, j = 0; i < n; ++i) {
+    std::size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      std::swap(z[i], z[j]);
+    }
+  }
+
+  // Each root of unity is computed directly, rather than as a power of
+  // another, so that its error is a rounding error.
+  std::vector<std::complex<double>> roots(n / 2);
+  const double sign = inverse ? 2.0 : -2.0;
+  for (std::size_t k = 0; k < n / 2; ++k) {
+    roots[k] = std::polar(1.0, sign * std::numbers::pi *
+                                   static_cast<double>(k) /
+                                   static_cast<double>(n));
+  }
+
+  for (std::size_t len = 2; len <= n; len <<= 1) {
+    const std::size_t half = len / 2;
+    const std::size_t step = n / len;
+    for (std::size_t i = 0; i < n; i += len) {
+      for (std::size_t j = 0; j < half; ++j) {
+        const std::complex<double> u = z[i + j];
+        const std::complex<double> v = z[i + j + half] * roots[j * step];
+        z[i + j] = u + v;
+        z[i + j + half] = u - v;
+      }
+    }
+  }
+}
+
+// The convolution of a and b, computed with one forward and one
+// inverse transform of size n by packing b into the imaginary part.
+// Sets bound to a bound on the error of any element of the result.
+std::vector<double> fft_convolve(const std::vector<double> &a,
+                                 const std::vector<double> &b, double &bound) {
+  std::size_t n = 1;
+  int log_n = 0;
+  while (n < a.size() + b.size() - 1) {
+    n *= 2;
+    log_n += 1;
+  }
+
+  std::vector<std::complex<double>> z(n);
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    z[i].real(a[i]);
+  }
+  for (std::size_t i = 0; i < b.size(); ++i) {
+    z[i].imag(b[i]);
+  }
+  fft(z, false);
+
+  // With Z the transform of a + ib and Y[k] the conjugate of Z[-k],
+  // the transform of the convolution is (Z^2 - Y^2) / 4i.
+  std::vector<std::complex<double>> product(n);
+  for (std::size_t k = 0; k < n; ++k) {
+    const std::complex<double> y = std::conj(z[(n - k) & (n - 1)]);
+    product[k] = (z[k] * z[k] - y * y) * std::complex<double>(0.0, -0.25);
+  }
+  fft(product, true);
+
+  std::vector<double> result(a.size() + b.size() - 1);
+  for (std::size_t i = 0; i < result.size(); ++i) {
+    result[i] = product[i].real() / static_cast<double>(n);
+  }
+
+  // Each transform of size n has a relative error (in the 2-norm) of at
+  // most log2(n) * eta, where eta is about 7 units of roundoff when the
+  // roots of unity are correctly rounded (Higham, Accuracy and Stability
+  // of Numerical Algorithms, section 24.1).  Following the error through
+  // the two transforms, the product, and the unpacking bounds the error
+  // of every element by a small multiple of that, times the sums of a
+  // and b.
+  const double eta = 7.0 * std::numeric_limits<double>::epsilon() / 2;
+  const double sum_a = std::accumulate(a.begin(), a.end(), 0.0);
+  const double sum_b = std::accumulate(b.begin(), b.end(), 0.0);
+  bound = 6.0 * (log_n + 1) * eta * sum_a * sum_b;
+  return result;
+}
+
+// The probabilities of the payoffs of dist from low to high.
+std::vector<double> dense_probabilities(const std::vector<ProbPay> &dist,
+                                        int low, int high) {
+  std::vector<double> result(high - low + 1);
+  for (const auto [prob, pay] : dist) {
+    result[pay - low] += prob;
+  }
+  return result;
+}
+
+std::pair<int, int> payoff_range(const std::vector<ProbPay> &dist) {
+  const auto [low, high] = std::minmax_element(
+      dist.begin(), dist.end(), [](const ProbPay &x, const ProbPay &y) {
+        return x.payoff < y.payoff;
+      });
+  return {low->payoff, high->payoff};
+}
+}  // namespace
+
 PayDistribution succession(const PayDistribution &first,
                            const PayDistribution &second) {
+  return succession(first, second, convolution::automatic);
+}
+
+PayDistribution succession(const PayDistribution &first,
+                           const PayDistribution &second,
+                           convolution method) {
   PayDistribution result;
   assert(first.cutoff_ == second.cutoff_);
   result.cutoff_ = first.cutoff_;
+  result.error_bound_ = first.error_bound_ + second.error_bound_;
 
   // The probability that that either first or second is past
   // the cutoff_. Then the result is past the cutoff_.
   result.cutoff_prob_ = first.cutoff_prob_ + second.cutoff_prob_ -
                         first.cutoff_prob_ * second.cutoff_prob_;
 
+  if (first.dist_.empty() || second.dist_.empty()) {
+    return result;
+  }
+
   // Now examine all the cases where both distributions are less
-  // than their respective cutoffs.
-  result.dist_.reserve(first.dist_.size() * second.dist_.size());
-  for (const ProbPay &f : first.dist_) {
-    for (const ProbPay &s : second.dist_) {
-      const double prob = f.probability * s.probability;
-      const int pay = f.payoff + s.payoff;
-      if (pay >= result.cutoff_) {
-        result.cutoff_prob_ += prob;
-      } else {
-        result.dist_.emplace_back(prob, pay);
+  // than their respective cutoffs.  The payoffs of the result that
+  // are less than the cutoff go from low to high.
+  const auto [first_low, first_high] = payoff_range(first.dist_);
+  const auto [second_low, second_high] = payoff_range(second.dist_);
+  const int low = first_low + second_low;
+  const int high = static_cast<int>(
+      std::min<std::int64_t>(std::int64_t{first_high} + second_high,
+                             std::int64_t{result.cutoff_} - 1));
+
+  const double pairs = static_cast<double>(first.dist_.size()) *
+                       static_cast<double>(second.dist_.size());
+  const double range = static_cast<double>(high) - low + 1;
+
+  if (method == convolution::automatic) {
+    method = range < 1 || range > sparse_ratio * pairs ? convolution::sparse
+                                                       : convolution::dense;
+  }
+
+  switch (method) {
+    case convolution::automatic:
+    case convolution::dense: {
+      std::vector<double> table(
+          static_cast<std::size_t>(std::max(0.0, range)));
+      for (const ProbPay &f : first.dist_) {
+        for (const ProbPay &s : second.dist_) {
+          const double prob = f.probability * s.probability;
+          const int pay = f.payoff + s.payoff;
+          if (pay >= result.cutoff_) {
+            result.cutoff_prob_ += prob;
+          } else {
+            table[pay - low] += prob;
+          }
+        }
+      }
+      for (std::size_t i = 0; i < table.size(); ++i) {
+        if (table[i] > 0.0) {
+          result.dist_.emplace_back(table[i], low + static_cast<int>(i));
+        }
+      }
+      break;
+    }
+
+    case convolution::sparse: {
+      std::vector<ProbPay> products;
+      products.reserve(first.dist_.size() * second.dist_.size());
+      for (const ProbPay &f : first.dist_) {
+        for (const ProbPay &s : second.dist_) {
+          const double prob = f.probability * s.probability;
+          const int pay = f.payoff + s.payoff;
+          if (pay >= result.cutoff_) {
+            result.cutoff_prob_ += prob;
+          } else {
+            products.emplace_back(prob, pay);
+          }
+        }
+      }
+
+      // Stable, so that each payoff adds up its probabilities in the
+      // same order as the dense convolution does.
+      std::stable_sort(products.begin(), products.end(),
+                       [](const ProbPay &x, const ProbPay &y) {
+                         return x.payoff < y.payoff;
+                       });
+      combine_sorted(products, result.dist_);
+      break;
+    }
+
+    case convolution::fft: {
+      // The part of the result past the cutoff comes from sums of the
+      // second distribution's tails, rather than from the transform.
+      std::vector<ProbPay> sorted_second = second.dist_;
+      std::sort(sorted_second.begin(), sorted_second.end(),
+                [](const ProbPay &x, const ProbPay &y) {
+                  return x.payoff < y.payoff;
+                });
+      std::vector<double> tail(sorted_second.size() + 1);
+      for (std::size_t i = sorted_second.size(); i-- > 0;) {
+        tail[i] = tail[i + 1] + sorted_second[i].probability;
+      }
+      for (const ProbPay &f : first.dist_) {
+        const auto past = std::lower_bound(
+            sorted_second.begin(), sorted_second.end(),
+            static_cast<std::int64_t>(result.cutoff_) - f.payoff,
+            [](const ProbPay &s, std::int64_t pay) { return s.payoff < pay; });
+        result.cutoff_prob_ +=
+            f.probability * tail[past - sorted_second.begin()];
+      }
+
+      double bound;
+      const std::vector<double> sums = fft_convolve(
+          dense_probabilities(first.dist_, first_low, first_high),
+          dense_probabilities(second.dist_, second_low, second_high), bound);
+      result.error_bound_ += bound;
+
+      // Payoffs that can't be told from zero are dropped.
+      for (int pay = low; pay <= high; ++pay) {
+        const double prob = sums[pay - low];
+        if (prob > bound) {
+          result.dist_.emplace_back(prob, pay);
+        }
       }
+      break;
     }
   }
 
-  result.normalize();
   return result;
 }
 
@@ -141,6 +378,7 @@ PayDistribution merge(const PayDistribution &first,
   PayDistribution result;
   result.cutoff_ = std::min(first.cutoff_, second.cutoff_);
   result.cutoff_prob_ = first.cutoff_prob_ + second.cutoff_prob_;
+  result.error_bound_ = first.error_bound_ + second.error_bound_;
 
   result.dist_.reserve(first.dist_.size() + second.dist_.size());
   auto it1 = first.dist_.begin(), it2 = second.dist_.begin();
@@ -171,3 +409,50 @@ PayDistribution merge(const PayDistribution &first,
 
   return result;
 }
+
+void PayAccumulator::add(const PayDistribution &dist, double prob) {
+  assert(dist.cutoff_ >= cutoff_);
+  cutoff_prob_ += dist.cutoff_prob_ * prob;
+  error_bound_ += dist.error_bound_ * prob;
+  for (const auto [p, pay] : dist.dist_) {
+    assert(pay >= 0);
+    if (pay >= cutoff_) {
+      cutoff_prob_ += p * prob;
+    } else {
+      if (static_cast<std::size_t>(pay) >= probs_.size()) {
+        probs_.resize(pay + 1);
+      }
+      probs_[pay] += p * prob;
+    }
+  }
+}
+
+PayDistribution PayAccumulator::total() const {
+  PayDistribution result;
+  result.cutoff_ = cutoff_;
+  result.cutoff_prob_ = cutoff_prob_;
+  result.error_bound_ = error_bound_;
+  for (std::size_t pay = 0; pay < probs_.size(); ++pay) {
+    if (probs_[pay] > 0.0) {
+      result.dist_.emplace_back(probs_[pay], static_cast<int>(pay));
+    }
+  }
+  return result;
+}
+
+std::size_t RepeatCache::hash::operator()(const PayDistribution &dist) const {
+  std::size_t result = std::hash<int>()(dist.cutoff());
+  for (const auto [prob, pay] : dist.distribution()) {
+    result = result * 31 + std::hash<int>()(pay);
+    result = result * 31 + std::bit_cast<std::uint64_t>(prob);
+  }
+  return result;
+}
+
+const PayDistribution &RepeatCache::repeat(const PayDistribution &wager) {
+  auto it = cache_.find(wager);
+  if (it == cache_.end()) {
+    it = cache_.emplace(wager, ::repeat(wager, n_)).first;
+  }
+  return it->second;
+}
@@ -1,4 +1,6 @@
+#include <cstddef>
 #include <limits>
+#include <unordered_map>
 #include <vector>
 
 struct ProbPay {
@@ -40,6 +42,10 @@ class PayDistribution {
   void set_cutoff(int cutoff) { cutoff_ = cutoff; }
   double cutoff_prob() const { return cutoff_prob_; }
 
+  // A bound on the error in any one probability, which is zero unless
+  // the distribution was computed with the fft convolution.
+  double error_bound() const { return error_bound_; }
+
   // Returns the expected value of the distribution.
   // If there are cutoff values, the result is only an approximation.
   double expected() const;
@@ -55,10 +61,25 @@ class PayDistribution {
   // Multiply all the probabilities by prob.
   void scale(double prob);
 
+  // The ways succession can add two independent payoffs.
+  //   dense:  accumulates the products into an array indexed by payoff.
+  //   sparse: sorts the products by payoff, for payoffs far apart.
+  //   fft:    multiplies discrete Fourier transforms, which is much
+  //           faster for large distributions, but not exact: it drops
+  //           payoffs whose probability is within error_bound() of
+  //           zero.
+  // automatic chooses between dense and sparse by how full the range of
+  // payoffs is, so it stays exact; the fft is only used when asked for.
+  // dense and sparse give the same results, bit for bit.
+  enum class convolution { automatic, dense, sparse, fft };
+
   // The aggregate pay distribution of making the first wager and then
   // (independently) making the second one.
   friend PayDistribution succession(const PayDistribution &first,
                                     const PayDistribution &second);
+  friend PayDistribution succession(const PayDistribution &first,
+                                    const PayDistribution &second,
+                                    convolution method);
 
   // The pay distribution of repeating a wager n independent times.
   friend PayDistribution repeat(const PayDistribution &wager, unsigned int n);
@@ -68,6 +89,8 @@ class PayDistribution {
   friend PayDistribution merge(const PayDistribution &first,
                                const PayDistribution &second);
 
+  friend class PayAccumulator;
+
  private:
   // Don't keep details past cutoff.
   int cutoff_;
@@ -77,4 +100,52 @@ class PayDistribution {
 
   // The probability of payoffs less than cutoff.
   std::vector<ProbPay> dist_;
+
+  double error_bound_ = 0.0;
+};
+
+// Adds up scaled distributions in place, as when totalling the pay
+// distributions of all the starting hands.  Keeps a probability for
+// each payoff less than the cutoff, so unlike a chain of merges it
+// doesn't allocate a new distribution for each one added.
+class PayAccumulator {
+ public:
+  explicit PayAccumulator(int cutoff) : cutoff_(cutoff) {}
+
+  // Adds the distribution dist, with its probabilities multiplied
+  // by prob.  Its cutoff can't be less than the accumulator's.
+  void add(const PayDistribution &dist, double prob);
+
+  // The sum of everything added so far.
+  PayDistribution total() const;
+
+ private:
+  int cutoff_;
+  double cutoff_prob_ = 0.0;
+  double error_bound_ = 0.0;
+
+  // Indexed by payoff, up to the highest one added so far.
+  std::vector<double> probs_;
+};
+
+// Memoizes repeat(wager, n) for a fixed n.  Most starting hands have
+// the same few distributions of draws, so each of those is only
+// repeated once.
+class RepeatCache {
+ public:
+  explicit RepeatCache(unsigned int n) : n_(n) {}
+
+  // The result is valid as long as the cache is.
+  const PayDistribution &repeat(const PayDistribution &wager);
+
+  // The number of different wagers that have been repeated.
+  std::size_t size() const { return cache_.size(); }
+
+ private:
+  struct hash {
+    std::size_t operator()(const PayDistribution &dist) const;
+  };
+
+  unsigned int n_;
+  std::unordered_map<PayDistribution, PayDistribution, hash> cache_;
 };
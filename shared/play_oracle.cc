@@ -0,0 +1,123 @@
+#include "play_oracle.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "eval_game.h"
+#include "kept.h"
+#include "workers.h"
+
+// The entries of the cache go from empty, to being written by the one
+// thread that won the right to, to ready.  A thread that finds a class
+// empty or being written evaluates it itself rather than wait, so
+// readers never block.
+namespace {
+const std::uint8_t entry_empty = 0;
+const std::uint8_t entry_writing = 1;
+const std::uint8_t entry_ready = 2;
+
+// The number of hands of a batch each thread takes at a time.
+const std::size_t batch_unit = 64;
+}  // namespace
+
+struct play_oracle::scratch {
+  game_parameters parms;
+  C_left left;
+  double values[hold_table::max_rows];
+
+  explicit scratch(const game_parameters &p) : parms(p), left(parms) {}
+};
+
+play_oracle::play_oracle(const game_parameters &parms)
+    : parms_(parms),
+      table_(hand_table::open(parms.kind)),
+      classifier_(parms_, *table_) {
+  for (int wild_cards = 0; wild_cards <= table_->max_wild_cards();
+       wild_cards++) {
+    entries_[wild_cards] =
+        std::make_unique<entry[]>(table_->hands(wild_cards).size());
+  }
+}
+
+const double *play_oracle::evaluate(int wild_cards, unsigned hand,
+                                    scratch &s) const {
+  entry &e = entries_[wild_cards][hand];
+  if (e.state.load(std::memory_order_acquire) == entry_ready) {
+    return e.values;
+  }
+
+  const hand_record &r = table_->hands(wild_cards)[hand];
+  const int hand_size = 5 - wild_cards;
+  const hand_classifier::sorted_hand h =
+      classifier_.sort(r.cards, hand_size, wild_cards);
+
+  hold_table holds;
+  find_holds(r.cards, wild_cards, s.left, s.parms, holds);
+
+  double values[hold_table::max_rows];
+  score_holds(holds, s.parms.pay_table, values);
+
+  // The rows of holds follow the order of the cards of the record,
+  // which need not be the canonical order.
+  for (unsigned mask = 0; mask < (1u << hand_size); mask++) {
+    const unsigned row =
+        hand_classifier::canonical_mask(h, mask) * (wild_cards + 1);
+    for (int keep = 0; keep <= wild_cards; keep++) {
+      s.values[row + keep] = values[mask * (wild_cards + 1) + keep];
+    }
+  }
+
+  std::uint8_t expected = entry_empty;
+  if (e.state.compare_exchange_strong(expected, entry_writing,
+                                      std::memory_order_relaxed)) {
+    std::copy(s.values, s.values + holds.rows, e.values);
+    e.state.store(entry_ready, std::memory_order_release);
+    evaluated_++;
+  }
+  return s.values;
+}
+
+play_oracle::answer play_oracle::query(const card *hand, scratch &s) const {
+  const hand_classifier::sorted_hand h = classifier_.sort(hand);
+  const double *values = evaluate(h.wild_cards, classifier_.find(h), s);
+
+  answer a;
+  a.best = 0;
+  double best_value = 0.0;
+  for (unsigned play = 0; play < 32; play++) {
+    const unsigned row =
+        hand_classifier::canonical_mask(h, play & ~h.wild_mask) *
+            (h.wild_cards + 1) +
+        std::popcount(play & h.wild_mask);
+    const double value = values[row];
+    a.values[play] = value;
+
+    if (a.best == 0 || value > best_value) {
+      a.best = 1u << play;
+      best_value = value;
+    } else if (value == best_value) {
+      a.best |= 1u << play;
+    }
+  }
+  a.play = static_cast<std::uint8_t>(std::countr_zero(a.best));
+  return a;
+}
+
+play_oracle::answer play_oracle::query(const card *hand) const {
+  scratch s(parms_);
+  return query(hand, s);
+}
+
+void play_oracle::query(const card *hands, std::size_t count,
+                        answer *answers, unsigned threads) const {
+  const std::size_t units = (count + batch_unit - 1) / batch_unit;
+  run_workers(
+      units, worker_threads(threads, units),
+      [this]() { return scratch(parms_); },
+      [&](scratch &s, std::size_t u) {
+        const std::size_t end = std::min(count, (u + 1) * batch_unit);
+        for (std::size_t j = u * batch_unit; j < end; j++) {
+          answers[j] = query(hands + 5 * j, s);
+        }
+      });
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "game.h"
+#include "hand_class.h"
+#include "hand_table.h"
+#include "hold_kernel.h"
+#include "vpoker.h"
+
+// Answers "what is the value of every way of playing this hand" for
+// dealt hands, by evaluating the canonical hand of its class the first
+// time the class is asked about, and remembering the values of its
+// plays.  Queries may be made from any number of threads at once.
+class play_oracle {
+ public:
+  explicit play_oracle(const game_parameters &parms);
+
+  // Bit j of a play is set when the play keeps hand[j], wild or not.
+  struct answer {
+    double values[32];   // The expected value of every play
+    std::uint32_t best;  // Bit m is set for every play m of highest value
+    std::uint8_t play;   // The lowest numbered play in best
+  };
+
+  answer query(const card *hand) const;
+
+  // Answers count hands, hands[5 * j] to hands[5 * j + 4] being hand j,
+  // spread over the given number of threads.  Zero means one thread per
+  // hardware core.
+  void query(const card *hands, std::size_t count, answer *answers,
+             unsigned threads = 0) const;
+
+  // The number of classes evaluated so far.
+  std::size_t classes_evaluated() const { return evaluated_; }
+
+ private:
+  // What each thread needs to evaluate a class.
+  struct scratch;
+
+  // The values of the plays of a canonical hand, rows as in
+  // find_holds with the masks in the canonical order of the
+  // hand_classifier.
+  struct entry {
+    std::atomic<std::uint8_t> state{0};
+    double values[hold_table::max_rows];
+  };
+
+  answer query(const card *hand, scratch &s) const;
+  // The values of the plays of a class, which are in the cache or in
+  // s.values.
+  const double *evaluate(int wild_cards, unsigned hand, scratch &s) const;
+
+  game_parameters parms_;
+  std::unique_ptr<hand_table> table_;
+  hand_classifier classifier_;
+  std::unique_ptr<entry[]> entries_[5];
+  mutable std::atomic<std::size_t> evaluated_{0};
+};
@@ -0,0 +1,193 @@
+#include "session_sim.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <map>
+
+#include "workers.h"
+
+alias_table::alias_table(const vp_game &game, const pay_prob &prob_pays) {
+  std::map<int, double> merged;
+  double total = 0.0;
+  for (int j = first_pay; j <= last_pay; j++) {
+    if (prob_pays[j] > 0.0) {
+      merged[(*game.pay_table)[j]] += prob_pays[j];
+      total += prob_pays[j];
+    }
+  }
+  assert(total > 0.0);
+
+  // Vose's method: each column starts with its own payoff, scaled so
+  // that a full column is 1.  Columns short of 1 are topped up from
+  // the columns over 1, which become the alias.
+  const std::size_t n = merged.size();
+  std::vector<int> pays;
+  std::vector<double> scaled;
+  for (const auto &[pay, prob] : merged) {
+    pays.push_back(pay);
+    scaled.push_back(prob / total * n);
+  }
+
+  std::vector<std::size_t> small, large;
+  for (std::size_t j = 0; j < n; j++) {
+    (scaled[j] < 1.0 ? small : large).push_back(j);
+  }
+
+  constexpr double full = 4294967296.0;  // 2^32
+  columns_.resize(n);
+  while (!small.empty() && !large.empty()) {
+    const std::size_t s = small.back();
+    const std::size_t l = large.back();
+    small.pop_back();
+    columns_[s] = {static_cast<std::uint64_t>(scaled[s] * full), pays[s],
+                   pays[l]};
+    scaled[l] -= 1.0 - scaled[s];
+    if (scaled[l] < 1.0) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+
+  // Whatever is left is full up to rounding.
+  for (const std::size_t j : small) {
+    columns_[j] = {static_cast<std::uint64_t>(full), pays[j], pays[j]};
+  }
+  for (const std::size_t j : large) {
+    columns_[j] = {static_cast<std::uint64_t>(full), pays[j], pays[j]};
+  }
+}
+
+double session_results::mean_error() const {
+  return sessions == 0 ? 0.0
+                       : 1.96 * std::sqrt(variance / static_cast<double>(
+                                                         sessions));
+}
+
+double session_results::ahead_error() const {
+  if (sessions == 0) {
+    return 0.0;
+  }
+  const double p = static_cast<double>(ahead) / sessions;
+  return 1.96 * std::sqrt(p * (1.0 - p) / sessions);
+}
+
+double session_results::games_per_second() const {
+  return seconds > 0.0 ? static_cast<double>(sessions) * games / seconds
+                       : 0.0;
+}
+
+session_results simulate_sessions(const vp_game &game,
+                                  const pay_prob &prob_pays,
+                                  const session_options &options) {
+  const auto start_time = std::chrono::steady_clock::now();
+  const alias_table table(game, prob_pays);
+
+  // The mean and variance of the net win of one game.
+  double total = 0.0, mean = 0.0, square = 0.0;
+  int max_pay = 0;
+  for (int j = first_pay; j <= last_pay; j++) {
+    const int pay = (*game.pay_table)[j];
+    if (prob_pays[j] > 0.0) {
+      total += prob_pays[j];
+      mean += prob_pays[j] * (pay - 1);
+      square += prob_pays[j] * (pay - 1) * (pay - 1);
+      max_pay = std::max(max_pay, pay);
+    }
+  }
+  mean /= total;
+  const double variance = square / total - mean * mean;
+
+  session_results results;
+  results.sessions = options.sessions;
+  results.games = options.games;
+
+  const auto games = static_cast<std::int64_t>(options.games);
+  const double expected = mean * games;
+  const double spread = 8.0 * std::sqrt(std::max(variance, 0.0) * games);
+  results.low = std::max(-games, static_cast<std::int64_t>(
+                                     std::floor(expected - spread)));
+  const std::int64_t high =
+      std::min(games * (max_pay - 1),
+               static_cast<std::int64_t>(std::ceil(expected + spread)));
+  std::vector<std::atomic<std::uint64_t>> bins(high - results.low + 1);
+  std::atomic<std::uint64_t> under = 0, over = 0;
+
+  // Each chunk of sessions keeps its own totals, added up in order at
+  // the end, so the results don't depend on which thread ran it.
+  struct chunk_totals {
+    std::int64_t sum = 0;
+    double squares = 0.0;  // of the difference from expected
+    std::int64_t min_win = std::numeric_limits<std::int64_t>::max();
+    std::int64_t max_win = std::numeric_limits<std::int64_t>::min();
+    std::uint64_t ahead = 0;
+  };
+  constexpr std::size_t chunk = 256;
+  const std::size_t chunks = (options.sessions + chunk - 1) / chunk;
+  std::vector<chunk_totals> totals(chunks);
+
+  run_workers(
+      chunks, worker_threads(options.threads, chunks), [] { return 0; },
+      [&](int, std::size_t c) {
+        chunk_totals &t = totals[c];
+        const std::size_t end = std::min(options.sessions, (c + 1) * chunk);
+        for (std::size_t s = c * chunk; s < end; s++) {
+          counter_rng rng(options.seed, s);
+          std::int64_t win = -games;
+          for (std::int64_t g = 0; g < games; g++) {
+            win += table.sample(rng());
+          }
+
+          t.sum += win;
+          t.squares += (win - expected) * (win - expected);
+          t.min_win = std::min(t.min_win, win);
+          t.max_win = std::max(t.max_win, win);
+          t.ahead += win > 0;
+          if (win < results.low) {
+            under.fetch_add(1, std::memory_order_relaxed);
+          } else if (win > high) {
+            over.fetch_add(1, std::memory_order_relaxed);
+          } else {
+            bins[win - results.low].fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      });
+
+  std::int64_t sum = 0;
+  double squares = 0.0;
+  results.min_win = std::numeric_limits<std::int64_t>::max();
+  results.max_win = std::numeric_limits<std::int64_t>::min();
+  for (const chunk_totals &t : totals) {
+    sum += t.sum;
+    squares += t.squares;
+    results.min_win = std::min(results.min_win, t.min_win);
+    results.max_win = std::max(results.max_win, t.max_win);
+    results.ahead += t.ahead;
+  }
+
+  results.histogram.reserve(bins.size());
+  for (const auto &bin : bins) {
+    results.histogram.push_back(bin.load(std::memory_order_relaxed));
+  }
+  results.under = under;
+  results.over = over;
+
+  const double n = static_cast<double>(options.sessions);
+  if (options.sessions > 0) {
+    results.mean = sum / n;
+    const double offset = results.mean - expected;
+    results.variance = options.sessions > 1
+                           ? (squares - n * offset * offset) / (n - 1.0)
+                           : 0.0;
+  } else {
+    results.min_win = results.max_win = 0;
+  }
+
+  results.seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start_time)
+                        .count();
+  return results;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vpoker.h"
+
+// Draws payoffs with fixed probabilities in constant time, with
+// Walker's alias method: pick a column uniformly, then either the
+// column's own payoff or its alias.
+class alias_table {
+ public:
+  // prob_pays[j] is the probability of payoff j, which pays
+  // (*game.pay_table)[j] bets.  Payoffs that pay the same are merged.
+  alias_table(const vp_game &game, const pay_prob &prob_pays);
+
+  // The payoff, in bets, for 64 random bits.
+  int sample(std::uint64_t bits) const {
+    const std::size_t column = static_cast<std::size_t>(
+        ((bits >> 32) * columns_.size()) >> 32);
+    const column_entry &c = columns_[column];
+    return (bits & 0xffffffff) < c.threshold ? c.pay : c.alias_pay;
+  }
+
+ private:
+  struct column_entry {
+    // The column's own payoff is taken when the low 32 bits are
+    // less than threshold.
+    std::uint64_t threshold;
+    int pay;
+    int alias_pay;
+  };
+
+  std::vector<column_entry> columns_;
+};
+
+// A counter-based random number generator (SplitMix64).  The n'th
+// number of a stream is a hash of the seed, the stream and n, so a
+// stream gives the same numbers whichever thread runs it.
+class counter_rng {
+ public:
+  counter_rng(std::uint64_t seed, std::uint64_t stream)
+      : key_(mix(seed + mix(stream + 1) * gamma)) {}
+
+  std::uint64_t operator()() { return mix(key_ + gamma * ++counter_); }
+
+ private:
+  static constexpr std::uint64_t gamma = 0x9e3779b97f4a7c15;
+
+  static std::uint64_t mix(std::uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+
+  std::uint64_t key_;
+  std::uint64_t counter_ = 0;
+};
+
+struct session_options {
+  std::size_t games = 6160;  // per session
+  std::size_t sessions = 100000;
+  unsigned threads = 0;  // zero means one per core
+  std::uint64_t seed = 0;
+};
+
+// The net wins, in bets, of many sessions.
+struct session_results {
+  std::size_t sessions = 0;
+  std::size_t games = 0;
+
+  // histogram[j] is the number of sessions with a net win of low + j.
+  // It covers eight standard deviations each side of the expected
+  // win; under and over count the sessions outside it.
+  std::int64_t low = 0;
+  std::vector<std::uint64_t> histogram;
+  std::uint64_t under = 0;
+  std::uint64_t over = 0;
+
+  std::int64_t min_win = 0;
+  std::int64_t max_win = 0;
+  std::uint64_t ahead = 0;  // sessions with a net win above zero
+
+  double mean = 0.0;  // of the net win of a session
+  double variance = 0.0;
+  double seconds = 0.0;
+
+  // Half the width of the 95% confidence interval of the mean.
+  double mean_error() const;
+
+  // The same for the fraction of sessions that end ahead.
+  double ahead_error() const;
+
+  double games_per_second() const;
+};
+
+// Plays sessions of games, each drawing its payoffs from its own
+// counter_rng stream, spread over threads.  The results depend only on
+// the options' seed, not on the number of threads.
+session_results simulate_sessions(const vp_game &game,
+                                  const pay_prob &prob_pays,
+                                  const session_options &options);
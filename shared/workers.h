@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The number of threads to use for the given number of units of work.
+// Zero requested means one thread per hardware core.
+inline unsigned worker_threads(unsigned requested, std::size_t units) {
+  if (requested == 0) {
+    requested = std::thread::hardware_concurrency();
+  }
+  if (requested == 0) {
+    requested = 1;
+  }
+  if (units < requested) {
+    requested = units == 0 ? 1 : static_cast<unsigned>(units);
+  }
+  return requested;
+}
+
+// Calls work(state, unit) for every unit in 0..units-1, spread over
+// the given number of threads.  Each thread first calls make_state()
+// to create whatever it needs to own privately (such as a C_left),
+// and passes it to every call of work it makes.  Units are handed out
+// in increasing order, but may finish in any order.
+//
+// If make_state or work throws, no more units are handed out, and once
+// every thread has finished, the first exception is thrown again on
+// the calling thread.
+template <typename MakeState, typename Work>
+void run_workers(std::size_t units, unsigned threads, MakeState make_state,
+                 Work work) {
+  std::atomic<std::size_t> next_unit = 0;
+  std::mutex error_lock;
+  std::exception_ptr error;
+
+  auto worker = [&]() {
+    try {
+      auto state = make_state();
+      for (;;) {
+        const std::size_t u = next_unit++;
+        if (u >= units) {
+          break;
+        }
+        work(state, u);
+      }
+    } catch (...) {
+      next_unit = units;
+      const std::lock_guard<std::mutex> guard(error_lock);
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; t++) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &t : pool) {
+    t.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
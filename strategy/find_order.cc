@@ -1,6 +1,8 @@
 #include "find_order.h"
+#include "instrument.h"
 
 #include <algorithm>
+#include <bit>
 #include <cstdio>
 #include <format>
 #include <queue>
@@ -28,6 +30,7 @@ move_desc::move_desc()
       visited(false),
       stacked(false),
       line(-1),
+      number(-1),
       print_id(-1),
       value(-1),
       value_id(-1),
@@ -59,27 +62,13 @@ move_desc* MoveList::get_move (char *s) {
 }
 #endif
 
-void MoveList::add_move(move_desc *m) { moves.push_back(m); }
-
-bool_matrix::bool_matrix(int n) : order(n) {
-  const int size = order * order;
-  data = new bool[size];
-
-  for (int i = 0; i < size; i++) {
-    data[i] = false;
-  }
+void MoveList::add_move(move_desc *m) {
+  m->number = number_moves++;
+  moves.push_back(m);
 }
 
-bool_matrix::bool_matrix(const bool_matrix &t) : order(t.order) {
-  const int size = order * order;
-  data = new bool[size];
-
-  for (int i = 0; i < size; i++) {
-    data[i] = t.data[i];
-  }
-}
-
-bool_matrix::~bool_matrix() { delete[] data; }
+bool_matrix::bool_matrix(int n)
+    : order(n), words((n + 63) / 64), data(std::size_t(n) * words, 0) {}
 
 /// This should be a template ////
 
@@ -125,72 +114,154 @@ C_desc_matrix::~C_desc_matrix() { delete[] data; }
 
 /// end pseudo template ////
 
+// dst |= src, for rows of n words.
+static inline void or_row(std::uint64_t *dst, const std::uint64_t *src,
+                          int n) {
+  for (int k = 0; k < n; k++) {
+    dst[k] |= src[k];
+  }
+}
+
 void Warshall(bool_matrix &m) {
   const int n = m.size();
-  for (int j = 0; j < n; j++)
-    for (int i = 0; i < n; i++)
-      if (i != j) {
-        if (m.at(i, j)) {
-          for (int k = 0; k < n; k++) {
-            m.at(i, k) |= m.at(j, k);
-          }
-        }
+  const int words = m.row_words();
+  for (int j = 0; j < n; j++) {
+    const std::uint64_t *row_j = m.row(j);
+    for (int i = 0; i < n; i++) {
+      if (i != j && m.at(i, j)) {
+        or_row(m.row(i), row_j, words);
       }
+    }
+  }
 }
 
-void multiply(bool_matrix &dst, bool_matrix &x, bool_matrix &y) {
-  int n = dst.size();
+void multiply(bool_matrix &dst, const bool_matrix &x, const bool_matrix &y) {
+  const int n = dst.size();
   _ASSERT(x.size() == n);
   _ASSERT(y.size() == n);
+  const int words = dst.row_words();
 
-  for (int i = 0; i < n; i++)
-    for (int k = 0; k < n; k++) {
-      bool val = false;
-      for (int j = 0; j < n; j++) {
-        val |= x.at(i, j) & y.at(j, k);
-      }
+  // Row i of the product is the or of the rows j of y for which
+  // x(i, j) is set.
+  for (int i = 0; i < n; i++) {
+    std::uint64_t *row_i = dst.row(i);
+    std::fill(row_i, row_i + words, 0);
 
-      dst.at(i, k) = val;
+    const std::uint64_t *x_i = x.row(i);
+    for (int w = 0; w < words; w++) {
+      for (std::uint64_t bits = x_i[w]; bits != 0; bits &= bits - 1) {
+        or_row(row_i, y.row(w * 64 + std::countr_zero(bits)), words);
+      }
     }
+  }
 }
 
 MoveList::move_pair::move_pair(move_desc *i1, move_desc *i2)
-    : x1(i1 < i2 ? i1 : i2),
-      x2(i1 < i2 ? i2 : i1)
+    : x1(i1->number < i2->number ? i1 : i2),
+      x2(i1->number < i2->number ? i2 : i1)
 
 {}
 
 bool MoveList::move_pair::operator<(const move_pair &r) const {
   // Lexicographic ordering
-  if (x1.move < r.x1.move) {
+  if (x1.move->number < r.x1.move->number) {
     return true;
   }
-  if (x1.move > r.x1.move) {
+  if (x1.move->number > r.x1.move->number) {
     return false;
   }
-  return (x2.move < r.x2.move);
+  return (x2.move->number < r.x2.move->number);
 };
 
-void MoveList::add_conflict(move_desc *right, move_desc *wrong, double weight,
-                            card *c_hand, unsigned right_move) {
-  _ASSERT(right != wrong);
+MoveList::move_pair_table::move_pair_table() : slots(64, -1) {}
+
+std::uint64_t MoveList::move_pair_table::key(const move_desc *i1,
+                                             const move_desc *i2) {
+  // The same order of the moves as the move_pair constructor.
+  if (i2->number < i1->number) {
+    std::swap(i1, i2);
+  }
+  return static_cast<std::uint64_t>(i1->number) << 32 |
+         static_cast<std::uint32_t>(i2->number);
+}
 
-  const move_pair &s = *(conflicts.insert(move_pair(right, wrong)).first);
-  const move_info &const_i = (s.x1.move == right) ? s.x1 : s.x2;
-  move_info &i = *const_cast<move_info *>(&const_i);
+std::size_t MoveList::move_pair_table::first_slot(std::uint64_t key) const {
+  return static_cast<std::size_t>((key * 0x9e3779b97f4a7c15ull) >> 32) &
+         (slots.size() - 1);
+}
 
-  if (weight < 0.0) {
-    print_hand(stdout, c_hand, 5);
-    printf("right = %s\n", right->name());
-    printf("wrong = %s\n", wrong->name());
-    printf("weight = %.5f\n", weight);
-    throw 0;
+void MoveList::move_pair_table::grow() {
+  slots.assign(slots.size() * 2, -1);
+  for (std::size_t p = 0; p < pairs.size(); p++) {
+    std::size_t s = first_slot(keys[p]);
+    while (slots[s] >= 0) {
+      s = (s + 1) & (slots.size() - 1);
+    }
+    slots[s] = static_cast<std::int32_t>(p);
   }
+}
 
-  i.total_weight += weight;
+MoveList::move_pair &MoveList::move_pair_table::insert(move_desc *i1,
+                                                       move_desc *i2) {
+  const std::uint64_t k = key(i1, i2);
+  std::size_t s = first_slot(k);
+  for (; slots[s] >= 0; s = (s + 1) & (slots.size() - 1)) {
+    if (keys[slots[s]] == k) {
+      return pairs[slots[s]];
+    }
+  }
 
-  if (weight > i.max_weight) {
-    i.max_weight = weight;
+  // Keep the table at most half full.
+  if (2 * (pairs.size() + 1) > slots.size()) {
+    pairs.emplace_back(i1, i2);
+    keys.push_back(k);
+    grow();
+  } else {
+    slots[s] = static_cast<std::int32_t>(pairs.size());
+    pairs.emplace_back(i1, i2);
+    keys.push_back(k);
+  }
+  return pairs.back();
+}
+
+const MoveList::move_pair *MoveList::move_pair_table::find(
+    move_desc *i1, move_desc *i2) const {
+  const std::uint64_t k = key(i1, i2);
+  for (std::size_t s = first_slot(k); slots[s] >= 0;
+       s = (s + 1) & (slots.size() - 1)) {
+    if (keys[slots[s]] == k) {
+      return &pairs[slots[s]];
+    }
+  }
+  return nullptr;
+}
+
+MoveList::move_pair_vector MoveList::move_pair_table::sorted() const {
+  move_pair_vector result;
+  result.reserve(pairs.size());
+  for (const move_pair &p : pairs) {
+    result.push_back(&p);
+  }
+  std::sort(result.begin(), result.end(),
+            [](const move_pair *l, const move_pair *r) { return *l < *r; });
+  return result;
+}
+
+void MoveList::add_conflicts(move_desc *right, move_desc *wrong,
+                             const std::vector<double> &weights,
+                             double max_weight, const card *c_hand,
+                             unsigned right_move) {
+  _ASSERT(right != wrong);
+
+  move_pair &s = conflicts.insert(right, wrong);
+  move_info &i = (s.x1.move == right) ? s.x1 : s.x2;
+
+  for (const double weight : weights) {
+    i.total_weight += weight;
+  }
+
+  if (max_weight > i.max_weight) {
+    i.max_weight = max_weight;
     for (int j = 0; j < hand_size; j++) {
       i.hand[j] = c_hand[j];
     }
@@ -240,7 +311,7 @@ int MoveList::scc_algorithm(move_desc *x) {
   }
 
   if (min_lowlink == x->df_number) {
-    std::set<move_desc *> scc;
+    move_set scc;
     for (move_desc *rover = stack;; rover = rover->pop) {
       scc.insert(rover);
       rover->scc_id = scc_counter;
@@ -261,13 +332,13 @@ int MoveList::scc_algorithm(move_desc *x) {
   return min_lowlink;
 }
 
-bool MoveList::has_cycle(const std::set<move_desc *> &component) {
+bool MoveList::has_cycle(const move_set &component) {
   bool result = false;
-  for (std::set<move_desc *>::const_iterator iter = component.begin();
+  for (move_set::const_iterator iter = component.begin();
        iter != component.end(); ++iter) {
     result |= detect_cycle(*iter);
   }
-  for (std::set<move_desc *>::const_iterator iter = component.begin();
+  for (move_set::const_iterator iter = component.begin();
        iter != component.end(); ++iter) {
     move_desc *const here = *iter;
     here->visited = false;
@@ -296,9 +367,9 @@ bool MoveList::detect_cycle(move_desc *m) {
   return has_cycle;
 }
 
-void MoveList::greedy_cycle_killer(const std::set<move_desc *> &component) {
+void MoveList::greedy_cycle_killer(const move_set &component) {
   std::vector<move_pair> edges;
-  for (std::set<move_desc *>::const_iterator iter = component.begin();
+  for (move_set::const_iterator iter = component.begin();
        iter != component.end(); ++iter) {
     move_desc *const vertex1 = *iter;
     MoveDescList &ccc = vertex1->ccc;
@@ -312,9 +383,8 @@ void MoveList::greedy_cycle_killer(const std::set<move_desc *> &component) {
         // Not an intra component edge.  Keep it.
         keep.push_front(vertex2);
       } else {
-        const move_pair_set::const_iterator found =
-            conflicts.find(move_pair(vertex1, vertex2));
-        _ASSERT(found != conflicts.end());
+        const move_pair *found = conflicts.find(vertex1, vertex2);
+        _ASSERT(found != nullptr);
         edges.push_back(*found);
       }
     }
@@ -366,7 +436,7 @@ void MoveList::greedy_cycle_killer(const std::set<move_desc *> &component) {
   }
 
   // Add the non-cycle producing edges to the real graph.
-  for (std::set<move_desc *>::const_iterator iter = component.begin();
+  for (move_set::const_iterator iter = component.begin();
        iter != component.end(); ++iter) {
     move_desc *const here = *iter;
     here->ccc.splice(here->ccc.begin(), here->cyclic);
@@ -445,10 +515,10 @@ struct SortByValue {
 };
 
 void MoveList::sort_moves(FILE *file) {
+  instrument::phase_timer timer(instrument::sorting_moves);
   move_pair_vector bad_boyz;
 
-  for (move_pair_set::iterator zzz = conflicts.begin(); zzz != conflicts.end();
-       ++zzz) {
+  for (const move_pair *zzz : conflicts.sorted()) {
     const move_pair &q = *zzz;
     const move_info &good =
         (q.x1.total_weight > q.x2.total_weight ? q.x1 : q.x2);
@@ -763,9 +833,8 @@ void MoveList::print_the_answer(FILE *file, bool_matrix &haas) {
       for (int i = 0; i < haas.size(); i++) {
         if (haas.at((*rover)->print_id, i)) {
           // Print the hand that inspired this edge.
-          move_pair_set::iterator found =
-              conflicts.find(move_pair(*rover, haas_index[i]));
-          _ASSERT(found != conflicts.end());
+          const move_pair *found = conflicts.find(*rover, haas_index[i]);
+          _ASSERT(found != nullptr);
           const move_info &print_desc =
               found->x1.total_weight > found->x2.total_weight ? found->x1
                                                               : found->x2;
@@ -792,7 +861,7 @@ void MoveList::find_closure(FILE *file) {
        rover != print_order.end(); rover++) {
     for (MoveDescList::iterator inner = (*rover)->ccc.begin();
          inner != (*rover)->ccc.end(); inner++) {
-      adj.at((*rover)->print_id, (*inner)->print_id) = true;
+      adj.set((*rover)->print_id, (*inner)->print_id);
     }
   }
 
@@ -807,10 +876,13 @@ void MoveList::find_closure(FILE *file) {
   bool_matrix haas(close);
 
   {
-    for (int i = 0; i < N; i++)
-      for (int j = 0; j < N; j++) {
-        haas.at(i, j) &= !squared.at(i, j);
+    for (int i = 0; i < N; i++) {
+      std::uint64_t *row = haas.row(i);
+      const std::uint64_t *remove = squared.row(i);
+      for (int w = 0; w < haas.row_words(); w++) {
+        row[w] &= ~remove[w];
       }
+    }
   }
 
   print_the_answer(file, haas);
@@ -822,4 +894,5 @@ MoveList::MoveList(int hsize) {
   stack = 0;
   scc_counter = 0;
   output_file = 0;
+  number_moves = 0;
 }
@@ -2,6 +2,7 @@
 
 #include <cstdio>
 #include <cstddef>
+#include <cstdint>
 #include <list>
 #include <set>
 #include <vector>
@@ -10,25 +11,52 @@
 
 void print_hand(FILE *file, const card *hand, int size);
 
+// A square matrix of bits.  Each row is packed into 64-bit words, so
+// that the closure and product below combine whole rows a word at a
+// time rather than a cell at a time.
 class bool_matrix {
  public:
   bool_matrix(int n);
-  bool_matrix(const bool_matrix &);
-  ~bool_matrix();
 
-  inline bool &at(int i, int j) {
+  inline bool at(int i, int j) const {
     _ASSERT(0 <= i && i < order);
     _ASSERT(0 <= j && j < order);
-    return data[i * order + j];
+    return (row(i)[j >> 6] >> (j & 63)) & 1;
   }
 
-  inline int size() { return order; }
+  inline void set(int i, int j, bool value = true) {
+    _ASSERT(0 <= i && i < order);
+    _ASSERT(0 <= j && j < order);
+    const std::uint64_t bit = std::uint64_t(1) << (j & 63);
+    if (value) {
+      row(i)[j >> 6] |= bit;
+    } else {
+      row(i)[j >> 6] &= ~bit;
+    }
+  }
+
+  inline int size() const { return order; }
+
+  // The number of words in each row.
+  inline int row_words() const { return words; }
+
+  inline std::uint64_t *row(int i) { return data.data() + i * words; }
+  inline const std::uint64_t *row(int i) const {
+    return data.data() + i * words;
+  }
 
  private:
-  bool *data;
   int order;
+  int words;
+  std::vector<std::uint64_t> data;
 };
 
+// Replaces m by its transitive closure.
+void Warshall(bool_matrix &m);
+
+// dst = x * y, with or for addition and and for multiplication.
+void multiply(bool_matrix &dst, const bool_matrix &x, const bool_matrix &y);
+
 class move_desc;
 
 struct mlist {
@@ -62,6 +90,7 @@ class move_desc {
   bool visited;
   bool stacked;
   std::size_t line;
+  int number;  // Counts the moves in the order they are added to MoveList
   int print_id;
   int value;
   int value_id;
@@ -97,7 +126,7 @@ class MoveList {
 
   struct move_pair {
     move_info x1, x2;
-    // By convention x1.move < x2.move;
+    // By convention x1.move->number < x2.move->number;
 
     bool operator<(const move_pair &r) const;
     // To allow sets
@@ -124,10 +153,43 @@ class MoveList {
     bool operator()(const move_pair *&l, const move_pair *&r) const;
   };
 
-  typedef std::set<move_pair> move_pair_set;
-  move_pair_set conflicts;
+  // The conflicts, in an open addressing hash table keyed by the
+  // numbers of the two moves.  Iterating a std::set of them was
+  // allocation bound; the sorted order is only needed by sort_moves.
+  class move_pair_table {
+   public:
+    move_pair_table();
 
-  using move_set = std::set<move_desc *>;
+    // Finds the pair of moves, adding it if it isn't there yet.
+    move_pair &insert(move_desc *i1, move_desc *i2);
+
+    // Returns nullptr if the pair of moves isn't there.
+    const move_pair *find(move_desc *i1, move_desc *i2) const;
+
+    // All the pairs, in the order of move_pair::operator<.
+    move_pair_vector sorted() const;
+
+   private:
+    static std::uint64_t key(const move_desc *i1, const move_desc *i2);
+    std::size_t first_slot(std::uint64_t key) const;
+    void grow();
+
+    std::vector<move_pair> pairs;
+    std::vector<std::uint64_t> keys;   // The key of each pair
+    std::vector<std::int32_t> slots;   // Indexes into pairs, or -1
+  };
+
+  move_pair_table conflicts;
+
+  // Sets of moves are ordered by move number, which is the order the
+  // moves were added, so that the output does not depend on where the
+  // moves happen to be allocated.
+  struct by_number {
+    bool operator()(const move_desc *l, const move_desc *r) const {
+      return l->number < r->number;
+    }
+  };
+  using move_set = std::set<move_desc *, by_number>;
   move_set good_moves;
 
   int hand_size;
@@ -136,8 +198,8 @@ class MoveList {
 
   int scc_algorithm(move_desc *x);
 
-  void greedy_cycle_killer(const std::set<move_desc *> &component);
-  bool has_cycle(const std::set<move_desc *> &component);
+  void greedy_cycle_killer(const move_set &component);
+  bool has_cycle(const move_set &component);
   bool detect_cycle(move_desc *m);
 
   typedef std::vector<move_desc *> move_vector;
@@ -170,8 +232,12 @@ class MoveList {
   // Must register all moves before creating
   // any conflicts.
 
-  void add_conflict(move_desc *right, move_desc *wrong, double weight,
-                    card *c_hand, unsigned right_move);
+  void add_conflicts(move_desc *right, move_desc *wrong,
+                     const std::vector<double> &weights, double max_weight,
+                     const card *c_hand, unsigned right_move);
+  // Same as adding a conflict for each of the weights in order:
+  // the weights are summed in that order, and c_hand and right_move
+  // are the example for the first of them equal to max_weight.
 
   void display(FILE *file, bool deuces, bool print_haas, bool print_value);
   void sort_moves(FILE *file);
@@ -1,14 +1,35 @@
+#include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <iostream>
 
+#include "instrument.h"
 #include "strategy.h"
 
 int main(int argc, char* argv[]) {
   try {
+    // Options come before the file names.
+    // --stats prints counters and phase times at the end of the command.
+    // --threads n evaluates hands with n threads (default one per core).
+    unsigned threads = 0;
+    while (argc >= 2 && std::strncmp(argv[1], "--", 2) == 0) {
+      if (std::strcmp(argv[1], "--stats") == 0) {
+        instrument::enable();
+      } else if (std::strcmp(argv[1], "--threads") == 0 && argc >= 3) {
+        threads = static_cast<unsigned>(std::atoi(argv[2]));
+        --argc;
+        ++argv;
+      } else {
+        std::cerr << "Unknown option " << argv[1] << '\n';
+        return 1;
+      }
+      --argc;
+      ++argv;
+    }
     if (argc == 3) {
-      parser(argv[1], argv[2]);
+      parser(argv[1], argv[2], threads);
     } else if (argc == 2) {
-      parser(argv[1]);
+      parser(argv[1], nullptr, threads);
     } else {
       std::cerr << "Wrong number of args\n";
       return 1;
@@ -0,0 +1,236 @@
+#define _CRT_SECURE_NO_WARNINGS  // For Microsoft Visual Studio
+#include "match_index.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+
+#include "../shared/compiled_match.h"
+#include "hand_iter.h"
+#include "hand_table.h"
+#include "instrument.h"
+
+// The file consists of a header, followed for each number of wild
+// cards by the first array and then the found array of its section.
+struct match_index_header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t max_wild_cards;
+  std::uint64_t fingerprint;
+  std::uint32_t hands[5];  // The size of each first array, less one
+  std::uint32_t found[5];  // The size of each found array
+};
+
+static const char index_magic[8] = {'V', 'P', 'M', 'A', 'T', 'C', 'H', 0};
+
+// Change this whenever EnumerateMatches or parse_line change the
+// meaning of a strategy line, so that old files are not used.
+static const std::uint32_t index_version = 1;
+
+match_index::match_index(const vp_game &game, StrategyLine *const lines[])
+    : fingerprint_(fingerprint(game, lines)) {
+  game_parameters parms(game);
+  max_wild_cards_ = parms.number_wild_cards;
+  const std::unique_ptr<hand_table> table = hand_table::open(parms.kind);
+
+  printf("Matching strategy lines");
+  int timer = 0;
+
+  for (int wild_cards = 0; wild_cards <= max_wild_cards_; wild_cards++) {
+    section &s = sections_[wild_cards];
+
+    CompiledMatcher matcher;
+    matcher.wild_cards = wild_cards;
+    matcher.parms = &parms;
+    matcher.hand_size = 5 - wild_cards;
+
+    const std::span<const hand_record> hands = table->hands(wild_cards);
+    s.first.reserve(hands.size() + 1);
+
+    std::size_t num_lines = 0;
+    while (lines[wild_cards][num_lines].pattern) {
+      num_lines++;
+    }
+    std::vector<std::uint64_t> finds(num_lines);
+
+    // CompiledMatcher::find adds its own time to the matching phase.
+    for (const hand_record &r : hands) {
+      if (++timer > 102359 / 40) {
+        printf(".");
+        timer = 0;
+      }
+
+      std::copy_n(r.cards, matcher.hand_size, matcher.hand);
+      s.first.push_back(static_cast<std::uint32_t>(s.found.size()));
+
+      for (const StrategyLine *line = lines[wild_cards]; line->pattern;
+           ++line) {
+        matcher.find(*line);
+        finds[line - lines[wild_cards]] += 1;
+        if (matcher.match_count != 0) {
+          line_match m;
+          m.plays = 0;
+          for (int j = 0; j < matcher.match_count; j++) {
+            m.plays |= std::uint32_t(1) << matcher.matches[j];
+          }
+          m.line = static_cast<std::uint16_t>(line - lines[wild_cards]);
+          m.first = matcher.matches[0];
+          m.unused = 0;
+          s.found.push_back(m);
+        }
+      }
+
+      if (s.found.size() == s.first.back()) {
+        throw std::runtime_error(std::format(
+            "No strategy line matches {}",
+            move_image(matcher.hand, matcher.hand_size, 0)));
+      }
+    }
+    s.first.push_back(static_cast<std::uint32_t>(s.found.size()));
+
+    for (std::size_t line = 0; line < num_lines; line++) {
+      instrument::add_line(lines[wild_cards][line].image, finds[line]);
+    }
+  }
+  printf("\n");
+}
+
+match_index::match_index(const std::string &filename, const vp_game &game,
+                         StrategyLine *const lines[]) {
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file == nullptr) {
+    throw std::runtime_error(std::format("Could not open {}", filename));
+  }
+
+  game_parameters parms(game);
+  match_index_header header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            std::memcmp(header.magic, index_magic, sizeof(index_magic)) == 0 &&
+            header.version == index_version &&
+            header.max_wild_cards ==
+                static_cast<std::uint32_t>(parms.number_wild_cards) &&
+            header.fingerprint == fingerprint(game, lines);
+
+  if (ok) {
+    fingerprint_ = header.fingerprint;
+    max_wild_cards_ = header.max_wild_cards;
+    for (int w = 0; ok && w <= max_wild_cards_; w++) {
+      // matches() indexes first by the hands of the table, and the
+      // strategy by line, so both must fit.
+      const hand_iter iter(5 - w, parms.kind, w);
+      std::size_t num_lines = 0;
+      while (lines[w][num_lines].pattern) {
+        num_lines++;
+      }
+
+      section &s = sections_[w];
+      ok = header.hands[w] == iter.count();
+      if (ok) {
+        s.first.resize(std::size_t(header.hands[w]) + 1);
+        s.found.resize(header.found[w]);
+        ok = fread(s.first.data(), sizeof(std::uint32_t), s.first.size(),
+                   file) == s.first.size() &&
+             fread(s.found.data(), sizeof(line_match), s.found.size(),
+                   file) == s.found.size();
+      }
+      ok = ok && s.first.front() == 0 && s.first.back() == s.found.size() &&
+           std::is_sorted(s.first.begin(), s.first.end()) &&
+           std::all_of(s.found.begin(), s.found.end(),
+                       [num_lines](const line_match &m) {
+                         return m.line < num_lines;
+                       });
+    }
+    ok = ok && fgetc(file) == EOF;
+  }
+  fclose(file);
+
+  if (!ok) {
+    throw std::runtime_error(
+        std::format("{} is not a valid match index", filename));
+  }
+}
+
+std::uint64_t match_index::fingerprint(const vp_game &game,
+                                       StrategyLine *const lines[]) {
+  // FNV-1a over the game name, the hand table version and the text of
+  // the lines of each section.
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  auto add = [&hash](const char *text, std::size_t size) {
+    for (std::size_t j = 0; j < size; j++) {
+      hash ^= static_cast<unsigned char>(text[j]);
+      hash *= 0x100000001b3ull;
+    }
+  };
+
+  add(game.name, std::strlen(game.name) + 1);
+  const std::uint32_t table_version = hand_table::version;
+  add(reinterpret_cast<const char *>(&table_version), sizeof(table_version));
+  const int max_wild_cards = game_parameters(game).number_wild_cards;
+  for (int wild_cards = 0; wild_cards <= max_wild_cards; wild_cards++) {
+    for (const StrategyLine *line = lines[wild_cards]; line->pattern; ++line) {
+      add(line->image, std::strlen(line->image) + 1);
+    }
+    add("", 1);
+  }
+  return hash;
+}
+
+void match_index::write(const std::string &filename) const {
+  match_index_header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, index_magic, sizeof(index_magic));
+  header.version = index_version;
+  header.max_wild_cards = max_wild_cards_;
+  header.fingerprint = fingerprint_;
+  for (int w = 0; w <= max_wild_cards_; w++) {
+    header.hands[w] = static_cast<std::uint32_t>(sections_[w].first.size() - 1);
+    header.found[w] = static_cast<std::uint32_t>(sections_[w].found.size());
+  }
+
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error(std::format("Could not create {}", filename));
+  }
+
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  for (int w = 0; ok && w <= max_wild_cards_; w++) {
+    const section &s = sections_[w];
+    ok = fwrite(s.first.data(), sizeof(std::uint32_t), s.first.size(),
+                file) == s.first.size() &&
+         fwrite(s.found.data(), sizeof(line_match), s.found.size(), file) ==
+             s.found.size();
+  }
+  if (fclose(file) != 0 || !ok) {
+    throw std::runtime_error(std::format("Could not write {}", filename));
+  }
+}
+
+std::string match_index::file_name(const char *strategy_file) {
+  return std::format("{}.matches", strategy_file);
+}
+
+std::unique_ptr<match_index> match_index::open(const vp_game &game,
+                                               StrategyLine *const lines[],
+                                               const char *strategy_file) {
+  const std::string filename = file_name(strategy_file);
+  try {
+    auto result = std::make_unique<match_index>(filename, game, lines);
+    printf("Using the line matches in %s\n", filename.c_str());
+    return result;
+  } catch (const std::runtime_error &) {
+    // Fall through and build the index.
+  }
+
+  auto result = std::make_unique<match_index>(game, lines);
+  try {
+    result->write(filename);
+    printf("Saved the line matches in %s\n", filename.c_str());
+  } catch (const std::runtime_error &) {
+    // The index is only an optimization.
+    printf("Could not save the line matches in %s\n", filename.c_str());
+  }
+  return result;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "enum_match.h"
+#include "game.h"
+
+// The strategy lines that match each canonical hand, so that reports
+// run again on the same strategy can skip EnumerateMatches.  The index
+// is saved in a binary file next to the strategy file, with ".matches"
+// added to its name, and is used again only if the game and the text
+// of every strategy line, and the hand table version, are the same as
+// when it was built.
+
+// One strategy line that matches a hand.
+struct line_match {
+  std::uint32_t plays;  // Bit m is set if the line matches play m
+  std::uint16_t line;   // The index of the line in its section
+  std::uint8_t first;   // EnumerateMatches::matches[0]
+  std::uint8_t unused;
+
+  bool matches(unsigned mask) const { return (plays >> mask) & 1; }
+};
+static_assert(sizeof(line_match) == 8);
+
+class match_index {
+ public:
+  // Runs EnumerateMatches for every line of the strategy on every
+  // canonical hand of the game.
+  match_index(const vp_game &game, StrategyLine *const lines[]);
+
+  // Reads a file written by write() for the same game and strategy.
+  // Throws if it was written for another, or doesn't fit them.
+  match_index(const std::string &filename, const vp_game &game,
+              StrategyLine *const lines[]);
+
+  // The lines that match a hand, in strategy order, for the hand at
+  // the given position in the order hand_iter visits them.  Every hand
+  // matches at least one line.
+  std::span<const line_match> matches(int wild_cards, std::size_t hand) const {
+    const section &s = sections_[wild_cards];
+    return std::span<const line_match>(s.found.data() + s.first[hand],
+                                       s.found.data() + s.first[hand + 1]);
+  }
+
+  // Identifies the game and the strategy the index was built for.
+  std::uint64_t fingerprint() const { return fingerprint_; }
+  static std::uint64_t fingerprint(const vp_game &game,
+                                   StrategyLine *const lines[]);
+
+  void write(const std::string &filename) const;
+
+  // The file the index of a strategy file is saved in.
+  static std::string file_name(const char *strategy_file);
+
+  // Reads the saved index if it belongs to the strategy, otherwise
+  // builds it and tries to save it.  Says which file it used or saved.
+  static std::unique_ptr<match_index> open(const vp_game &game,
+                                           StrategyLine *const lines[],
+                                           const char *strategy_file);
+
+ private:
+  struct section {
+    std::vector<std::uint32_t> first;  // Into found, one more than hands
+    std::vector<line_match> found;
+  };
+
+  std::uint64_t fingerprint_;
+  int max_wild_cards_;
+  section sections_[5];
+};
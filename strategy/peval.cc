@@ -12,15 +12,21 @@
 #include <iostream>
 #include <map>
 #include <numeric>
+#include <span>
 #include <stdexcept>
 #include <utility>
 #include <vector>
 
-#include "../shared/hand_iter.h"
+#include "bankroll.h"
 #include "combin.h"
 #include "enum_match.h"
 #include "game.h"
+#include "grid_command.h"
+#include "hand_table.h"
+#include "hold_kernel.h"
+#include "instrument.h"
 #include "kept.h"
+#include "match_index.h"
 #include "pay_dist.h"
 #include "vpoker.h"
 
@@ -95,48 +101,39 @@ struct estate {
   StrategyLine *trace_line[max_trace];
 };
 
-static void evaluate(hand_iter &h, int deuces, C_left &left,
-                     StrategyLine *lines, estate &e, game_parameters &parms) {
+static void evaluate(const hand_record &r, int deuces, C_left &left,
+                     StrategyLine *lines, std::span<const line_match> found,
+                     estate &e, game_parameters &parms) {
   // Compute the expected value of an initial five-card hand
-  // consisting of the cards returned by the iterator plus
-  // the indicated number of deuces.
+  // consisting of the cards of the record plus the indicated
+  // number of deuces.
 
-  EnumerateMatches matcher;
-  matcher.wild_cards = deuces;
-  matcher.parms = &parms;
-
-  matcher.hand_size = h.size();
-  h.current(matcher.hand[0]);
+  card hand[5];
+  const int hand_size = 5 - deuces;
+  std::copy_n(r.cards, hand_size, hand);
+  instrument::count(instrument::hands_visited);
 
-  left.remove(matcher.hand, matcher.hand_size, deuces);
+  left.remove(hand, hand_size, deuces);
   // Subtract the hand to be evaluated from the left structure
 
-  unsigned power = 1 << matcher.hand_size;
+  unsigned power = 1 << hand_size;
 
   unsigned optimal_mask;
   int optimal_deuces;
 
   double best_value = -1.0, strategy_value = -1.0;
 
-  StrategyLine *best_strategy = lines;
+  // The first matching line is the one the strategy plays.
+  StrategyLine *best_strategy = lines + found[0].line;
   unsigned strategy_mask = 0;
 
   // Incrementing the binary mask iterates over all
   // 2^hand_size combinations of cards to be kept.
 
-  for (;;) {
-    matcher.find(best_strategy->pattern);
-    if (matcher.match_count != 0) {
-      break;
-    }
-
-    best_strategy += 1;
-  }
-
   unsigned mask;
 
   for (mask = 0; mask < power; mask++) {
-    kept_description kept(matcher.hand, matcher.hand_size, mask, parms);
+    kept_description kept(hand, hand_size, mask, parms);
     // Build the description of subset of the hand
     // indicated by mask.
 
@@ -163,7 +160,7 @@ static void evaluate(hand_iter &h, int deuces, C_left &left,
         const double current_total = (double)total_pays;
         const double value = result / current_total;
 
-        if (keep_deuces == deuces && matcher.result_vector[mask]) {
+        if (keep_deuces == deuces && found[0].matches(mask)) {
           if (strategy_value < 0.0 || value < strategy_value) {
             strategy_value = value;
             strategy_mask = mask;
@@ -195,10 +192,10 @@ static void evaluate(hand_iter &h, int deuces, C_left &left,
 
   if (inf.best_shortfall < 0.0 || shortfall < inf.best_shortfall) {
     inf.best_shortfall = shortfall;
-    inf.best_hsize = matcher.hand_size;
+    inf.best_hsize = hand_size;
     inf.best_play = strategy_mask;
-    for (int j = 0; j < matcher.hand_size; j++) {
-      inf.best_hand[j] = matcher.hand[j];
+    for (int j = 0; j < hand_size; j++) {
+      inf.best_hand[j] = hand[j];
     }
   }
 
@@ -211,24 +208,23 @@ static void evaluate(hand_iter &h, int deuces, C_left &left,
     if (!inf.erroneous || shortfall > inf.worst_shortfall) {
       inf.erroneous = true;
       inf.worst_shortfall = shortfall;
-      inf.worst_hsize = matcher.hand_size;
+      inf.worst_hsize = hand_size;
       inf.optimal_play = optimal_mask;
       inf.worst_play = strategy_mask;
 
-      for (int j = 0; j < matcher.hand_size; j++) {
-        inf.worst_hand[j] = matcher.hand[j];
+      for (int j = 0; j < hand_size; j++) {
+        inf.worst_hand[j] = hand[j];
       }
     }
 
     for (int j = 0; j < e.trace_count; j++) {
       if (e.trace_line[j] == best_strategy) {
-        print_move(e.trace_file[j], matcher.hand, matcher.hand_size,
-                   optimal_mask);
+        print_move(e.trace_file[j], hand, hand_size, optimal_mask);
       }
     }
   }
 
-  left.replace(matcher.hand, matcher.hand_size, deuces);
+  left.replace(hand, hand_size, deuces);
 }
 
 static void print_detail(FILE *file, const card *hand, int hand_size,
@@ -260,12 +256,13 @@ static void print_detail(FILE *file, const card *hand, int hand_size,
 }
 
 void eval_strategy(const vp_game &game, StrategyLine *lines[],
-                   const char *filename) {
+                   const match_index &index, const char *filename) {
   int counter = 0;
   int timer = 0;
 
   game_parameters parms(game);
   C_left left(parms);
+  const std::unique_ptr<hand_table> table = hand_table::open(parms.kind);
 
   const int total_hands = combin.choose(parms.deck_size, 5);
 
@@ -290,8 +287,6 @@ void eval_strategy(const vp_game &game, StrategyLine *lines[],
 
   for (int wild_cards = 0; wild_cards <= parms.number_wild_cards;
        wild_cards++) {
-    const int hand_size = 5 - wild_cards;
-
     const int wmult = combin.choose(parms.number_wild_cards, wild_cards);
 
     StrategyLine *strategy_w = lines[wild_cards];
@@ -338,20 +333,22 @@ void eval_strategy(const vp_game &game, StrategyLine *lines[],
       e.strategy_info = new line_info[n];
     }
 
-    hand_iter iter(hand_size, parms.kind, wild_cards);
-    while (!iter.done()) {
-      if (++timer > 102359 / 40) {
-        printf(".");
-        timer = 0;
-      }
-
-      const int mult = wmult * iter.multiplier();
-      e.multiplier = (double)mult / double(total_hands);
+    const std::span<const hand_record> hands = table->hands(wild_cards);
+    {
+      instrument::phase_timer enumeration(instrument::enumeration);
+      for (std::size_t hand = 0; hand < hands.size(); hand++) {
+        if (++timer > 102359 / 40) {
+          printf(".");
+          timer = 0;
+        }
 
-      evaluate(iter, wild_cards, left, strategy_w, e, parms);
-      counter += mult;
+        const int mult = wmult * hands[hand].multiplier;
+        e.multiplier = (double)mult / double(total_hands);
 
-      iter.next();
+        evaluate(hands[hand], wild_cards, left, strategy_w,
+                 index.matches(wild_cards, hand), e, parms);
+        counter += mult;
+      }
     }
 
     for (int j = 0; j < e.trace_count; j++) {
@@ -408,6 +405,7 @@ void eval_strategy(const vp_game &game, StrategyLine *lines[],
     throw 0;
   }
 
+  instrument::phase_timer report(instrument::report_writing);
   std::sort<error_list::iterator>(error_report.begin(), error_report.end());
 
   if (error_report.begin() == error_report.end()) {
@@ -450,71 +448,59 @@ void eval_strategy(const vp_game &game, StrategyLine *lines[],
   printf("Report is in %s\n", filename);
 }
 
-static double evaluate_play(card *hand, int hand_size, bool *result_vector,
+static double evaluate_play(card *hand, int hand_size, const line_match &play,
                             int deuces, C_left &left, game_parameters &parms) {
-  double strategy_value = -1.0;
+  hold_table holds;
   const unsigned power = 1 << hand_size;
   for (unsigned mask = 0; mask < power; mask++) {
-    if (!result_vector[mask]) continue;
+    if (!play.matches(mask)) continue;
 
     // Build the description of subset of the hand indicated by mask.
     kept_description kept(hand, hand_size, mask, parms);
 
     pay_dist pays;
     kept.all_draws(deuces, left, pays);
+    holds.add(pays);
+  }
 
-    // Compute the expected value of this play.
-    int total_pays = 0;
-    double result = 0.0;
-    for (int j = first_pay; j <= last_pay; j++) {
-      const int pay = pays[j];
-      total_pays += pay;
-      result += (double)pay * parms.pay_table[j];
-    }
-
-    const double value = result / (double)total_pays;
+  // Compute the expected values of all the plays together.
+  double values[hold_table::max_rows];
+  score_holds(holds, parms.pay_table, values);
 
+  double strategy_value = -1.0;
+  for (int row = 0; row < holds.rows; row++) {
     // If the strategy line could select more than one mask, keep the worst one.
-    if (strategy_value < 0.0 || value < strategy_value) {
-      strategy_value = value;
+    if (strategy_value < 0.0 || values[row] < strategy_value) {
+      strategy_value = values[row];
     }
   }
   return strategy_value;
 }
 
 // mult is the number of different ways the starting hand can be dealt.
-static PayDistribution evaluate_multi(const hand_iter &h, int deuces,
-                                      C_left &left, StrategyLine *lines,
+static PayDistribution evaluate_multi(const hand_record &r, int deuces,
+                                      C_left &left,
+                                      std::span<const line_match> found,
                                       game_parameters &parms) {
   // Compute the expected value of an initial five-card hand
-  // consisting of the cards returned by the iterator plus
-  // the indicated number of deuces.
-
-  EnumerateMatches matcher;
-  matcher.wild_cards = deuces;
-  matcher.parms = &parms;
+  // consisting of the cards of the record plus the indicated
+  // number of deuces.
 
-  matcher.hand_size = h.size();
-  h.current(matcher.hand[0]);
+  card hand[5];
+  const int hand_size = 5 - deuces;
+  std::copy_n(r.cards, hand_size, hand);
+  instrument::count(instrument::hands_visited);
 
   // Subtract the hand to be evaluated from the left structure
-  left.remove(matcher.hand, matcher.hand_size, deuces);
+  left.remove(hand, hand_size, deuces);
 
-  // Find the first matching strategy line.
+  // The first matching strategy line is found[0].
   // Since all strategies end with "nothing", there will be one.
-  for (StrategyLine *matching = lines;; ++matching) {
-    matcher.find(matching->pattern);
-    if (matcher.match_count != 0) {
-      break;
-    }
-  }
-
   // There will typically be only one set of matching cards.
   // In a few cases (one pair in Full Pay Deuces) there may be
   // more then one. In good strategies, it won't matter which
   // combination we pick.
-  kept_description kept(matcher.hand, matcher.hand_size, matcher.matches[0],
-                        parms);
+  kept_description kept(hand, hand_size, found[0].first, parms);
   pay_dist pays;
   kept.all_draws(deuces, left, pays);
   // pays is now the number of ways of making each of the possible
@@ -534,7 +520,7 @@ static PayDistribution evaluate_multi(const hand_iter &h, int deuces,
       pd.emplace_back(probability, parms.pay_table[j]);
     }
   }
-  left.replace(matcher.hand, matcher.hand_size, deuces);
+  left.replace(hand, hand_size, deuces);
 
   // Stop keeping track of details after three royal flushes.
   PayDistribution dist(5 * parms.pay_table[N_royal_flush], 0, pd);
@@ -542,7 +528,7 @@ static PayDistribution evaluate_multi(const hand_iter &h, int deuces,
   return dist;
 }
 
-void multi_distribution(const vp_game &game, StrategyLine *lines[],
+void multi_distribution(const vp_game &game, const match_index &index,
                         unsigned int num_lines, unsigned int num_games,
                         const char *filename) {
   char buffer[256];
@@ -551,6 +537,7 @@ void multi_distribution(const vp_game &game, StrategyLine *lines[],
 
   game_parameters parms(game);
   C_left left(parms);
+  const std::unique_ptr<hand_table> table = hand_table::open(parms.kind);
 
   const double total_hands = combin.choose(parms.deck_size, 5);
 
@@ -568,41 +555,47 @@ void multi_distribution(const vp_game &game, StrategyLine *lines[],
   int counter = 0;
   int timer = 0;
 
-  PayDistribution total_pays;
+  // Payoffs of five royal flushes and more aren't kept apart, as in
+  // evaluate_multi.
+  PayAccumulator accumulated(5 * parms.pay_table[N_royal_flush]);
+  RepeatCache repeated(num_lines);
 
   for (int wild_cards = 0; wild_cards <= parms.number_wild_cards;
        wild_cards++) {
-    const int hand_size = 5 - wild_cards;
-
     // wide_mult is the number of different ways of being dealt "wild_cards"
     // wild cards.
     const int wide_mult = combin.choose(parms.number_wild_cards, wild_cards);
 
-    for (hand_iter iter(hand_size, parms.kind, wild_cards); !iter.done();
-         iter.next()) {
-      if (++timer > 2558) {
-        printf(".");
-        timer = 0;
-      }
-      PayDistribution dist = repeat(
-          evaluate_multi(iter, wild_cards, left, lines[wild_cards], parms),
-          num_lines);
+    {
+      instrument::phase_timer enumeration(instrument::enumeration);
+      const std::span<const hand_record> hands = table->hands(wild_cards);
+      for (std::size_t hand = 0; hand < hands.size(); hand++) {
+        if (++timer > 2558) {
+          printf(".");
+          timer = 0;
+        }
+        const PayDistribution &dist = repeated.repeat(
+            evaluate_multi(hands[hand], wild_cards, left,
+                           index.matches(wild_cards, hand), parms));
 
-      // Compute the probability of the starting hand.
-      const int mult = wide_mult * iter.multiplier();
-      const double start_prob = mult / total_hands;
+        // Compute the probability of the starting hand.
+        const int mult = wide_mult * hands[hand].multiplier;
+        const double start_prob = mult / total_hands;
 
-      // Adjust the pay distribution by this probability.
-      dist.scale(start_prob);
-      total_pays = merge(total_pays, dist);
+        // Add in the pay distribution, weighted by this probability.
+        accumulated.add(dist, start_prob);
 
-      counter += mult;
+        counter += mult;
+      }
     }
   }
   printf("\n");
   if (counter != total_hands) {
     throw std::runtime_error("Iteration counter wrong\n");
   }
+  instrument::add(instrument::multi_wagers, repeated.size());
+
+  PayDistribution total_pays = accumulated.total();
 
   for (const auto &[prob, pay] : total_pays.distribution()) {
 #if 0
@@ -635,6 +628,8 @@ void multi_distribution(const vp_game &game, StrategyLine *lines[],
   total_pays.set_cutoff(num_games + 2001);
   total_pays = repeat(total_pays, num_games);
 
+  instrument::phase_timer report(instrument::report_writing);
+
   // Create cumulative distribution./
   std::vector<ProbPay> cumulative;
   cumulative.reserve(100);
@@ -691,63 +686,42 @@ void multi_distribution(const vp_game &game, StrategyLine *lines[],
 
 typedef std::map<std::pair<int, int>, double> prune_data;
 
-static void evaluate_for_prune(hand_iter &h, int deuces, C_left &left,
-                               StrategyLine *lines, std::size_t strategy_length,
+static void evaluate_for_prune(const hand_record &r, int deuces, C_left &left,
+                               std::span<const line_match> found,
                                game_parameters &parms, double multiplier,
                                prune_data &accum) {
   // Compute the expected value of an initial five-card hand
-  // consisting of the cards returned by the iterator plus
-  // the indicated number of deuces.
-
-  EnumerateMatches matcher;
-  matcher.wild_cards = deuces;
-  matcher.parms = &parms;
+  // consisting of the cards of the record plus the indicated
+  // number of deuces.
 
-  matcher.hand_size = h.size();
-  h.current(matcher.hand[0]);
+  card hand[5];
+  const int hand_size = 5 - deuces;
+  std::copy_n(r.cards, hand_size, hand);
+  instrument::count(instrument::hands_visited);
 
   // Subtract the hand to be evaluated from the left structure
-  left.remove(matcher.hand, matcher.hand_size, deuces);
-
-  struct {
-    int index;
-    bool result_vector[32];
-  } plays[2];
-
-  int i = 0;
-  for (int k = 0; lines[k].pattern; ++k) {
-    matcher.find(lines[k].pattern);
-    if (matcher.match_count != 0) {
-      if (i == 1) {
-        bool same = true;
-        for (int j = 0; j < 32; ++j) {
-          same = same && matcher.result_vector[j] == plays[0].result_vector[j];
-        }
-        if (same) continue;
-      }
-      plays[i].index = k;
-      for (int j = 0; j < 32; ++j) {
-        plays[i].result_vector[j] = matcher.result_vector[j];
-      }
-      i += 1;
-      if (i == 2) break;
+  left.remove(hand, hand_size, deuces);
+
+  // The first matching line, and the next one that matches different plays.
+  const line_match *plays[2] = {&found[0], nullptr};
+  for (const line_match &m : found) {
+    if (m.plays != found[0].plays) {
+      plays[1] = &m;
+      break;
     }
   }
 
-  if (i == 2) {
+  if (plays[1]) {
     double values[2];
-    card xhand[5];
-    h.current(xhand[0]);
     for (int j = 0; j < 2; ++j) {
-      values[j] = evaluate_play(xhand, h.size(), plays[j].result_vector, deuces,
-                                left, parms);
+      values[j] = evaluate_play(hand, hand_size, *plays[j], deuces, left, parms);
     }
     const double delta = (values[0] - values[1]) * multiplier;
-    accum[std::make_pair(plays[0].index, plays[1].index)] += delta;
+    accum[std::make_pair<int, int>(plays[0]->line, plays[1]->line)] += delta;
   }
 
   // Undo the remove at the beginning of the routine.
-  left.replace(matcher.hand, matcher.hand_size, deuces);
+  left.replace(hand, hand_size, deuces);
 }
 
 struct sort_compare {
@@ -758,12 +732,13 @@ struct sort_compare {
 };
 
 void prune_strategy(const vp_game &game, StrategyLine *lines[],
-                    std::size_t *strategy_length, const char *filename) {
+                    const match_index &index, const char *filename) {
   int counter = 0;
   int timer = 0;
 
   game_parameters parms(game);
   C_left left(parms);
+  const std::unique_ptr<hand_table> table = hand_table::open(parms.kind);
 
   const int total_hands = combin.choose(parms.deck_size, 5);
 
@@ -782,32 +757,33 @@ void prune_strategy(const vp_game &game, StrategyLine *lines[],
 
   for (int wild_cards = 0; wild_cards <= parms.number_wild_cards;
        wild_cards++) {
-    const int hand_size = 5 - wild_cards;
-    hand_iter iter(hand_size, parms.kind, wild_cards);
+    const std::span<const hand_record> hands = table->hands(wild_cards);
 
     const int wmult = combin.choose(parms.number_wild_cards, wild_cards);
 
     StrategyLine *strategy_w = lines[wild_cards];
-    std::size_t strategy_l = strategy_length[wild_cards];
 
     prune_data accum;
 
-    while (!iter.done()) {
-      if (++timer > 102359 / 40) {
-        printf(".");
-        timer = 0;
-      }
-
-      const int mult = wmult * iter.multiplier();
-      double multiplier = (double)mult / double(total_hands);
+    {
+      instrument::phase_timer enumeration(instrument::enumeration);
+      for (std::size_t hand = 0; hand < hands.size(); hand++) {
+        if (++timer > 102359 / 40) {
+          printf(".");
+          timer = 0;
+        }
 
-      evaluate_for_prune(iter, wild_cards, left, strategy_w, strategy_l, parms,
-                         multiplier, accum);
-      counter += mult;
+        const int mult = wmult * hands[hand].multiplier;
+        double multiplier = (double)mult / double(total_hands);
 
-      iter.next();
+        evaluate_for_prune(hands[hand], wild_cards, left,
+                           index.matches(wild_cards, hand), parms, multiplier,
+                           accum);
+        counter += mult;
+      }
     }
 
+    instrument::phase_timer report(instrument::report_writing);
     fprintf(output, "Least useful rules for %d wild\n", wild_cards);
     std::vector<prune_data::const_iterator> result;
     for (prune_data::const_iterator iter = accum.begin(); iter != accum.end();
@@ -835,17 +811,17 @@ void prune_strategy(const vp_game &game, StrategyLine *lines[],
 
 typedef double prob_vector[last_pay + 1];
 
-static void evaluate(hand_iter &h, int deuces, C_left &left,
+static void evaluate(const hand_record &r, int deuces, C_left &left,
                      game_parameters &parms, double multiplier,
                      prob_vector &prob_pays) {
   // Compute the expected value of an initial five-card hand
-  // consisting of the cards returned by the iterator plus
-  // the indicated number of deuces.
+  // consisting of the cards of the record plus the indicated
+  // number of deuces.
 
   card hand[5];
-
-  h.current(hand[0]);
   const int hand_size = 5 - deuces;
+  std::copy_n(r.cards, hand_size, hand);
+  instrument::count(instrument::hands_visited);
 
   left.remove(hand, hand_size, deuces);
   // Subtract the hand to be evaluated from the left structure
@@ -942,6 +918,7 @@ void eval_game(const vp_game &game, prob_vector &prob_pays) {
 
   game_parameters parms(game);
   C_left left(parms);
+  const std::unique_ptr<hand_table> table = hand_table::open(parms.kind);
 
   printf("Evaluating optimal return for %s\n", game.name);
 
@@ -955,26 +932,21 @@ void eval_game(const vp_game &game, prob_vector &prob_pays) {
 
   for (int wild_cards = 0; wild_cards <= parms.number_wild_cards;
        wild_cards++) {
-    const int hand_size = 5 - wild_cards;
-    hand_iter iter(hand_size, parms.kind, wild_cards);
-
     const int wmult = combin.choose(parms.number_wild_cards, wild_cards);
 
-    while (!iter.done()) {
+    for (const hand_record &r : table->hands(wild_cards)) {
       if (++timer > 102359 / 40) {
         printf(".");
         timer = 0;
       }
 
-      const int mult = wmult * iter.multiplier();
+      const int mult = wmult * r.multiplier;
 
-      evaluate(iter, wild_cards, left, parms,
+      evaluate(r, wild_cards, left, parms,
                static_cast<double>(mult) / static_cast<double>(total_hands),
                prob_pays);
 
       counter += mult;
-
-      iter.next();
     }
   }
 
@@ -985,39 +957,6 @@ void eval_game(const vp_game &game, prob_vector &prob_pays) {
   }
 }
 
-typedef struct {
-  double abs, rel;
-} ppair;
-
-// outcome is a file-scope linked list. Allocating a new outcome object
-// pushes it onto the front of the list.
-struct outcome {
-  const char *name;
-  double abs, rel;
-  ppair *const prob;  // pointer to a dynamic array of ppairs
-
-  outcome *next;
-  static outcome *first;
-
-  outcome(const char *n, int goal)
-      : name(n), prob(new ppair[goal]), next(first) {
-    first = this;
-  }
-  ~outcome() { delete[] prob; }
-};
-
-// Initialize the list of outcomes to empty.
-outcome *outcome::first = nullptr;
-
-// Free all the outcomes that have been allocated.
-static void free_outcomes() {
-  while (outcome::first) {
-    outcome *const next = outcome::first->next;
-    delete outcome::first;
-    outcome::first = next;
-  }
-}
-
 // The pay tables were defined as doubles, since I guess one could imagine a
 // game that pays a nonintegral fraction of a bet.  However, a lot of the
 // algorithms in this file assume a payout is integral. This function converts a
@@ -1030,66 +969,9 @@ static int double_to_int(double x) {
 
 void median_length(FILE *output, game_parameters &game, prob_vector &prob_pays,
                    int starting_bankroll, int goal) {
-  double *current = new double[goal];
-  double *next = new double[goal];
-
-  for (int j = 0; j < goal; j++) {
-    current[j] = 0.0;
-  }
-  current[starting_bankroll] = 1.0;
-
-  int game_number;
-
-  for (game_number = 1;; game_number++) {
-    for (int j = 1; j < goal; j++) {
-      next[j] = 0.0;
-    }
-    next[0] = current[0];
-
-    for (int bankroll = 1; bankroll < goal; bankroll++) {
-      for (int p = first_pay; p <= last_pay; p++) {
-        double pp = prob_pays[p];
-        if (pp != 0.0) {
-          pp *= current[bankroll];
-
-          int new_roll = bankroll - 1 + double_to_int(game.pay_table[p]);
-          _ASSERT(new_roll >= 0);
-          if (new_roll >= goal) {
-            new_roll = 0;
-          }
-          // next[0] is the probability that we stop,
-          // either because we ran out of money or because
-          // we doubled it.
-
-          next[new_roll] += pp;
-        }
-      }
-    }
-
-    if (next[0] >= 0.5) {
-      break;
-    }
-
-    {
-      double *temp = next;
-      next = current, current = temp;
-    }
-  }
-
-  // next[0] is the probability that we will stop after game_number games.
-  // current[0] is the probability that we will stop after game_number-1 games.
-  // Which is closer to .5?
-
-  _ASSERT(current[0] < 0.5);
-
-  if (0.5 - current[0] > next[0] - 0.5) {
-    game_number -= 1;
-  }
-
-  fprintf(output, "Median number of games: %d\n", game_number);
-
-  delete current;
-  delete next;
+  const bankroll_chain chain(prob_pays, game.pay_table, goal);
+  fprintf(output, "Median number of games: %d\n",
+          chain.median_length(starting_bankroll));
 }
 
 static double ror_func(double r, prob_vector &prob_pays,
@@ -1158,82 +1040,24 @@ void risk_of_ruin(FILE *output, game_parameters &game, prob_vector &prob_pays) {
   fprintf(output, "50%% RoR = $%.2f\n", 1.25 * log(.50) / log_r);
 }
 
-double bust_prob(game_parameters &game, prob_vector &prob_pays,
-                 int initial_bankroll, int goal) {
-  if (goal <= initial_bankroll) {
-    return 0.0;
-  }
-  _ASSERT(goal >= 2);
-  vector<double> rel_vec(goal, 0.0);
-
-  for (int j = goal - 1; j > 0; j--) {
-    double push = 0.0;
-    double smaller = 0.0;
-
-    for (int k = 0; k <= last_pay; k++) {
-      const double prob = prob_pays[k];
-      const int pay = double_to_int(game.pay_table[k]);
+// Prints the largest goal that has at most an even chance of going bust
+// for each of a range of bankrolls, all found in one sweep.
+static std::vector<int> break_even_table(FILE *output, ruin_solver &ruin) {
+  static const int bankrolls[] = {8, 16, 40, 80, 160, 400, 800};
+  const std::vector<int> goals =
+      ruin.break_even_goals(bankrolls[std::size(bankrolls) - 1]);
 
-      if (pay == 0) {
-        // We drop down to a bankroll of j-1
-        smaller += prob;
-      } else if (pay == 1) {
-        push += prob;
-      } else {
-        const int bigger = j + pay - 1;
-        if (bigger < goal) {
-          push += prob * rel_vec[bigger];
-        }
-      }
-    }
-
-    const double not_push = 1.0 - push;
-    smaller /= not_push;
-
-    rel_vec[j] = smaller;
-
-    for (int m = goal - 1; m > j; m--) {
-      rel_vec[m] *= smaller;
-    }
+  fprintf(output, "\nBreak even goals\n");
+  for (const int bankroll : bankrolls) {
+    fprintf(output, "$%.2f -> $%.2f\n", 1.25 * bankroll,
+            1.25 * goals[bankroll]);
   }
-
-  const double result = rel_vec[initial_bankroll];
-
-  return result;
-}
-
-int break_even_goal(game_parameters &game, prob_vector &prob_pays,
-                    int initial_bankroll) {
-  // Find a goal for which the bust probability is > 0.5
-  int winnings = 1;
-  while (bust_prob(game, prob_pays, initial_bankroll,
-                   initial_bankroll + winnings) <= 0.5) {
-    winnings *= 2;
-  }
-
-  // Use binary search to find the largest goal
-  // whose bust probability is <= 0.5
-  int left = initial_bankroll;              // bust prob == 0
-  int right = initial_bankroll + winnings;  // bust_prob > 0.5
-  // note: left < right
-  for (;;) {
-    // Invariant: bust probability of left is <= 0.5
-    //            bust probablity of right is > 0.5
-    const int mid = (left + right) / 2;
-    if (mid == left) break;
-    if (bust_prob(game, prob_pays, initial_bankroll, mid) <= 0.5) {
-      left = mid;
-    } else {
-      right = mid;
-    }
-  }
-  return left;
+  return goals;
 }
 
 void eval_bankroll(FILE *output, game_parameters &game, prob_vector &prob_pays,
                    int initial_bankroll, int goal) {
   _ASSERT(goal >= initial_bankroll);
-  _ASSERT(outcome::first == NULL);
 
   char goal_name[20];
   if (goal % 4 == 0) {
@@ -1242,49 +1066,40 @@ void eval_bankroll(FILE *output, game_parameters &game, prob_vector &prob_pays,
     sprintf(goal_name, "Reach $%.2f", static_cast<double>(goal) / 4.0 * 5.0);
   }
 
-  // Find the max payout in the pay table.
-  int max_pay = 0;
-  for (int j = first_pay; j <= last_pay; j++) {
-    if (game.pay_table[j] >= max_pay) {
-      max_pay = double_to_int(game.pay_table[j]);
-    }
-  }
-
-  _ASSERT(max_pay >= 2);
-
-  // Create a separate outcome for each of the values
-  // by which we can hit when we reach the goal.
-  //
-  vector<outcome *> reach_goal;
-  reach_goal.reserve(max_pay - 1);
-  for (int j = 0; j < max_pay - 1; j++) {
-    reach_goal.push_back(new outcome(0, goal));
-  }
-
-  outcome *dvect[last_pay + 1];
-  outcome *bust = new outcome("Bust", goal);
-  outcome *hard_double = new outcome(goal_name, goal);
-  outcome *rover;
-
-  // Count the number of pays that push you over the top immediately
-  for (int j = first_pay; j <= last_pay; j++) {
-    dvect[j] =
-        game.pay_table[j] >= goal ? new outcome(payoff_image[j], goal) : 0;
-  }
+  // The outcomes reported, in the order they are printed.  A payoff that
+  // pushes you over the top immediately gets its own outcome, and every
+  // other way of reaching the goal counts as the goal.  The last outcome
+  // is not a probability, but the bankroll when the goal is reached
+  // times its probability, so that it adds up to the average cashout.
+  std::vector<const char *> names;
+  int reach[last_pay + 1];
+  for (int j = last_pay; j >= first_pay; j--) {
+    reach[j] = -1;
+    if (game.pay_table[j] >= goal) {
+      reach[j] = static_cast<int>(names.size());
+      names.push_back(payoff_image[j]);
+    }
+  }
+  const int hard_double = static_cast<int>(names.size());
+  names.push_back(goal_name);
+  const int cashout = static_cast<int>(names.size());
+  const int num_outcomes = cashout + 1;
+
+  // Invariant, for j in the loop below:
+  // Let P be the chance of going bust with j bets.
+  // Then for x > j, the chance of outcome o with x bets is
+  // abs_probs[o][x] + P * rel[x].  Since the chain from x down to j
+  // is the same whatever the outcome, rel is the same for all of them,
+  // and bust is the outcome with no abs_probs.
+  std::vector<std::vector<double>> abs_probs(
+      num_outcomes, std::vector<double>(goal, 0.0));
+  std::vector<double> rel(goal, 0.0);
+  std::vector<double> sum_abs(num_outcomes);
 
   for (int j = goal - 1; j > 0; j--) {
-    // Invariant:
-    // Let P be the chance of going bust with j bets.
-    // Then for x > j, the chance of going bust with x
-    // bets is bust[x].abs + P * bust[x].rel.
-
     // Compute P
-
-    for (rover = outcome::first; rover; rover = rover->next) {
-      rover->abs = 0.0;
-      rover->rel = 0.0;
-    }
-
+    std::fill(sum_abs.begin(), sum_abs.end(), 0.0);
+    double sum_rel = 0.0;
     double smaller = 0.0;
 
     for (int k = 0; k <= last_pay; k++) {
@@ -1295,24 +1110,20 @@ void eval_bankroll(FILE *output, game_parameters &game, prob_vector &prob_pays,
         // We drop down to a bankroll of j-1
         smaller += prob;
       } else if (pay == 1) {
-        for (rover = outcome::first; rover; rover = rover->next) {
-          rover->rel += prob;
-        }
+        sum_rel += prob;
       } else {
         const int bigger = j + pay - 1;
 
         if (bigger >= goal) {
-          (dvect[k] ? dvect[k] : hard_double)->abs += prob;
-
-          _ASSERT(bigger - goal < max_pay - 1);
-          reach_goal[bigger - goal]->abs += prob;
+          sum_abs[reach[k] >= 0 ? reach[k] : hard_double] += prob;
+          sum_abs[cashout] += prob * bigger;
         } else {
-          for (rover = outcome::first; rover; rover = rover->next) {
-            // Add in the chances of getting the corresponding
-            // outcome with the bigger bankroll
-            rover->abs += prob * rover->prob[bigger].abs;
-            rover->rel += prob * rover->prob[bigger].rel;
+          // Add in the chances of getting each outcome
+          // with the bigger bankroll
+          for (int o = 0; o < num_outcomes; o++) {
+            sum_abs[o] += prob * abs_probs[o][bigger];
           }
+          sum_rel += prob * rel[bigger];
         }
       }
     }
@@ -1324,28 +1135,27 @@ void eval_bankroll(FILE *output, game_parameters &game, prob_vector &prob_pays,
     // P - rel * P = abs + smaller * P2
     // P = abs / (1.0 - rel) + smaller / (1.0 - rel) * P2
 
-    for (rover = outcome::first; rover; rover = rover->next) {
-      const double not_rel = 1.0 - rover->rel;
-      const double abs = rover->abs / not_rel;
-      const double rel = smaller / not_rel;
-
-      rover->prob[j].abs = abs;
-      rover->prob[j].rel = rel;
-
-      // Now to reestablish the invariant, substitute abs + rel * P2
-      // for P1 in the equation
-      //  bust[m].abs + bust[m].rel * P1, for m in the range j+1..goal-1
+    const double not_rel = 1.0 - sum_rel;
+    const double rel_j = smaller / not_rel;
+    rel[j] = rel_j;
 
-      for (int m = goal - 1; m > j; m--) {
-        rover->prob[m].abs += rover->prob[m].rel * abs;
-        rover->prob[m].rel *= rel;
-      }
+    // Now to reestablish the invariant, substitute abs + rel * P2
+    // for P in abs_probs[o][m] + rel[m] * P, for m in j+1..goal-1
+    const std::size_t above = goal - 1 - j;
+    for (int o = 0; o < num_outcomes; o++) {
+      const double abs_j = sum_abs[o] / not_rel;
+      abs_probs[o][j] = abs_j;
+      add_scaled(abs_probs[o].data() + j + 1, rel.data() + j + 1, abs_j,
+                 above);
+    }
+    for (int m = goal - 1; m > j; m--) {
+      rel[m] *= rel_j;
     }
   }
 
   // The probability of going bust with a bankroll of zero is 1.0.
   // Therefore the probability of going bust with bankroll of x > 0
-  // is bust[x].rel + bust[x].abs
+  // is rel[x].
 
   if (initial_bankroll == 0) {
     // Compute the initial bankroll that gives a 50=50 chance
@@ -1355,7 +1165,7 @@ void eval_bankroll(FILE *output, game_parameters &game, prob_vector &prob_pays,
     double sum;
 
     for (int j = 1;; j++) {
-      sum = bust->prob[j].abs + bust->prob[j].rel;
+      sum = rel[j];
 
       if (sum <= 0.5 || j == goal - 1) {
         if (j > 1 && prev - 0.5 > 0.5 - sum) {
@@ -1379,23 +1189,13 @@ void eval_bankroll(FILE *output, game_parameters &game, prob_vector &prob_pays,
       fprintf(output, "$%.2f\n", 1.25 * (double)k);
     }
 
-    for (rover = outcome::first; rover; rover = rover->next)
-      if (rover->name) {
-        double p = rover == bust ? rover->prob[k].abs + rover->prob[k].rel
-                                 : rover->prob[k].abs;
-
-        fprintf(output, "%5.2f%% %s\n", 100.0 * p, rover->name);
-      }
-
-    // Compute the expected value of the whole thing
-    double ev = 0.0;
-    for (int j = 0; j < max_pay - 1; j++) {
-      ev += reach_goal[j]->prob[k].abs * (double)(goal + j);
+    for (int o = 0; o < cashout; o++) {
+      fprintf(output, "%5.2f%% %s\n", 100.0 * abs_probs[o][k], names[o]);
     }
-    fprintf(output, "Average cashout $%.2f\n", ev * 1.25);
+    fprintf(output, "%5.2f%% %s\n", 100.0 * rel[k], "Bust");
 
-    // Free all the storage we used
-    free_outcomes();
+    // The expected value of the whole thing
+    fprintf(output, "Average cashout $%.2f\n", abs_probs[cashout][k] * 1.25);
   }
 
   median_length(output, game, prob_pays, initial_bankroll, goal);
@@ -1546,44 +1346,30 @@ struct vstate {
   prob_vector prob_pays;
 };
 
-static void variance(hand_iter &h, int deuces, C_left &left,
-                     StrategyLine *lines, vstate &e, game_parameters &parms) {
+static void variance(const hand_record &r, int deuces, C_left &left,
+                     std::span<const line_match> found, vstate &e,
+                     game_parameters &parms) {
   // Compute the probability distribution of an initial five-card
-  // hand consisting of the cards returned by the iterator plus
-  // the indicated number of deuces.
-
-  EnumerateMatches matcher;
-  matcher.wild_cards = deuces;
-  matcher.parms = &parms;
+  // hand consisting of the cards of the record plus the indicated
+  // number of deuces.
 
-  matcher.hand_size = h.size();
-  h.current(matcher.hand[0]);
+  card hand[5];
+  const int hand_size = 5 - deuces;
+  std::copy_n(r.cards, hand_size, hand);
+  instrument::count(instrument::hands_visited);
 
   const bool trace = false;
 
-  left.remove(matcher.hand, matcher.hand_size, deuces);
+  left.remove(hand, hand_size, deuces);
   // Subtract the hand to be evaluated from the left structure
 
-  StrategyLine *best_strategy = lines;
-
-  // Incrementing the binary mask iterates over all
-  // 2^hand_size combinations of cards to be kept.
-
-  for (;;) {
-    matcher.find(best_strategy->pattern);
-    if (matcher.match_count != 0) {
-      break;
-    }
-
-    best_strategy += 1;
-  }
-
-  unsigned mask = matcher.matches[0];
+  // Play the first matching strategy line.
+  unsigned mask = found[0].first;
   // If the strategy can suggest more than one play, the distribution
   // can differ depending on which play we take.  Someday write code to
   // test for this corner case and object to the strategy.
 
-  kept_description kept(matcher.hand, matcher.hand_size, mask, parms);
+  kept_description kept(hand, hand_size, mask, parms);
   // Build the description of subset of the hand
   // indicated by mask.
 
@@ -1610,60 +1396,48 @@ static void variance(hand_iter &h, int deuces, C_left &left,
 
   _ASSERT(total_pays == m1);
 
-  left.replace(matcher.hand, matcher.hand_size, deuces);
+  left.replace(hand, hand_size, deuces);
 }
 
-void box_score(const vp_game &game, StrategyLine *lines[],
-               const char *filename) {
+// Plays the strategy on every starting hand, adding up the chances of
+// each payoff into v.prob_pays.
+static void play_strategy(game_parameters &parms, const match_index &index,
+                          vstate &v) {
   int counter = 0;
   int timer = 0;
 
-  game_parameters parms(game);
   C_left left(parms);
+  const std::unique_ptr<hand_table> table = hand_table::open(parms.kind);
 
   const int total_hands = combin.choose(parms.deck_size, 5);
 
-  vstate v;
-  {
-    for (int j = first_pay; j <= last_pay; j++) {
-      v.prob_pays[j] = 0.0;
-    }
-  }
-
-  printf("Evaluating strategy for %s\n", game.name);
-
-  FILE *output = fopen(filename, "w");
-  if (output == 0) {
-    printf("fopen failed\n");
-    throw 0;
+  for (int j = first_pay; j <= last_pay; j++) {
+    v.prob_pays[j] = 0.0;
   }
 
-  fprintf(output, "Box Score for %s\n\n", game.name);
-
   printf("Computing");
 
   for (int wild_cards = 0; wild_cards <= parms.number_wild_cards;
        wild_cards++) {
-    const int hand_size = 5 - wild_cards;
-    hand_iter iter(hand_size, parms.kind, wild_cards);
+    const std::span<const hand_record> hands = table->hands(wild_cards);
 
     const int wmult = combin.choose(parms.number_wild_cards, wild_cards);
 
-    StrategyLine *strategy_w = lines[wild_cards];
-
-    while (!iter.done()) {
-      if (++timer > 102359 / 40) {
-        printf(".");
-        timer = 0;
-      }
-
-      const int mult = wmult * iter.multiplier();
-      v.multiplier = (double)mult / (double)total_hands;
+    {
+      instrument::phase_timer enumeration(instrument::enumeration);
+      for (std::size_t hand = 0; hand < hands.size(); hand++) {
+        if (++timer > 102359 / 40) {
+          printf(".");
+          timer = 0;
+        }
 
-      variance(iter, wild_cards, left, strategy_w, v, parms);
-      counter += mult;
+        const int mult = wmult * hands[hand].multiplier;
+        v.multiplier = (double)mult / (double)total_hands;
 
-      iter.next();
+        variance(hands[hand], wild_cards, left,
+                 index.matches(wild_cards, hand), v, parms);
+        counter += mult;
+      }
     }
   }
 
@@ -1672,7 +1446,26 @@ void box_score(const vp_game &game, StrategyLine *lines[],
     printf("Iteration counter wrong\n");
     throw 0;
   }
+}
+
+void box_score(const vp_game &game, const match_index &index,
+               const char *filename) {
+  game_parameters parms(game);
+  vstate v;
+
+  printf("Evaluating strategy for %s\n", game.name);
+
+  FILE *output = fopen(filename, "w");
+  if (output == 0) {
+    printf("fopen failed\n");
+    throw 0;
+  }
+
+  fprintf(output, "Box Score for %s\n\n", game.name);
 
+  play_strategy(parms, index, v);
+
+  instrument::phase_timer report(instrument::report_writing);
   {
     double ev = 0.0;
 #if 0
@@ -1732,13 +1525,13 @@ void box_score(const vp_game &game, StrategyLine *lines[],
   }
 
   risk_of_ruin(output, parms, v.prob_pays);
+  ruin_solver ruin(v.prob_pays, parms.pay_table);
+  const std::vector<int> break_even = break_even_table(output, ruin);
 
   eval_bankroll(output, parms, v.prob_pays, 16, 32);
-  eval_bankroll(output, parms, v.prob_pays, 16,
-                break_even_goal(parms, v.prob_pays, 16));
+  eval_bankroll(output, parms, v.prob_pays, 16, break_even[16]);
   eval_bankroll(output, parms, v.prob_pays, 80, 160);
-  eval_bankroll(output, parms, v.prob_pays, 80,
-                break_even_goal(parms, v.prob_pays, 80));
+  eval_bankroll(output, parms, v.prob_pays, 80, break_even[80]);
 
   eval_bankroll(output, parms, v.prob_pays, 0, 800);
   if ((*game.pay_table)[N_royal_flush] > 800) {
@@ -1750,22 +1543,10 @@ void box_score(const vp_game &game, StrategyLine *lines[],
   printf("Report is in %s\n", filename);
 }
 
-void half_life(const vp_game &game, StrategyLine *lines[],
+void half_life(const vp_game &game, const match_index &index,
                const char *filename) {
-  int counter = 0;
-  int timer = 0;
-
   game_parameters parms(game);
-  C_left left(parms);
-
-  const int total_hands = combin.choose(parms.deck_size, 5);
-
   vstate v;
-  {
-    for (int j = first_pay; j <= last_pay; j++) {
-      v.prob_pays[j] = 0.0;
-    }
-  }
 
   printf("Selecting a bankroll for %s\n", game.name);
 
@@ -1777,38 +1558,7 @@ void half_life(const vp_game &game, StrategyLine *lines[],
 
   fprintf(output, "Box Score for %s\n\n", game.name);
 
-  printf("Computing");
-
-  for (int wild_cards = 0; wild_cards <= parms.number_wild_cards;
-       wild_cards++) {
-    const int hand_size = 5 - wild_cards;
-    hand_iter iter(hand_size, parms.kind, wild_cards);
-
-    const int wmult = combin.choose(parms.number_wild_cards, wild_cards);
-
-    StrategyLine *strategy_w = lines[wild_cards];
-
-    while (!iter.done()) {
-      if (++timer > 102359 / 40) {
-        printf(".");
-        timer = 0;
-      }
-
-      const int mult = wmult * iter.multiplier();
-      v.multiplier = (double)mult / (double)total_hands;
-
-      variance(iter, wild_cards, left, strategy_w, v, parms);
-      counter += mult;
-
-      iter.next();
-    }
-  }
-
-  printf("\n");
-  if (counter != total_hands) {
-    printf("Iteration counter wrong\n");
-    throw 0;
-  }
+  play_strategy(parms, index, v);
 
   {
     double ev = 0.0;
@@ -1838,12 +1588,13 @@ void half_life(const vp_game &game, StrategyLine *lines[],
   }
 
   risk_of_ruin(output, parms, v.prob_pays);
+  ruin_solver ruin(v.prob_pays, parms.pay_table);
 
   // Use binary search to find the smallest bankroll that has a better
   // than 50-50 chance of doubling itself.
   int upper = 1;
   for (;;) {
-    const double bp = bust_prob(parms, v.prob_pays, upper, 2 * upper);
+    const double bp = ruin.bust_prob(upper, 2 * upper);
     if (bp < 0.5) {
       break;
     }
@@ -1855,7 +1606,7 @@ void half_life(const vp_game &game, StrategyLine *lines[],
     if (mid == lower) {
       break;
     }
-    const double bp = bust_prob(parms, v.prob_pays, mid, 2 * mid);
+    const double bp = ruin.bust_prob(mid, 2 * mid);
     if (bp < 0.5) {
       upper = mid;
     } else {
@@ -1873,6 +1624,52 @@ void half_life(const vp_game &game, StrategyLine *lines[],
   printf("Report is in %s\n", filename);
 }
 
+void bankroll_grid(const vp_game &game, const match_index &index,
+                   const grid_range &bankrolls, const grid_range &goals,
+                   const char *filename) {
+  game_parameters parms(game);
+  vstate v;
+
+  printf("Bankroll grid for %s\n", game.name);
+
+  FILE *output = fopen(filename, "w");
+  if (output == 0) {
+    printf("fopen failed\n");
+    throw 0;
+  }
+
+  play_strategy(parms, index, v);
+
+  instrument::phase_timer report(instrument::report_writing);
+
+  // Every cell's chances of going bust and of reaching the goal come from
+  // the one solver.  Each goal needs its own chain for the session
+  // lengths, but that chain gives them for every bankroll at once.
+  ruin_solver ruin(v.prob_pays, parms.pay_table);
+
+  fprintf(output, "bankroll,goal,bust,reach_goal,median_games\n");
+  for (const int goal : goals.values()) {
+    std::vector<int> lengths;
+    if (goal >= 2) {
+      lengths = bankroll_chain(v.prob_pays, parms.pay_table, goal)
+                    .median_lengths();
+    }
+
+    for (const int bankroll : bankrolls.values()) {
+      if (bankroll >= goal) {
+        // There is no session to play.
+        continue;
+      }
+      const double bust = ruin.bust_prob(bankroll, goal);
+      fprintf(output, "%d,%d,%.8f,%.8f,%d\n", bankroll, goal, bust,
+              1.0 - bust, lengths[bankroll]);
+    }
+  }
+
+  fclose(output);
+  printf("Report is in %s\n", filename);
+}
+
 void optimal_box_score(const vp_game &game, const char *filename) {
   game_parameters parms(game);
   prob_vector prob_pays;
@@ -1920,6 +1717,8 @@ void optimal_box_score(const vp_game &game, const char *filename) {
   }
 
   risk_of_ruin(output, parms, prob_pays);
+  ruin_solver ruin(prob_pays, parms.pay_table);
+  break_even_table(output, ruin);
 
   eval_bankroll(output, parms, prob_pays, 16, 32);
   eval_bankroll(output, parms, prob_pays, 80, 160);
@@ -1936,22 +1735,21 @@ void optimal_box_score(const vp_game &game, const char *filename) {
   printf("Report is in %s\n", filename);
 }
 
-static void union_evaluate(hand_iter &h, int deuces, C_left &left,
-                           const StrategyLine *lines, vector<bool> *used_lines,
-                           game_parameters &parms, FILE *output) {
+static void union_evaluate(const hand_record &r, int deuces, C_left &left,
+                           std::span<const line_match> found,
+                           vector<bool> *used_lines, game_parameters &parms,
+                           FILE *output) {
   // Compute the expected value of an initial five-card hand
-  // consisting of the cards returned by the iterator plus
-  // the indicated number of deuces.
-
-  EnumerateMatches matcher;
-  matcher.wild_cards = deuces;
-  matcher.parms = &parms;
+  // consisting of the cards of the record plus the indicated
+  // number of deuces.
 
-  matcher.hand_size = h.size();
-  h.current(matcher.hand[0]);
+  card hand[5];
+  const int hand_size = 5 - deuces;
+  std::copy_n(r.cards, hand_size, hand);
+  instrument::count(instrument::hands_visited);
 
   // Subtract the hand to be evaluated from the left structure
-  left.remove(matcher.hand, matcher.hand_size, deuces);
+  left.remove(hand, hand_size, deuces);
 
   struct Play {
     Play(unsigned mask, int deuces) : mask(mask), deuces(deuces) {}
@@ -1964,10 +1762,10 @@ static void union_evaluate(hand_iter &h, int deuces, C_left &left,
 
   // Incrementing the binary mask iterates over all
   // 2^hand_size combinations of cards to be kept.
-  const unsigned power = 1 << matcher.hand_size;
+  const unsigned power = 1 << hand_size;
   unsigned mask;
   for (mask = 0; mask < power; mask++) {
-    kept_description kept(matcher.hand, matcher.hand_size, mask, parms);
+    kept_description kept(hand, hand_size, mask, parms);
     // Build the description of subset of the hand
     // indicated by mask.
 
@@ -2018,17 +1816,17 @@ static void union_evaluate(hand_iter &h, int deuces, C_left &left,
   _ASSERT(best_value >= 0);
   _ASSERT(!best_plays.empty());
 
-  for (const StrategyLine *line = lines;
-       !best_plays.empty() && line->pattern != 0; ++line) {
-    matcher.find(line->pattern);
-
+  // Lines that match none of the plays can't mark anything, so only
+  // the matching lines need to be visited.
+  for (auto line = found.begin(); !best_plays.empty() && line != found.end();
+       ++line) {
     vector<Play>::iterator iter = best_plays.begin();
     while (iter != best_plays.end()) {
       // If the play matches the strategy line, mark the line as used,
       // and erase the play so only the first line will get marked, and
       // duplicate lines will be flagged.
-      if (matcher.result_vector[iter->mask]) {
-        (*used_lines)[line - lines] = true;
+      if (line->matches(iter->mask)) {
+        (*used_lines)[line->line] = true;
         iter = best_plays.erase(iter);
       } else {
         ++iter;
@@ -2040,10 +1838,10 @@ static void union_evaluate(hand_iter &h, int deuces, C_left &left,
   // Report it in the output.
   for (vector<Play>::const_iterator iter = best_plays.begin();
        iter != best_plays.end(); ++iter) {
-    print_move(output, matcher.hand, matcher.hand_size, iter->mask);
+    print_move(output, hand, hand_size, iter->mask);
   }
 
-  left.replace(matcher.hand, matcher.hand_size, deuces);
+  left.replace(hand, hand_size, deuces);
 }
 
 // Returns the number of entries in a strategy, not counting the sentinel
@@ -2057,10 +1855,11 @@ static std::size_t strategy_length(const StrategyLine *lines) {
 }
 
 void check_union(const vp_game &game, StrategyLine *lines[],
-                 const char *filename) {
+                 const match_index &index, const char *filename) {
   int timer = 0;
   game_parameters parms(game);
   C_left left(parms);
+  const std::unique_ptr<hand_table> table = hand_table::open(parms.kind);
 
   FILE *output = NULL;
   fopen_s(&output, filename, "w");
@@ -2071,20 +1870,21 @@ void check_union(const vp_game &game, StrategyLine *lines[],
 
   for (int wild_cards = 0; wild_cards <= parms.number_wild_cards;
        wild_cards++) {
-    const int hand_size = 5 - wild_cards;
-
     const StrategyLine *const wild_strategy = lines[wild_cards];
     vector<bool> used_lines(strategy_length(wild_strategy));
 
-    hand_iter iter(hand_size, parms.kind, wild_cards);
-    while (!iter.done()) {
-      if (++timer > 102359 / 40) {
-        printf(".");
-        timer = 0;
+    const std::span<const hand_record> hands = table->hands(wild_cards);
+    {
+      instrument::phase_timer enumeration(instrument::enumeration);
+      for (std::size_t hand = 0; hand < hands.size(); hand++) {
+        if (++timer > 102359 / 40) {
+          printf(".");
+          timer = 0;
+        }
+        union_evaluate(hands[hand], wild_cards, left,
+                       index.matches(wild_cards, hand), &used_lines, parms,
+                       output);
       }
-      union_evaluate(iter, wild_cards, left, wild_strategy, &used_lines, parms,
-                     output);
-      iter.next();
     }
 
     // Check if there are any unused lines, and if so, report them.
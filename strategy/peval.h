@@ -2,24 +2,36 @@
 #include <cstddef>
 
 #include "enum_match.h"
+#include "grid_command.h"
+#include "match_index.h"
+
+// The reports that play a strategy take the lines that match each hand
+// from the index, rather than matching the lines themselves.
 
 void eval_strategy(const vp_game &game, StrategyLine *lines[],
-                   const char *filename);
+                   const match_index &index, const char *filename);
 
-void multi_distribution(const vp_game &game, StrategyLine *lines[],
+void multi_distribution(const vp_game &game, const match_index &index,
                         unsigned int num_lines, unsigned int num_games,
                         const char *filename);
 
 void prune_strategy(const vp_game &game, StrategyLine *lines[],
-                    std::size_t *strategy_length, const char *filename);
+                    const match_index &index, const char *filename);
 
 void check_union(const vp_game &game, StrategyLine *lines[],
-                 const char *filename);
+                 const match_index &index, const char *filename);
 
-void box_score(const vp_game &game, StrategyLine *lines[],
+void box_score(const vp_game &game, const match_index &index,
                const char *filename);
 
-void half_life(const vp_game &game, StrategyLine *lines[],
+void half_life(const vp_game &game, const match_index &index,
                const char *filename);
 
+// Writes the chances of going bust and of reaching the goal, and the
+// median number of games, for every starting bankroll and goal in the
+// ranges, as CSV.
+void bankroll_grid(const vp_game &game, const match_index &index,
+                   const grid_range &bankrolls, const grid_range &goals,
+                   const char *filename);
+
 void optimal_box_score(const vp_game &game, const char *filename);
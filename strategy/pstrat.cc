@@ -2,23 +2,29 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <map>
 #include <set>
+#include <span>
 #include <string>
 #include <vector>
 
-#include "../shared/hand_iter.h"
 #include "combin.h"
+#include "compiled_match.h"
 #include "enum_match.h"
 #include "find_order.h"
 #include "game.h"
+#include "hand_table.h"
+#include "hold_kernel.h"
+#include "instrument.h"
 #include "kept.h"
 #include "vpoker.h"
+#include "workers.h"
 
 using std::vector;
 
-int counter = 0;
-
 struct move : public move_desc {
   char *the_name;
   char *name() { return the_name; }
@@ -35,14 +41,76 @@ struct strategy_move : public move_desc {
   char *name() { return s->image; };
 };
 
-class Evaluator {
+// The conflicts found by evaluating a run of consecutive hands,
+// identified by the numbers of the strategy lines.  Runs can be
+// evaluated in parallel, each into its own shard, and then merged in
+// order.  The weights of each conflict are kept in the order they were
+// found, so that merging adds them up in exactly the order a serial
+// evaluation would, and the output does not depend on the number of
+// threads.
+struct conflict_shard {
+  struct conflict {
+    std::vector<double> weights;
+    double max_weight = 0.0;
+    card hand[5] = {};
+    unsigned char mask = 0;
+    // The first hand with the largest weight, and the right play for it
+  };
+
+  // The strategy lines in the order they first matched a hand.
+  std::vector<std::size_t> lines;
+  std::vector<bool> seen;
+
+  // The calls of find for each line, counted only for --stats.
+  std::vector<std::uint64_t> finds;
+
+  // Indexed by the right line and then the wrong line.
+  std::map<std::pair<std::size_t, std::size_t>, conflict> conflicts;
+
+  void see(std::size_t line) {
+    if (!seen[line]) {
+      seen[line] = true;
+      lines.push_back(line);
+    }
+  }
+
+  void add(std::size_t right, std::size_t wrong, double weight,
+           const card *hand, int hand_size, unsigned mask) {
+    conflict &c = conflicts[std::make_pair(right, wrong)];
+    c.weights.push_back(weight);
+    if (weight > c.max_weight) {
+      c.max_weight = weight;
+      std::copy(hand, hand + hand_size, c.hand);
+      c.mask = static_cast<unsigned char>(mask);
+    }
+  }
+};
+
+// Builds the MoveList from the shards.
+class ConflictMerger {
  public:
-  Evaluator(int hand_size) : strategy(hand_size), trace_count(0) {};
+  ConflictMerger(int hand_size, StrategyLine *lines);
 
-  void evaluate(hand_iter &h, int deuces, C_left &left, StrategyLine *lines,
-                game_parameters &parms, FILE *file);
+  void merge(const conflict_shard &shard);
 
   MoveList strategy;
+
+ private:
+  strategy_move *get_move(std::size_t line);
+  move *get_move(char *name);
+
+  StrategyLine *lines;
+  move_set moves;  // for the string version
+  std::vector<strategy_move *> movies;
+};
+
+class Evaluator {
+ public:
+  Evaluator() : trace_count(0) {};
+
+  void evaluate(const hand_record &r, int deuces, C_left &left, StrategyLine *lines,
+                game_parameters &parms, conflict_shard &shard);
+
   StrategyLine *trace_line[2];
   int trace_count;
   FILE *trace_file[2];
@@ -59,19 +127,52 @@ class Evaluator {
 
   using EvalCache = CacheEntry[1 << 5];
 
-  double get_mask_value(unsigned char mask, EnumerateMatches &matcher,
+  double get_mask_value(unsigned char mask, CompiledMatcher &matcher,
                         EvalCache &cache, int keep_deuces,
                         game_parameters &parms, C_left &left);
-  strategy_move *get_move(std::size_t line, StrategyLine *s);
-  move *get_move(char *name);
 
   static void print_entry(FILE *f, CacheEntry &e, game_parameters &parms);
-
-  move_set moves;  // for the string version
-  std::vector<strategy_move *> movies;
 };
 
-move *Evaluator::get_move(char *name) {
+// The number of strategy lines, which end with a null pattern.
+static std::size_t count_lines(StrategyLine *lines) {
+  StrategyLine *rover = lines;
+  for (;;) {
+    unsigned char *pat = rover->pattern;
+    char *img = rover->image;
+
+    if ((img == 0) ^ (pat == 0)) {
+      printf("image/pat mismatch\n");
+      exit(0);
+    }
+
+    if (img == 0) {
+      break;
+    }
+
+    rover += 1;
+  }
+
+  return rover - lines;
+}
+
+ConflictMerger::ConflictMerger(int hand_size, StrategyLine *lines)
+    : strategy(hand_size), lines(lines), movies(count_lines(lines)) {}
+
+void ConflictMerger::merge(const conflict_shard &shard) {
+  // Create the moves in the order the lines first matched, as the
+  // serial evaluation did.
+  for (const std::size_t line : shard.lines) {
+    get_move(line);
+  }
+
+  for (const auto &[lines, c] : shard.conflicts) {
+    strategy.add_conflicts(get_move(lines.first), get_move(lines.second),
+                           c.weights, c.max_weight, c.hand, c.mask);
+  }
+}
+
+move *ConflictMerger::get_move(char *name) {
   // Create a template move and attempt to add it to the set.
   std::pair<move_set::iterator, bool> x = moves.insert(move(name));
 
@@ -90,11 +191,11 @@ move *Evaluator::get_move(char *name) {
   return result;
 };
 
-strategy_move *Evaluator::get_move(std::size_t line, StrategyLine *s) {
+strategy_move *ConflictMerger::get_move(std::size_t line) {
   strategy_move *result = movies[line];
   if (result == 0) {
     result = new strategy_move;
-    result->s = s;
+    result->s = lines + line;
     result->line = line;
     movies[line] = result;
     strategy.add_move(result);
@@ -103,7 +204,7 @@ strategy_move *Evaluator::get_move(std::size_t line, StrategyLine *s) {
 }
 
 struct move_data {
-  move_desc *move;
+  std::size_t line;
   unsigned char mask;
   double best, worst;
 };
@@ -128,29 +229,21 @@ void Evaluator::print_entry(FILE *f, CacheEntry &e, game_parameters &parms) {
   fprintf(f, "\n");
 };
 
-double Evaluator::get_mask_value(unsigned char mask, EnumerateMatches &matcher,
+double Evaluator::get_mask_value(unsigned char mask, CompiledMatcher &matcher,
                                  EvalCache &cache, int keep_deuces,
                                  game_parameters &parms, C_left &left) {
   if (cache[mask].valid) {
+    instrument::count(instrument::eval_cache_hits);
     return cache[mask].value * multiplier;
   }
+  instrument::count(instrument::eval_cache_misses);
 
   pay_dist &pays = cache[mask].pays;
 
   kept_description(matcher.hand, matcher.hand_size, mask, parms)
       .all_draws(keep_deuces, left, pays);
 
-  int total_pays = 0;
-  double result = 0.0;
-
-  for (int j = first_pay; j <= last_pay; j++) {
-    const int pay = pays[j];
-    total_pays += pay;
-    result += (double)pay * parms.pay_table[j];
-  }
-
-  const double current_total = (double)total_pays;
-  const double value = result / current_total;
+  const double value = play_value(pays, parms.pay_table);
 
   cache[mask].value = value;
   cache[mask].valid = true;
@@ -158,17 +251,18 @@ double Evaluator::get_mask_value(unsigned char mask, EnumerateMatches &matcher,
   return value * multiplier;
 }
 
-void Evaluator::evaluate(hand_iter &h, int deuces, C_left &left,
+void Evaluator::evaluate(const hand_record &r, int deuces, C_left &left,
                          StrategyLine *lines, game_parameters &parms,
-                         FILE *file) {
+                         conflict_shard &shard) {
   // Compute the expected value of an initial five-card hand
-  // consisting of the cards returned by the iterator plus
-  // the indicated number of deuces.
+  // consisting of the cards of the record plus the indicated
+  // number of deuces.
 
-  EnumerateMatches matcher;
+  CompiledMatcher matcher;
 
-  matcher.hand_size = h.size();
-  h.current(matcher.hand[0]);
+  matcher.hand_size = 5 - deuces;
+  std::copy_n(r.cards, matcher.hand_size, matcher.hand);
+  instrument::count(instrument::hands_visited);
   matcher.wild_cards = deuces;
   matcher.parms = &parms;
 
@@ -177,27 +271,9 @@ void Evaluator::evaluate(hand_iter &h, int deuces, C_left &left,
   left.remove(matcher.hand, matcher.hand_size, deuces);
   // Subtract the hand to be evaluated from the left structure
 
-  // Count the number of valid strategy lines so we can set
-  // the size of movies to that.
-  {
-    StrategyLine *rover = lines;
-    for (;;) {
-      unsigned char *pat = rover->pattern;
-      char *img = rover->image;
-
-      if ((img == 0) ^ (pat == 0)) {
-        printf("image/pat mismatch\n");
-        exit(0);
-      }
-
-      if (img == 0) {
-        break;
-      }
-
-      rover += 1;
-    }
-
-    movies.resize(rover - lines);
+  if (shard.seen.empty()) {
+    shard.seen.resize(count_lines(lines));
+    shard.finds.resize(shard.seen.size());
   }
 
   // Incrementing the binary mask iterates over all
@@ -219,8 +295,6 @@ void Evaluator::evaluate(hand_iter &h, int deuces, C_left &left,
 
   unsigned trace_mask[2];
 
-  counter += 1;
-
   std::vector<move_data> good_move;
   std::vector<move_data> bad_move;
   double best_value = 0.0;
@@ -228,7 +302,10 @@ void Evaluator::evaluate(hand_iter &h, int deuces, C_left &left,
   bool simple_trace = false;
 
   while (rover->pattern) {
-    matcher.find(rover->pattern);
+    matcher.find(*rover);
+    if (instrument::enabled) {
+      shard.finds[rover - lines] += 1;
+    }
 
     if (matcher.match_count != 0) {
       if (trace_count == 2) {
@@ -249,10 +326,10 @@ void Evaluator::evaluate(hand_iter &h, int deuces, C_left &left,
         simple_trace = true;
       }
 
-      move_desc *this_move = get_move(rover - lines, rover);
+      shard.see(rover - lines);
 
       move_data md;
-      md.move = get_move(rover - lines, rover);
+      md.line = rover - lines;
       md.mask = matcher.matches[0];
       md.best = get_mask_value(matcher.matches[0], matcher, cache, deuces,
                                parms, left);
@@ -325,32 +402,73 @@ void Evaluator::evaluate(hand_iter &h, int deuces, C_left &left,
 
   if (simple_trace) {
     print_hand(trace_file[0], matcher.hand, matcher.hand_size);
-    fprintf(trace_file[0], "%s\n\n", good_move[0].move->name());
+    fprintf(trace_file[0], "%s\n\n", lines[good_move[0].line].image);
   }
 
   const move_data &g = good_move[0];
   for (const move_data &b : bad_move) {
-    strategy.add_conflict(g.move, b.move, g.worst - b.worst, matcher.hand,
-                          g.mask);
+    const double weight = g.worst - b.worst;
+    if (weight < 0.0) {
+      print_hand(stdout, matcher.hand, 5);
+      printf("right = %s\n", lines[g.line].image);
+      printf("wrong = %s\n", lines[b.line].image);
+      printf("weight = %.5f\n", weight);
+      throw 0;
+    }
+
+    shard.add(g.line, b.line, weight, matcher.hand, matcher.hand_size, g.mask);
   }
 
-  if (0) {
-    print_hand(file, matcher.hand, matcher.hand_size);
+  left.replace(matcher.hand, matcher.hand_size, deuces);
+}
 
-    fprintf(file, "good: %s\n", good_move.front().move->name());
-    for (const move_data &b : bad_move) {
-      fprintf(file, "bad: %s\n", b.move->name());
-    }
-    fprintf(file, "\n");
+namespace {
+// The data owned by each thread that evaluates hands.
+struct strategy_worker {
+  game_parameters parms;
+  C_left left;
+  Evaluator evaluator;
+
+  strategy_worker(const vp_game &game, const Evaluator &prototype)
+      : parms(game), left(parms), evaluator(prototype) {}
+};
+
+// The number of runs the hands for each number of wild cards are
+// split into.  It does not affect the results.
+const int runs_per_pass = 256;
+
+// Divides hands into k consecutive runs, each covering about the same
+// number of dealt hands (the sum of the multipliers), as
+// hand_iter::split does.  Some runs may be empty if k is large.
+std::vector<std::span<const hand_record>> split_hands(
+    std::span<const hand_record> hands, int k) {
+  unsigned long long total = 0;
+  for (const hand_record &r : hands) {
+    total += r.multiplier;
   }
 
-  left.replace(matcher.hand, matcher.hand_size, deuces);
+  std::vector<std::span<const hand_record>> result;
+  std::size_t begin = 0, end = 0;
+  unsigned long long dealt = 0;
+  for (int j = 1; j <= k; j++) {
+    const unsigned long long target = total * j / k;
+    while (end < hands.size() && dealt + hands[end].multiplier <= target) {
+      dealt += hands[end++].multiplier;
+    }
+    if (j == k) {
+      end = hands.size();
+    }
+    result.push_back(hands.subspan(begin, end - begin));
+    begin = end;
+  }
+  return result;
 }
+}  // namespace
 
 void find_strategy(const vp_game &game, const char *filename,
-                   StrategyLine *lines[], bool print_haas, bool print_value) {
-  int counter = 0;
-  int timer = 0;
+                   StrategyLine *lines[], bool print_haas, bool print_value,
+                   unsigned threads) {
+  std::atomic<int> counter = 0;
 
   FILE *output = NULL;
   fopen_s(&output, filename, "w");
@@ -360,7 +478,7 @@ void find_strategy(const vp_game &game, const char *filename,
   }
 
   game_parameters parms(game);
-  C_left left(parms);
+  const std::unique_ptr<hand_table> table = hand_table::open(parms.kind);
 
   fprintf(output, "%s\n", game.name);
   if (!print_haas) {
@@ -375,8 +493,7 @@ void find_strategy(const vp_game &game, const char *filename,
   for (int wild_cards = 0; wild_cards <= parms.number_wild_cards;
        wild_cards++) {
     const int hand_size = 5 - wild_cards;
-    Evaluator global(hand_size);
-    hand_iter iter(hand_size, parms.kind, wild_cards);
+    Evaluator global;
 
     const int wmult = combin.choose(parms.number_wild_cards, wild_cards);
 
@@ -407,26 +524,60 @@ void find_strategy(const vp_game &game, const char *filename,
       }
     }
 
-    while (!iter.done()) {
-      if (++timer > 102359 / 40) {
-        printf(".");
-        timer = 0;
-      }
-
-      int m = wmult * iter.multiplier();
-      counter += m;
-
-      global.multiplier =
-          static_cast<double>(m) / static_cast<double>(total_hands);
-      global.evaluate(iter, wild_cards, left, lines[wild_cards], parms, output);
-      iter.next();
+    // Each run of hands is evaluated into its own shard by one of the
+    // worker threads.  The trace files are written as the hands are
+    // evaluated, so tracing is done with a single thread, to keep the
+    // hands in order.
+    const std::vector<std::span<const hand_record>> runs =
+        split_hands(table->hands(wild_cards), runs_per_pass);
+    std::vector<conflict_shard> shards(runs.size());
+    const unsigned pass_threads =
+        global.trace_count != 0 ? 1 : worker_threads(threads, runs.size());
+
+    {
+      instrument::phase_timer enumeration(instrument::enumeration);
+      run_workers(
+          runs.size(), pass_threads,
+          [&]() { return strategy_worker(game, global); },
+          [&](strategy_worker &state, std::size_t r) {
+            int dealt = 0;
+            for (const hand_record &h : runs[r]) {
+              const int m = wmult * h.multiplier;
+              dealt += m;
+
+              state.evaluator.multiplier =
+                  static_cast<double>(m) / static_cast<double>(total_hands);
+              state.evaluator.evaluate(h, wild_cards, state.left,
+                                       lines[wild_cards], state.parms,
+                                       shards[r]);
+            }
+            counter += dealt;
+
+            if (r % 8 == 0) {
+              printf(".");
+            }
+          });
     }
 
     for (int j = 0; j < global.trace_count; j++) {
       fclose(global.trace_file[j]);
     }
 
-    global.strategy.display(output, parms.number_wild_cards != 0, print_haas,
+    ConflictMerger merger(hand_size, lines[wild_cards]);
+    std::vector<std::uint64_t> finds(count_lines(lines[wild_cards]));
+    for (conflict_shard &shard : shards) {
+      merger.merge(shard);
+      for (std::size_t line = 0; line < shard.finds.size(); line++) {
+        finds[line] += shard.finds[line];
+      }
+      shard = conflict_shard();
+    }
+    for (std::size_t line = 0; line < finds.size(); line++) {
+      instrument::add_line(lines[wild_cards][line].image, finds[line]);
+    }
+
+    instrument::phase_timer report(instrument::report_writing);
+    merger.strategy.display(output, parms.number_wild_cards != 0, print_haas,
                             print_value);
   }
 
@@ -440,14 +591,16 @@ void find_strategy(const vp_game &game, const char *filename,
   }
 }
 
-static void identify(hand_iter &h, int deuces, C_left &left,
+static void identify(const hand_record &r, int deuces, C_left &left,
                      game_parameters &parms, std::set<std::string> &moves,
                      FILE *file) {
   card hand[5];
-  h.current(hand[0]);
+  const int hand_size = 5 - deuces;
+  std::copy_n(r.cards, hand_size, hand);
+  instrument::count(instrument::hands_visited);
 
   // Subtract the hand to be evaluated from the left structure.
-  left.remove(hand, h.size(), deuces);
+  left.remove(hand, hand_size, deuces);
 
   // A list of all the best masks. Usually this vector is of size 1
   // ties are quite rare.
@@ -455,9 +608,9 @@ static void identify(hand_iter &h, int deuces, C_left &left,
   best.reserve(32);
   double best_value = 0.0;
 
-  const unsigned combos = 1 << h.size();
+  const unsigned combos = 1 << hand_size;
   for (unsigned mask = 0; mask < combos; ++mask) {
-    kept_description kept(hand, h.size(), mask, parms);
+    kept_description kept(hand, hand_size, mask, parms);
 
     pay_dist pays;
     kept.all_draws(deuces, left, pays);
@@ -483,12 +636,12 @@ static void identify(hand_iter &h, int deuces, C_left &left,
   }
 
   for (unsigned mask : best) {
-    kept_description kept(hand, h.size(), mask, parms);
+    kept_description kept(hand, hand_size, mask, parms);
     moves.insert(kept.move_name());
   }
 
   // Restore left to its initial value.
-  left.replace(hand, h.size(), deuces);
+  left.replace(hand, hand_size, deuces);
 }
 
 void draft(const vp_game &game, const char *filename) {
@@ -504,25 +657,25 @@ void draft(const vp_game &game, const char *filename) {
   int timer = 0;
   game_parameters parms(game);
   C_left left(parms);
+  const std::unique_ptr<hand_table> table = hand_table::open(parms.kind);
 
   std::set<std::string> moves;
-  for (int wild_cards = 0; wild_cards <= parms.number_wild_cards;
-       wild_cards++) {
-    const int hand_size = 5 - wild_cards;
-    Evaluator global(hand_size);
-    hand_iter iter(hand_size, parms.kind, wild_cards);
+  {
+    instrument::phase_timer enumeration(instrument::enumeration);
+    for (int wild_cards = 0; wild_cards <= parms.number_wild_cards;
+         wild_cards++) {
+      for (const hand_record &r : table->hands(wild_cards)) {
+        if (++timer > 102359 / 40) {
+          printf(".");
+          timer = 0;
+        }
 
-    while (!iter.done()) {
-      if (++timer > 102359 / 40) {
-        printf(".");
-        timer = 0;
+        identify(r, wild_cards, left, parms, moves, output);
       }
-
-      identify(iter, wild_cards, left, parms, moves, output);
-      iter.next();
     }
   }
 
+  instrument::phase_timer report(instrument::report_writing);
   for (const std::string &m : moves) {
     fprintf(output, "%s\n", m.c_str());
   }
@@ -3,10 +3,14 @@
 #include "vpoker.h"
 #include "enum_match.h"
 
+// The hands are evaluated by the given number of threads, zero
+// meaning one per hardware core.  The output is the same for any
+// number of threads.
 extern void find_strategy (const vp_game& game,
                            const char *filename,
                            StrategyLine *lines[],
                            bool print_haas,
-                           bool print_value);
+                           bool print_value,
+                           unsigned threads = 0);
 
 void draft(const vp_game& game, const char *filename);
@@ -12,8 +12,13 @@
 #include <vector>
 
 #include "combin.h"
+#include "draw_table.h"
 #include "enum_match.h"
+#include "grid_command.h"
+#include "hand_table.h"
+#include "instrument.h"
 #include "kept.h"
+#include "match_index.h"
 #include "multi_command.h"
 #include "parse_line.h"
 #include "peval.h"
@@ -206,7 +211,7 @@ void parse_strategy_line(char *parse_buffer, std::vector<StrategyLine> &pat,
 
 const char *choose_file(const char *f1, const char *f2) { return f1 ? f1 : f2; }
 
-void parser(const char *name, const char *output_file = 0) {
+void parser(const char *name, const char *output_file, unsigned threads) {
   std::ifstream infile(name);
   if (!infile.is_open()) {
     char buffer[100];
@@ -228,14 +233,22 @@ void parser(const char *name, const char *output_file = 0) {
     cm_union,
     cm_box_score,
     cm_half_life,
+    cm_bankroll_grid,
     cm_prune,
     cm_draft,
   } command_name;
 
+  // The command as written, for the instrumentation report.
+  std::string command_text;
+  const instrument::report_on_exit stats(stdout, command_text);
+
   // Arguments for the multi command.
   int command_arg1 = 1;
   int command_arg2 = 1;
 
+  // Arguments for the bankroll grid command.
+  grid_ranges grid_args{};
+
   int parse_line_number = 0;
 
   std::vector<StrategyLine> pat;
@@ -309,6 +322,7 @@ void parser(const char *name, const char *output_file = 0) {
 
       case ps_command_line:
         // Process game command
+        command_text = parse_buffer;
         // Okay this is admittedly pretty klunky!
 
         if (strcmp(parse_buffer, "haas") == 0) {
@@ -330,12 +344,43 @@ void parser(const char *name, const char *output_file = 0) {
           command_name = cm_box_score;
         } else if (strcmp(parse_buffer, "half life") == 0) {
           command_name = cm_half_life;
+        } else if (const auto ranges =
+                       bankroll_grid_command(std::string(parse_buffer));
+                   ranges.has_value()) {
+          command_name = cm_bankroll_grid;
+          grid_args = *ranges;
         } else if (strcmp(parse_buffer, "prune") == 0) {
           command_name = cm_prune;
         } else if (strcmp(parse_buffer, "game box") == 0) {
           optimal_box_score(*the_game,
                             choose_file(output_file, "game_box.txt"));
           return;
+        } else if (strcmp(parse_buffer, "hand table") == 0) {
+          // Write the canonical hands for the kind of game, so that
+          // later runs can map them instead of recomputing them.
+          const std::string default_name =
+              hand_table::file_name(the_game->kind);
+          const char *const table_file =
+              choose_file(output_file, default_name.c_str());
+          hand_table(the_game->kind).write(table_file);
+          printf("Wrote %s\n", table_file);
+          return;
+        } else if (strcmp(parse_buffer, "draw table") == 0) {
+          // Check the draw counts looked up for games without wild
+          // cards against the case analysis, for every play.
+          if (the_game->kind != GK_no_wild) {
+            throw std::runtime_error(std::format(
+                "{} has wild cards, which the draw table doesn't handle",
+                the_game->name));
+          }
+          const std::size_t errors =
+              draw_table::validate(the_game->min_high_pair);
+          if (errors != 0) {
+            throw std::runtime_error(std::format(
+                "{} plays differ from the case analysis", errors));
+          }
+          printf("The draw table matches the case analysis\n");
+          return;
         } else if (strcmp(parse_buffer, "draft") == 0) {
           command_name = cm_draft;
         } else {
@@ -383,45 +428,55 @@ void parser(const char *name, const char *output_file = 0) {
   switch (command_name) {
     case cm_haas:
       find_strategy(*the_game, choose_file(output_file, "haas.txt"), wild, true,
-                    false);
+                    false, threads);
       break;
 
     case cm_order:
       find_strategy(*the_game, choose_file(output_file, "order.txt"), wild,
-                    false, false);
+                    false, false, threads);
       break;
 
     case cm_value:
       find_strategy(*the_game, choose_file(output_file, "value.txt"), wild,
-                    false, true);
+                    false, true, threads);
       break;
 
     case cm_eval:
-      eval_strategy(*the_game, wild, choose_file(output_file, "report.txt"));
+      eval_strategy(*the_game, wild, *match_index::open(*the_game, wild, name),
+                    choose_file(output_file, "report.txt"));
       break;
 
     case cm_multi:
-      multi_distribution(*the_game, wild,
+      multi_distribution(*the_game, *match_index::open(*the_game, wild, name),
                          static_cast<unsigned int>(command_arg1),  // num_lines
                          static_cast<unsigned int>(command_arg2),  // num_games
                          choose_file(output_file, "multi.txt"));
       break;
 
     case cm_prune:
-      prune_strategy(*the_game, wild, wild_count,
+      prune_strategy(*the_game, wild, *match_index::open(*the_game, wild, name),
                      choose_file(output_file, "prune.txt"));
       break;
 
     case cm_union:
-      check_union(*the_game, wild, choose_file(output_file, "union.txt"));
+      check_union(*the_game, wild, *match_index::open(*the_game, wild, name),
+                  choose_file(output_file, "union.txt"));
       break;
 
     case cm_box_score:
-      box_score(*the_game, wild, choose_file(output_file, "box_score.txt"));
+      box_score(*the_game, *match_index::open(*the_game, wild, name),
+                choose_file(output_file, "box_score.txt"));
       break;
 
     case cm_half_life:
-      half_life(*the_game, wild, choose_file(output_file, "half_life.txt"));
+      half_life(*the_game, *match_index::open(*the_game, wild, name),
+                choose_file(output_file, "half_life.txt"));
+      break;
+
+    case cm_bankroll_grid:
+      bankroll_grid(*the_game, *match_index::open(*the_game, wild, name),
+                    grid_args.bankrolls, grid_args.goals,
+                    choose_file(output_file, "bankroll_grid.csv"));
       break;
 
     case cm_draft:
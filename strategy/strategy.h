@@ -1,3 +1,4 @@
 #pragma once
 
-void parser (const char *name, const char *output_file = 0);
+void parser (const char *name, const char *output_file = 0,
+             unsigned threads = 0);
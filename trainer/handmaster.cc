@@ -4,10 +4,14 @@
 
 #include <algorithm>
 #include <map>
+#include <memory>
 #include <utility>
 #include <vector>
 
+#include "compiled_match.h"
+#include "decision_table.h"
 #include "game.h"
+#include "hand_table.h"
 #include "kept.h"
 #include "vpoker.h"
 
@@ -198,7 +202,7 @@ void erase_hands() {
   cache.clear();
 }
 
-void sort_hand(EnumerateMatches &matcher, card *hand, int *perm,
+void sort_hand(CompiledMatcher &matcher, card *hand, int *perm,
                unsigned &wild_mask) {
   // Count and sort the non-wild cards and place them
   // into matcher for analysis.  Also return a permutation
@@ -253,57 +257,48 @@ unsigned invert_mask(int hand_size, unsigned mask, int *perm) {
   return result;
 }
 
-bool is_right_move(card *hand, unsigned mask) {
-  EnumerateMatches matcher;
-  int j;
-  int perm[5];
-  unsigned wild_mask;
+// The play the selected strategy makes on every canonical hand.
+static std::unique_ptr<decision_table> decisions;
 
-  sort_hand(matcher, hand, perm, wild_mask);
+void build_decision_table() {
+  const std::unique_ptr<hand_table> table =
+      hand_table::open(selected_game->kind);
+  decisions = std::make_unique<decision_table>(*selected_game, *table,
+                                               selected_strategy);
+}
 
-  line_list &cs = selected_strategy.at(matcher.wild_cards);
+bool is_right_move(card *hand, unsigned mask) {
+  const hand_classifier::sorted_hand h = decisions->classifier().sort(hand);
+  const decision_table::decision &d = decisions->find(h);
 
-  for (line_list::iterator rover = cs.begin(); rover != cs.end(); ++rover) {
-    matcher.find((*rover).pattern);
-    if (matcher.match_count) {
-      for (j = 0; j < matcher.match_count; j++) {
-        if ((invert_mask(matcher.hand_size, matcher.matches[j], perm) |
-             wild_mask) == mask)
-          return true;
-      }
-      return false;
-    }
+  if (d.line < 0) {
+    // Should never get here if strategy is anchored by "nothing"
+    return mask == 0;
   }
 
-  // Should never get here if strategy is anchored by "nothing"
-  return mask == 0;
+  // Any play of the first line that matches is right, if it keeps
+  // the wild cards.
+  return (mask & h.wild_mask) == h.wild_mask &&
+         ((d.plays >> hand_classifier::canonical_mask(h, mask)) & 1) != 0;
 }
 
 void find_right_move(card *hand, unsigned &mask, const char *&name) {
-  EnumerateMatches matcher;
-  int perm[5];
-  unsigned wild_mask;
-
-  sort_hand(matcher, hand, perm, wild_mask);
-  line_list &cs = selected_strategy.at(matcher.wild_cards);
-
-  for (line_list::iterator rover = cs.begin(); rover != cs.end(); ++rover) {
-    matcher.find((*rover).pattern);
-    if (matcher.match_count) {
-      mask =
-          invert_mask(matcher.hand_size, matcher.matches[0], perm) | wild_mask;
-      name = (*rover).image;
-      return;
-    }
+  const hand_classifier::sorted_hand h = decisions->classifier().sort(hand);
+  const decision_table::decision &d = decisions->find(h);
+
+  if (d.line < 0) {
+    // Should never get here if strategy is anchored by "nothing"
+    mask = 0;
+    name = "Nothing";
+    return;
   }
 
-  // Should never get here if strategy is anchored by "nothing"
-  mask = 0;
-  name = "Nothing";
+  mask = hand_classifier::hand_mask(h, d.mask) | h.wild_mask;
+  name = selected_strategy.at(h.wild_cards)[d.line].image;
 }
 
 void analyze_hand(card *hand, triple &result, difficulty &diff) {
-  EnumerateMatches matcher;
+  CompiledMatcher matcher;
 
   int perm[5];
   unsigned wild_mask;
@@ -312,7 +307,6 @@ void analyze_hand(card *hand, triple &result, difficulty &diff) {
 
   // Figure out whether there is a paying combination on the hand
   unsigned best_pay_mask = 0;
-  unsigned first_pick_mask = 0;
   unsigned second_pick_mask = 0;
 
   {
@@ -338,48 +332,31 @@ void analyze_hand(card *hand, triple &result, difficulty &diff) {
   result.best_priority = -1;
   result.next_priority = -1;
 
-  int match_number = 0;
-  int j = 0;
-
-  line_list &cs = selected_strategy.at(matcher.wild_cards);
-
-  for (line_list::iterator rover = cs.begin(); rover != cs.end();
-       ++rover, ++j) {
-    matcher.find((*rover).pattern);
-
-    if (matcher.match_count) {
-      switch (match_number) {
-        case 0:
-          result.best_priority = j;
-          first_pick_mask = matcher.matches[0];
-          match_number = 1;
-
-          // If the strategy simply picks the best-paying
-          // hand, classify this hand a no-brainer
-          if (best_pay_mask) {
-            for (int k = 0; k < matcher.match_count; k++) {
-              if (matcher.matches[k] == best_pay_mask) {
-                diff = trivial;
-                return;
-              }
-            }
-          }
+  const hand_classifier::sorted_hand h = decisions->classifier().sort(hand);
+  const decision_table::decision &d = decisions->find(h);
 
-          break;
-
-        case 1:
-          if (matcher.matches[0] == first_pick_mask) continue;
-          // Ignore a line that makes the same choice for a
-          // different reason.
+  if (d.line >= 0) {
+    result.best_priority = d.line;
 
-          result.next_priority = j;
-          second_pick_mask = matcher.matches[0];
-          goto set_diff;
+    // If the strategy simply picks the best-paying
+    // hand, classify this hand a no-brainer
+    if (best_pay_mask) {
+      const unsigned best = hand_classifier::canonical_mask(
+          h, invert_mask(matcher.hand_size, best_pay_mask, perm));
+      if ((d.plays >> best) & 1) {
+        diff = trivial;
+        return;
       }
     }
+
+    // next_line already skips the lines that make the same choice
+    // for a different reason.
+    if (d.next_line >= 0) {
+      result.next_priority = d.next_line;
+      second_pick_mask = d.next_mask;
+    }
   }
 
-set_diff:
   diff = second_pick_mask == 0                             ? easy
          : result.best_priority + 4 < result.next_priority ? simple
                                                            : hard;
@@ -12,6 +12,9 @@ extern strategy selected_strategy;
 void initialize_deck();
 // Should be called every time selected_game changes.
 
+void build_decision_table();
+// Should be called every time selected_strategy changes.
+
 void deal_hand (card *hand, const char* &name);
 // Deal out a random hand, and return its name
 
@@ -225,6 +225,8 @@ void read_strategy_file() {
          k != selected_strategy.end(); ++k) {
       _ASSERT((*k).size() > 0);
     }
+
+    build_decision_table();
   } catch (std::string msg) {
     char buffer[128];
     sprintf(buffer, "Line %d: ", f.line_number);